@@ -0,0 +1,31 @@
+#!/bin/sh
+# 内置命令管道基准：比较全部由内置命令组成的管道在内存中运行与 fork 运行时的 fork 次数和耗时。
+#
+# 用法: bench/fork_count.sh [dash 路径] [循环次数]
+#
+# 对照组给 read 阶段加上 2>/dev/null，不满足内存管道的条件，read 阶段 fork 运行。
+
+DASH=${1:-./build/dash}
+COUNT=${2:-1000}
+
+if [ ! -x "$DASH" ]; then
+    echo "找不到可执行的 dash: $DASH" >&2
+    exit 1
+fi
+
+# dash 不展开 for 的单词表，循环的单词表在这里生成
+WORDS=$(seq "$COUNT" | tr '\n' ' ')
+
+run() {
+    start=$(date +%s%N)
+    forks=$("$DASH" -c "set -o forkstats; for i in $WORDS; do $1; done" 2>&1 >/dev/null | grep -c '^dash: fork #')
+    end=$(date +%s%N)
+    awk -v n="$COUNT" -v ns="$((end - start))" -v forks="$forks" -v name="$2" \
+        'BEGIN { printf "%-12s %8d %12.1f\n", name, forks, ns / n / 1000 }'
+}
+
+echo "$COUNT iterations"
+printf '%-12s %8s %12s\n' pipeline forks us/iter
+run "echo a b c | read x y z" memory
+run "echo a b c | read x y z 2>/dev/null" fork
+run "echo a b c | cat | read x y z" memory-cat
@@ -0,0 +1,37 @@
+#!/bin/sh
+# shell 内部 I/O 基准：比较 set -o iouring 打开与关闭时大命令替换和内置命令大量输出的耗时。
+#
+# 用法: bench/io_uring.sh [dash 路径] [数据量 MB] [循环次数]
+#
+# 内核不支持 io_uring（或被 seccomp 禁止）时两组结果应当相同，说明退回了 read/write。
+
+DASH=${1:-./build/dash}
+MB=${2:-16}
+COUNT=${3:-20}
+
+if [ ! -x "$DASH" ]; then
+    echo "找不到可执行的 dash: $DASH" >&2
+    exit 1
+fi
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+head -c "${MB}M" /dev/zero | tr '\0' 'a' > "$DIR/data"
+
+# dash 不展开 for 的单词表，循环的单词表在这里生成
+WORDS=$(seq "$COUNT" | tr '\n' ' ')
+
+run() {
+    start=$(date +%s%N)
+    "$DASH" -c "set $1 iouring; for i in $WORDS; do $2; done" | cat >/dev/null
+    end=$(date +%s%N)
+    awk -v mb="$MB" -v n="$COUNT" -v ns="$((end - start))" -v name="$3" \
+        'BEGIN { printf "%-16s %10.1f\n", name, mb * n / (ns / 1000000000) }'
+}
+
+echo "$MB MB x $COUNT"
+printf '%-16s %10s\n' workload MB/s
+run +o "X=\$(cat $DIR/data)" "subst read"
+run -o "X=\$(cat $DIR/data)" "subst iouring"
+run +o "cat $DIR/data | cat" "builtin read"
+run -o "cat $DIR/data | cat" "builtin iouring"
@@ -0,0 +1,57 @@
+#!/bin/sh
+# 词法分析基准：生成大脚本，在 noexec 下只读入和解析，按词法单元数计算每秒处理的词法单元。
+#
+# 用法: bench/lexer_throughput.sh [dash 路径] [行数] [每行的命令段数]
+#
+# 每个命令段 19 个词法单元，覆盖普通单词、引号、长字符串、反斜杠、IO 编号、重定向、
+# 管道、逻辑操作符、赋值和命令替换；每行末尾再加上 ":"、一段注释和换行符。
+# 分别用 set -o scan=scalar/sse2/avx2 运行，比较字符扫描的各个实现。
+
+DASH=${1:-./build/dash}
+LINES=${2:-20000}
+SEGMENTS=${3:-10}
+
+if [ ! -x "$DASH" ]; then
+    echo "找不到可执行的 dash: $DASH" >&2
+    exit 1
+fi
+
+BODY=$(mktemp)
+SCRIPT=$(mktemp)
+trap 'rm -f "$BODY" "$SCRIPT"' EXIT
+
+awk -v lines="$LINES" -v segments="$SEGMENTS" 'BEGIN {
+    segment = "echo alpha \"beta gamma\" '\''delta'\'' x\\ y \"a longer quoted argument with several words in it\" 2>/dev/null | grep -v pat >>out && a=1 b=$(c d) ; "
+    for (i = 0; i < lines; i++) {
+        line = ""
+        for (j = 0; j < segments; j++) {
+            line = line segment
+        }
+        print line ": # trailing comment that the lexer skips in one step"
+    }
+}' > "$BODY"
+
+TOKENS=$((LINES * (SEGMENTS * 19 + 2)))
+BYTES=$(wc -c < "$BODY")
+echo "$TOKENS tokens, $((BYTES / 1000000)) MB"
+printf '%-8s %10s %14s %10s\n' scan seconds tokens/sec MB/sec
+
+for method in scalar sse2 avx2; do
+    { echo "set -o scan=$method; set -o noexec"; cat "$BODY"; } > "$SCRIPT"
+    best=0
+    for run in 1 2 3; do
+        start=$(date +%s%N)
+        if ! "$DASH" "$SCRIPT"; then
+            echo "dash 解析脚本失败" >&2
+            exit 1
+        fi
+        end=$(date +%s%N)
+        ns=$((end - start))
+        if [ "$best" -eq 0 ] || [ "$ns" -lt "$best" ]; then
+            best=$ns
+        fi
+    done
+    awk -v name="$method" -v tokens="$TOKENS" -v bytes="$BYTES" -v ns="$best" 'BEGIN {
+        printf "%-8s %10.3f %14.0f %10.1f\n", name, ns / 1e9, tokens / (ns / 1e9), bytes / 1e6 / (ns / 1e9)
+    }'
+done
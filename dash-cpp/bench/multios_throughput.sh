@@ -0,0 +1,46 @@
+#!/bin/sh
+# 多目标输出基准：比较 multios 中继（tee/splice）与外部 tee 命令写多个文件的 MB/s。
+#
+# 用法: bench/multios_throughput.sh [dash 路径] [数据量 MB] [目标文件数]
+#
+# 目标文件放在 $TMPDIR（默认 /tmp）下，测完删除。
+
+DASH=${1:-./build/dash}
+MB=${2:-1024}
+TARGETS=${3:-3}
+
+if [ ! -x "$DASH" ]; then
+    echo "找不到可执行的 dash: $DASH" >&2
+    exit 1
+fi
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+# 两种写法的目标相同：>f1 >f2 ... 与 | tee f1 ... >fN
+REDIRS=""
+TEE_ARGS=""
+i=1
+while [ "$i" -le "$TARGETS" ]; do
+    REDIRS="$REDIRS >$DIR/out$i"
+    if [ "$i" -lt "$TARGETS" ]; then
+        TEE_ARGS="$TEE_ARGS $DIR/out$i"
+    fi
+    i=$((i + 1))
+done
+
+SOURCE="head -c ${MB}M /dev/zero"
+
+run() {
+    start=$(date +%s%N)
+    "$DASH" -c "$1"
+    end=$(date +%s%N)
+    rm -f "$DIR"/out*
+    awk -v mb="$MB" -v ns="$((end - start))" -v name="$2" \
+        'BEGIN { printf "%-12s %10.1f\n", name, mb / (ns / 1000000000) }'
+}
+
+echo "$MB MB -> $TARGETS files"
+printf '%-12s %10s\n' method MB/s
+run "set -o multios; $SOURCE$REDIRS" multios
+run "$SOURCE | tee$TEE_ARGS >$DIR/out$TARGETS" tee
@@ -0,0 +1,57 @@
+#!/bin/sh
+# 并行词法分析基准：生成大脚本，在 noexec 下只读入和解析，比较不同的分析线程数。
+#
+# 用法: bench/parallel_lexer.sh [dash 路径] [行数] [线程数列表]
+#
+# 每行与 bench/lexer_throughput.sh 相同；每 100 行插入一个 Here 文档，检查分块时跳过正文
+# 的开销。--lex-threads 1 为逐行读取，其余为并行分析（脚本至少 2 MB 时才会使用）。
+
+DASH=${1:-./build/dash}
+LINES=${2:-50000}
+THREADS=${3:-"1 2 4 $(nproc)"}
+
+if [ ! -x "$DASH" ]; then
+    echo "找不到可执行的 dash: $DASH" >&2
+    exit 1
+fi
+
+SCRIPT=$(mktemp)
+trap 'rm -f "$SCRIPT"' EXIT
+
+echo "set -o noexec" > "$SCRIPT"
+awk -v lines="$LINES" 'BEGIN {
+    segment = "echo alpha \"beta gamma\" '\''delta'\'' x\\ y \"a longer quoted argument with several words in it\" 2>/dev/null | grep -v pat >>out && a=1 b=$(c d) ; "
+    line = ""
+    for (j = 0; j < 4; j++) {
+        line = line segment
+    }
+    for (i = 0; i < lines; i++) {
+        if (i % 100 == 0) {
+            print "cat <<EOF >/dev/null\nheredoc body " i "\nEOF"
+        }
+        print line ": # trailing comment"
+    }
+}' >> "$SCRIPT"
+
+BYTES=$(wc -c < "$SCRIPT")
+echo "$LINES lines, $((BYTES / 1000000)) MB"
+printf '%-8s %10s %10s\n' threads seconds MB/sec
+
+for threads in $THREADS; do
+    best=0
+    for run in 1 2 3; do
+        start=$(date +%s%N)
+        if ! "$DASH" --lex-threads "$threads" "$SCRIPT"; then
+            echo "dash 解析脚本失败" >&2
+            exit 1
+        fi
+        end=$(date +%s%N)
+        ns=$((end - start))
+        if [ "$best" -eq 0 ] || [ "$ns" -lt "$best" ]; then
+            best=$ns
+        fi
+    done
+    awk -v threads="$threads" -v bytes="$BYTES" -v ns="$best" 'BEGIN {
+        printf "%-8s %10.3f %10.1f\n", threads, ns / 1e9, bytes / 1e6 / (ns / 1e9)
+    }'
+done
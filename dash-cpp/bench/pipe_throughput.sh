@@ -0,0 +1,40 @@
+#!/bin/sh
+# 管道吞吐量基准：比较不同 pipesize 设置下的 MB/s 和每个阶段的上下文切换次数。
+#
+# 用法: bench/pipe_throughput.sh [dash 路径] [数据量 MB] [中间 cat 阶段数]
+#
+# 依赖 DASH_PIPELINE_STATS 输出的各阶段资源使用情况和管道总耗时。中间阶段用 /bin/cat，
+# 测的是外部进程之间的管道，不是内置 cat。
+
+DASH=${1:-./build/dash}
+MB=${2:-1024}
+CATS=${3:-2}
+
+if [ ! -x "$DASH" ]; then
+    echo "找不到可执行的 dash: $DASH" >&2
+    exit 1
+fi
+
+PIPELINE="head -c ${MB}M /dev/zero"
+i=0
+while [ "$i" -lt "$CATS" ]; do
+    PIPELINE="$PIPELINE | /bin/cat"
+    i=$((i + 1))
+done
+PIPELINE="$PIPELINE | wc -c"
+
+STATS=$(mktemp)
+trap 'rm -f "$STATS"' EXIT
+
+echo "pipeline: $PIPELINE"
+printf '%-10s %10s %14s %14s\n' pipesize MB/s "csw/stage" "invol/stage"
+for size in 0 256k 1m auto; do
+    DASH_PIPELINE_STATS=1 "$DASH" -c "set -o pipesize=$size; $PIPELINE" >/dev/null 2>"$STATS"
+    awk -v mb="$MB" -v size="$size" '
+        / stage [0-9]+ / { stages++; vol += $(NF - 6); invol += $(NF - 3) }
+        / stages finished in / { us = $(NF - 1) }
+        END {
+            if (stages == 0 || us == 0) { printf "%-10s %10s\n", size, "failed"; exit }
+            printf "%-10s %10.1f %14d %14d\n", size, mb / (us / 1000000), vol / stages, invol / stages
+        }' "$STATS"
+done
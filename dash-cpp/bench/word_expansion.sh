@@ -0,0 +1,60 @@
+#!/bin/sh
+# 参数展开基准：比较参数全是纯字面量的命令和参数需要展开的命令的执行时间。
+#
+# 用法: bench/word_expansion.sh [dash 路径] [行数]
+#
+# 每行是一条带 8 个参数的 echo 内置命令，输出到 /dev/null。literal 的参数只有普通单词和
+# 引号，词法分析时没有记录分段，执行时原样使用；expanded 的参数中有一半含有 $name、
+# "$a $b" 和 ${name}，需要按分段展开。
+
+DASH=${1:-./build/dash}
+LINES=${2:-100000}
+
+if [ ! -x "$DASH" ]; then
+    echo "找不到可执行的 dash: $DASH" >&2
+    exit 1
+fi
+
+LITERAL=$(mktemp)
+EXPANDED=$(mktemp)
+trap 'rm -f "$LITERAL" "$EXPANDED"' EXIT
+
+awk -v lines="$LINES" 'BEGIN {
+    print "a=alpha b=beta"
+    for (i = 0; i < lines; i++) {
+        print "echo alpha beta gamma delta \"epsilon zeta\" eta/theta iota kappa"
+    }
+}' > "$LITERAL"
+awk -v lines="$LINES" 'BEGIN {
+    print "a=alpha b=beta"
+    for (i = 0; i < lines; i++) {
+        print "echo $a $b gamma delta \"$a $b\" ${a}/theta iota kappa"
+    }
+}' > "$EXPANDED"
+
+echo "$LINES lines, 8 arguments each"
+printf '%-10s %10s %14s\n' words seconds commands/sec
+
+for kind in literal expanded; do
+    if [ "$kind" = literal ]; then
+        script=$LITERAL
+    else
+        script=$EXPANDED
+    fi
+    best=0
+    for run in 1 2 3; do
+        start=$(date +%s%N)
+        if ! "$DASH" "$script" > /dev/null; then
+            echo "dash 执行脚本失败" >&2
+            exit 1
+        fi
+        end=$(date +%s%N)
+        ns=$((end - start))
+        if [ "$best" -eq 0 ] || [ "$ns" -lt "$best" ]; then
+            best=$ns
+        fi
+    done
+    awk -v kind="$kind" -v lines="$LINES" -v ns="$best" 'BEGIN {
+        printf "%-10s %10.3f %14.0f\n", kind, ns / 1e9, lines / (ns / 1e9)
+    }'
+done
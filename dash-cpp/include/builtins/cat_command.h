@@ -0,0 +1,102 @@
+/**
+ * @file cat_command.h
+ * @brief Cat命令类定义
+ */
+
+#ifndef DASH_CAT_COMMAND_H
+#define DASH_CAT_COMMAND_H
+
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include "builtins/builtin_command.h"
+
+namespace dash
+{
+
+    struct MemoryStdio;
+
+    /**
+     * @brief Cat命令类
+     *
+     * 实现cat内置命令，把文件依次复制到标准输出。按输入输出的类型选择内核中的复制方式：
+     * 文件到文件用 copy_file_range，文件到套接字用 sendfile，涉及管道时用 splice，
+     * 都不可用时退回到 read/write。在内存管道中运行时通过 std::cout 输出，标准输入来自前一个阶段。
+     */
+    class CatCommand : public BuiltinCommand
+    {
+    public:
+        /**
+         * @brief 构造函数
+         *
+         * @param shell Shell对象指针
+         */
+        explicit CatCommand(Shell *shell);
+
+        /**
+         * @brief 执行命令
+         *
+         * @param args 命令参数
+         * @return int 执行结果状态码
+         */
+        int execute(const std::vector<std::string> &args) override;
+
+        /**
+         * @brief 获取命令名
+         *
+         * @return std::string 命令名
+         */
+        std::string getName() const override;
+
+        /**
+         * @brief 获取命令帮助信息
+         *
+         * @return std::string 帮助信息
+         */
+        std::string getHelp() const override;
+
+    private:
+        /**
+         * @brief 复制方式
+         */
+        enum class CopyMethod
+        {
+            COPY_FILE_RANGE, // 普通文件到普通文件
+            SENDFILE,        // 普通文件到套接字
+            SPLICE,          // 一端是管道，输入是管道或普通文件
+            READ_WRITE       // 其他情况，或者内核拒绝了上面的方式
+        };
+
+        /**
+         * @brief 按输入输出的类型选择复制方式
+         *
+         * @param in 输入的状态
+         * @param out 输出的状态
+         * @return CopyMethod 复制方式
+         */
+        static CopyMethod chooseMethod(const struct stat &in, const struct stat &out);
+
+        /**
+         * @brief 把输入描述符的内容全部复制到输出描述符
+         *
+         * @param in 输入描述符
+         * @param out 输出描述符
+         * @param method 首选的复制方式，内核不支持时退回到 read/write
+         * @param write_error 输出参数，出错的是写入时为 true
+         * @return int 0 表示成功，否则为 errno
+         */
+        static int copy(int in, int out, CopyMethod method, bool &write_error);
+
+        /**
+         * @brief 在内存管道中把文件依次写到 std::cout
+         *
+         * @param files 文件列表，"-" 表示标准输入
+         * @param stdio 当前阶段的输入
+         * @return int 执行结果状态码
+         */
+        static int copyToStream(const std::vector<std::string> &files, MemoryStdio &stdio);
+    };
+
+} // namespace dash
+
+#endif // DASH_CAT_COMMAND_H
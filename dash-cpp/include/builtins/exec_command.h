@@ -0,0 +1,57 @@
+/**
+ * @file exec_command.h
+ * @brief Exec命令类定义
+ */
+
+#ifndef DASH_EXEC_COMMAND_H
+#define DASH_EXEC_COMMAND_H
+
+#include <string>
+#include <vector>
+#include "builtins/builtin_command.h"
+
+namespace dash
+{
+
+    /**
+     * @brief Exec命令类
+     *
+     * 实现exec内置命令。不带命令时，命令上的重定向由执行器直接作用于 shell 本身，
+     * 之后一直有效（exec 3>>log）；带命令时用该命令替换 shell 进程，不 fork。
+     */
+    class ExecCommand : public BuiltinCommand
+    {
+    public:
+        /**
+         * @brief 构造函数
+         *
+         * @param shell Shell对象指针
+         */
+        explicit ExecCommand(Shell *shell);
+
+        /**
+         * @brief 执行命令
+         *
+         * @param args 命令参数
+         * @return int 执行结果状态码；成功替换 shell 时不返回
+         */
+        int execute(const std::vector<std::string> &args) override;
+
+        /**
+         * @brief 获取命令名
+         *
+         * @return std::string 命令名
+         */
+        std::string getName() const override;
+
+        /**
+         * @brief 获取命令帮助信息
+         *
+         * @return std::string 帮助信息
+         */
+        std::string getHelp() const override;
+    };
+
+} // namespace dash
+
+#endif // DASH_EXEC_COMMAND_H
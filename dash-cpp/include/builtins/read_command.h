@@ -0,0 +1,75 @@
+/**
+ * @file read_command.h
+ * @brief Read命令类定义
+ */
+
+#ifndef DASH_READ_COMMAND_H
+#define DASH_READ_COMMAND_H
+
+#include <string>
+#include <vector>
+#include "builtins/builtin_command.h"
+
+namespace dash
+{
+
+    /**
+     * @brief Read命令类
+     *
+     * 实现read内置命令，从标准输入读一行，按 IFS 分割后依次赋给各个变量，
+     * 最后一个变量得到这一行剩余的部分。没有给出变量名时赋给 REPLY。
+     */
+    class ReadCommand : public BuiltinCommand
+    {
+    public:
+        /**
+         * @brief 构造函数
+         *
+         * @param shell Shell对象指针
+         */
+        explicit ReadCommand(Shell *shell);
+
+        /**
+         * @brief 执行命令
+         *
+         * @param args 命令参数
+         * @return int 执行结果状态码，读到文件末尾时为 1
+         */
+        int execute(const std::vector<std::string> &args) override;
+
+        /**
+         * @brief 获取命令名
+         *
+         * @return std::string 命令名
+         */
+        std::string getName() const override;
+
+        /**
+         * @brief 获取命令帮助信息
+         *
+         * @return std::string 帮助信息
+         */
+        std::string getHelp() const override;
+
+        /**
+         * @brief 获取命令会赋值的变量名
+         *
+         * @param args 命令参数
+         * @return std::vector<std::string> 变量名列表
+         */
+        static std::vector<std::string> getVariableNames(const std::vector<std::string> &args);
+
+    private:
+        /**
+         * @brief 跳过选项
+         *
+         * @param args 命令参数
+         * @param raw 输出参数，是否给出了 -r
+         * @return size_t 第一个变量名的下标；选项无效时为 0
+         */
+        static size_t parseOptions(const std::vector<std::string> &args, bool &raw);
+    };
+
+} // namespace dash
+
+#endif // DASH_READ_COMMAND_H
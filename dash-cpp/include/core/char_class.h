@@ -0,0 +1,187 @@
+/**
+ * @file char_class.h
+ * @brief 词法分析使用的字符分类表和批量扫描
+ */
+
+#ifndef DASH_CHAR_CLASS_H
+#define DASH_CHAR_CLASS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace dash
+{
+
+    /**
+     * @brief CharClass::find() 的实现
+     */
+    enum class ScanMethod
+    {
+        AUTO,   // 使用 CPU 支持的最快实现
+        SCALAR, // 逐字节查表
+        SSE2,   // 每次比较 16 个字节
+        AVX2    // 每次查 32 个字节
+    };
+
+    /**
+     * @brief 字符分类
+     *
+     * 每个字节的类别在编译期生成一张 256 项的表，判断一个字符只需查一次表。
+     * find() 从指定位置开始查找第一个属于某组类别的字节，用于一次跳过单词、
+     * 引号内的字符串和注释中不需要逐个处理的部分。
+     */
+    class CharClass
+    {
+    public:
+        static constexpr uint16_t BLANK = 1 << 0;     // 换行以外的空白：空格 \t \v \f \r
+        static constexpr uint16_t NEWLINE = 1 << 1;   // 换行符
+        static constexpr uint16_t OPERATOR = 1 << 2;  // 操作符字符 | & ; < > ( ) { }
+        static constexpr uint16_t QUOTE = 1 << 3;     // 引号 ' "
+        static constexpr uint16_t DOLLAR = 1 << 4;    // $
+        static constexpr uint16_t BACKQUOTE = 1 << 5; // `
+        static constexpr uint16_t BACKSLASH = 1 << 6; // 反斜杠
+        static constexpr uint16_t EQUALS = 1 << 7;    // =
+        static constexpr uint16_t NUL = 1 << 8;       // '\0'，词法分析器用它表示输入结束
+        static constexpr uint16_t GLOB = 1 << 9;      // 路径名匹配的元字符 * ? [
+
+        /**
+         * @brief 查找的目标：属于 mask 中任一类别的字节
+         *
+         * 除了类别掩码，还在编译期准备好 SIMD 扫描需要的数据：每个目标字节重复 16 次
+         * （SSE2 直接从内存取出与输入逐个比较），以及按高低 4 位拆开的查找表（AVX2 用
+         * vpshufb 一次查出 32 个字节是否属于集合）。目标字节必须都是 ASCII 字符。
+         */
+        struct StopSet
+        {
+            static constexpr size_t MAX_BYTES = 32;
+
+            uint16_t mask = 0;
+            alignas(16) char repeated[MAX_BYTES][16] = {}; // 每个目标字节重复 16 次
+            size_t count = 0;                              // 目标字节的数量
+            alignas(16) uint8_t low_nibble[16] = {};       // 低 4 位为 i 的目标字节，高 4 位组成的位图
+            alignas(16) uint8_t high_nibble[16] = {};      // 高 4 位为 i 时对应的位，非 ASCII 为 0
+
+            constexpr explicit StopSet(uint16_t classes);
+        };
+
+    private:
+        /**
+         * @brief 生成分类表
+         *
+         * @return std::array<uint16_t, 256> 每个字节的类别
+         */
+        static constexpr std::array<uint16_t, 256> makeTable()
+        {
+            std::array<uint16_t, 256> table = {};
+            table['\0'] = NUL;
+            for (unsigned char c : {' ', '\t', '\v', '\f', '\r'})
+            {
+                table[c] = BLANK;
+            }
+            table['\n'] = NEWLINE;
+            for (unsigned char c : {'|', '&', ';', '<', '>', '(', ')', '{', '}'})
+            {
+                table[c] = OPERATOR;
+            }
+            table['\''] = QUOTE;
+            table['"'] = QUOTE;
+            table['$'] = DOLLAR;
+            table['`'] = BACKQUOTE;
+            table['\\'] = BACKSLASH;
+            table['='] = EQUALS;
+            for (unsigned char c : {'*', '?', '['})
+            {
+                table[c] = GLOB;
+            }
+            return table;
+        }
+
+        static const std::array<uint16_t, 256> table_; // 每个字节的类别
+
+    public:
+        // 单词中需要单独处理或结束单词的字符
+        static constexpr uint16_t WORD_STOP_CLASSES =
+            BLANK | NEWLINE | OPERATOR | QUOTE | DOLLAR | BACKQUOTE | BACKSLASH | EQUALS | NUL | GLOB;
+        // 引号内需要单独处理的字符：引号本身、展开、反斜杠和输入结束
+        static constexpr uint16_t QUOTED_STOP_CLASSES = QUOTE | DOLLAR | BACKQUOTE | BACKSLASH | NUL;
+
+        static const StopSet WORD_STOP;
+        static const StopSet QUOTED_STOP;
+
+        /**
+         * @brief 获取字符的类别
+         *
+         * @param c 字符
+         * @return uint16_t 类别，普通字符为 0
+         */
+        static constexpr uint16_t of(char c) { return table_[static_cast<unsigned char>(c)]; }
+
+        /**
+         * @brief 判断字符是否属于 mask 中的任一类别
+         *
+         * @param c 字符
+         * @param mask 类别掩码
+         * @return bool 是否属于
+         */
+        static constexpr bool is(char c, uint16_t mask) { return (of(c) & mask) != 0; }
+
+        /**
+         * @brief 从 pos 开始查找第一个属于 set 的字节
+         *
+         * 使用 setMethod() 选择的实现，默认为 CPU 支持的最快实现。
+         *
+         * @param text 文本
+         * @param pos 起始位置
+         * @param set 查找的目标
+         * @return size_t 找到的位置，找不到时为 text.size()
+         */
+        static size_t find(std::string_view text, size_t pos, const StopSet &set);
+
+        /**
+         * @brief 选择 find() 的实现
+         *
+         * CPU 不支持指定的指令时依次退回 SSE2、逐字节查表。
+         *
+         * @param method 实现
+         */
+        static void setMethod(ScanMethod method);
+
+        /**
+         * @brief 获取 find() 正在使用的实现的名字
+         *
+         * @return const char* "avx2"、"sse2" 或 "scalar"
+         */
+        static const char *methodName();
+    };
+
+    inline constexpr std::array<uint16_t, 256> CharClass::table_ = CharClass::makeTable();
+
+    constexpr CharClass::StopSet::StopSet(uint16_t classes)
+        : mask(classes)
+    {
+        for (unsigned c = 0; c < 128; ++c)
+        {
+            if (table_[c] & classes)
+            {
+                for (char &byte : repeated[count])
+                {
+                    byte = static_cast<char>(c);
+                }
+                ++count;
+                low_nibble[c & 0x0f] |= static_cast<uint8_t>(1u << (c >> 4));
+            }
+        }
+        for (unsigned i = 0; i < 8; ++i)
+        {
+            high_nibble[i] = static_cast<uint8_t>(1u << i);
+        }
+    }
+
+    inline constexpr CharClass::StopSet CharClass::WORD_STOP{CharClass::WORD_STOP_CLASSES};
+    inline constexpr CharClass::StopSet CharClass::QUOTED_STOP{CharClass::QUOTED_STOP_CLASSES};
+
+} // namespace dash
+
+#endif // DASH_CHAR_CLASS_H
@@ -0,0 +1,89 @@
+/**
+ * @file command_table.h
+ * @brief 命令位置哈希表定义
+ */
+
+#ifndef DASH_COMMAND_TABLE_H
+#define DASH_COMMAND_TABLE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace dash
+{
+
+    /**
+     * @brief 命令位置哈希表
+     *
+     * 参考 dash 的 cmdtable：第一次查找时搜索 PATH 并记录结果，
+     * 之后直接使用记录的绝对路径。找不到的命令也会被记录，
+     * PATH 变化（由 VariableManager 的 PATH 代数标识）时整表失效。
+     */
+    class CommandTable
+    {
+    public:
+        /**
+         * @brief 哈希表项
+         */
+        struct Entry
+        {
+            std::string path; // 命令的完整路径，找不到时为空
+            int hits;         // 命中次数
+        };
+
+    private:
+        std::unordered_map<std::string, Entry> entries_;
+        unsigned long path_generation_;
+
+        /**
+         * @brief 在 PATH 中搜索命令
+         *
+         * @param name 命令名
+         * @param path PATH 的值
+         * @param cacheable 输出参数，结果是否可以缓存（依赖相对目录的结果不缓存）
+         * @return std::string 完整路径，找不到时为空
+         */
+        static std::string searchPath(const std::string &name, const std::string &path, bool &cacheable);
+
+    public:
+        /**
+         * @brief 构造函数
+         */
+        CommandTable();
+
+        /**
+         * @brief 查找命令
+         *
+         * @param name 命令名（不含 '/'）
+         * @param path PATH 的值
+         * @param path_generation PATH 的当前代数
+         * @param count_hit 是否计入命中次数
+         * @return Entry 表项，path 为空表示命令不存在
+         */
+        Entry lookup(const std::string &name, const std::string &path, unsigned long path_generation,
+                     bool count_hit = true);
+
+        /**
+         * @brief 删除一个表项
+         *
+         * @param name 命令名
+         */
+        void remove(const std::string &name);
+
+        /**
+         * @brief 清空哈希表
+         */
+        void clear();
+
+        /**
+         * @brief 获取所有表项
+         *
+         * @return std::vector<std::pair<std::string, Entry>> 按命令名排序的表项列表
+         */
+        std::vector<std::pair<std::string, Entry>> getEntries() const;
+    };
+
+} // namespace dash
+
+#endif // DASH_COMMAND_TABLE_H
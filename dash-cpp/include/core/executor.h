@@ -11,7 +11,14 @@
 #include <memory>
 #include <unordered_map>
 #include <functional>
+#include <thread>
+#include <sys/resource.h>
 #include "core/node.h"
+#include "core/spawn.h"
+#include "core/zygote.h"
+#include "core/command_table.h"
+#include "core/fork_monitor.h"
+#include "utils/thread_pool.h"
 
 namespace dash
 {
@@ -22,6 +29,18 @@ namespace dash
     class JobControl;
     class BuiltinCommand;
 
+    /**
+     * @brief 内存管道中当前阶段的标准输入
+     *
+     * 全部由内置命令组成的管道在 shell 进程中依次运行，前一个阶段的输出保存在内存中，
+     * 读标准输入的内置命令（read、cat）从这里读，不经过管道。
+     */
+    struct MemoryStdio
+    {
+        const std::string *input = nullptr; // 前一个阶段的输出；第一个阶段为 nullptr，读真正的标准输入
+        size_t input_pos = 0;               // 已经读到的位置
+    };
+
     /**
      * @brief 执行器类
      *
@@ -34,30 +53,60 @@ namespace dash
         std::unordered_map<std::string, std::function<int(const std::vector<std::string> &)>> builtins_;
         std::vector<std::shared_ptr<BuiltinCommand>> builtin_commands_; // 存储内置命令对象
         int last_status_;
+        std::unique_ptr<SpawnBackend> fork_backend_;
+        std::unique_ptr<SpawnBackend> vfork_backend_;
+        std::unique_ptr<SpawnBackend> posix_spawn_backend_;
+        std::unique_ptr<ZygoteSpawnBackend> zygote_backend_;
+        std::unique_ptr<CommandTable> command_table_;
+        std::unique_ptr<ForkMonitor> fork_monitor_;
+        std::unique_ptr<ThreadPool> spawn_pool_; // 并行创建管道各阶段的线程池，按需创建
+        pid_t spawn_pool_owner_;                 // 线程池所属进程，fork 出的子进程中不能使用
+
+        static constexpr size_t PIPELINE_PARALLEL_MIN_STAGES = 4; // 外部命令阶段达到此数量才并行创建
+        static constexpr size_t PIPELINE_MAX_SPAWN_THREADS = 4;   // 参与创建进程的最大线程数（含调用线程）
+        static constexpr int PIPE_AUTO_GROW_DELAY_MS = 100;       // pipesize=auto 时运行超过此时间的管道才扩大
+        size_t pipe_max_size_;                                    // 缓存的 /proc/sys/fs/pipe-max-size，0 表示尚未读取
+        int dev_null_fd_;                                         // 缓存的 /dev/null 描述符，-1 表示尚未打开
+        RedirectionCache *redir_cache_;                           // 当前循环或命令列表的重定向描述符缓存，可以为 nullptr
+        MemoryStdio *memory_stdio_;                               // 正在运行的内存管道阶段的输入，不在内存管道中时为 nullptr
 
         /**
          * @brief 执行重定向
          *
-         * @param redirections 重定向列表
-         * @param saved_fds 保存的文件描述符映射
+         * @param plan 重定向计划
+         * @param mode 执行方式，子进程中用 CHILD，不保存原描述符
+         * @param saved RESTORE 模式下保存原描述符的表
+         * @param relays 多目标输出的中继进程，命令结束后由调用者等待
          * @return bool 是否成功
          */
-        bool applyRedirections(const std::vector<Redirection> &redirections, std::unordered_map<int, int> &saved_fds);
+        bool applyRedirections(const RedirectionPlan &plan, RedirectionPlan::Mode mode,
+                               RedirectionPlan::SavedFds *saved, std::vector<pid_t> &relays);
 
         /**
-         * @brief 恢复重定向
+         * @brief 获取缓存的 /dev/null 描述符
          *
-         * @param saved_fds 保存的文件描述符映射
+         * 第一次调用时打开，放在 RedirectionPlan::MAX_FD 以上并带 O_CLOEXEC。
+         *
+         * @return int 描述符，打开失败时为 -1
+         */
+        int getDevNull();
+
+        /**
+         * @brief 获取执行重定向的环境
+         *
+         * @param relays 接收多目标输出中继进程的列表，multios 关闭时不使用
+         * @return RedirectionContext 变量管理器、/dev/null、当前的描述符缓存和中继列表
          */
-        void restoreRedirections(std::unordered_map<int, int> &saved_fds);
+        RedirectionContext getRedirectionContext(std::vector<pid_t> &relays);
 
         /**
          * @brief 执行命令
          *
          * @param command 命令节点
+         * @param flags 执行标志
          * @return int 执行结果状态码
          */
-        int executeCommand(const CommandNode *command);
+        int executeCommand(const CommandNode *command, int flags);
 
         /**
          * @brief 执行管道
@@ -67,21 +116,228 @@ namespace dash
          */
         int executePipe(const PipeNode *pipe);
 
+        /**
+         * @brief 管道中的一个阶段
+         */
+        struct PipelineStage
+        {
+            const Node *node = nullptr;
+            SpawnPlan plan;
+            std::vector<FileAction> redirections; // 阶段自己的重定向，在接好管道之后执行
+            std::vector<int> opened_fds;          // 在父进程中为重定向打开的描述符，启动后关闭
+            std::string name;                     // 外部命令的命令名，为空表示需要 fork 运行 shell 代码
+            SpawnResult result;
+            int status = 0;
+            bool launched = false;
+            struct rusage usage = {}; // 打开统计时记录的资源使用情况
+            std::vector<pid_t> relays; // 多目标输出的中继进程
+            bool in_process = false;   // 在 shell 进程中运行的内置命令，其余阶段都启动后才运行
+            bool buffered = false;     // 在 shell 进程中先运行、输出暂存在 output 中的内置命令
+            int stdio_fds[2] = {-1, -1}; // in_process、buffered 阶段的标准输入输出管道端，-1 表示不修改
+            std::string output;        // buffered 阶段的输出
+            std::thread writer;        // 输出超过管道容量时负责写完并关闭管道的线程
+        };
+
+        /**
+         * @brief 是否是可以在内存管道中运行的内置命令
+         *
+         * 这些命令只通过 std::cout 和 MemoryStdio 读写标准输入输出，除 read 外不修改 shell 的状态。
+         *
+         * @param command 命令名
+         * @return bool 是否可以
+         */
+        static bool isMemoryPipelineBuiltin(const std::string &command);
+
+        /**
+         * @brief 在 shell 进程中依次运行全部由内置命令组成的管道
+         *
+         * 每个阶段写到 std::cout 的输出保存在内存中，作为下一个阶段的输入，
+         * 最后一个阶段的输出写到标准输出。各阶段按子 shell 的语义运行：read 赋值的变量在阶段结束后恢复。
+         *
+         * @param nodes 管道各阶段，都是没有重定向和进程替换的内置命令
+         * @return int 最后一个阶段的状态码；打开 pipefail 时为最后一个失败阶段的状态码
+         */
+        int executeMemoryPipeline(const std::vector<const Node *> &nodes);
+
+        /**
+         * @brief 在父进程中准备一个阶段
+         *
+         * 外部命令在这里查找路径、展开重定向；找不到时报告错误并把状态设为 127，
+         * 重定向失败时设为 1。
+         *
+         * @param stage 阶段
+         */
+        void preparePipelineStage(PipelineStage &stage);
+
+        /**
+         * @brief 是否是管道中可以直接在 shell 进程中运行的内置命令
+         *
+         * 这些命令不修改 shell 的状态，只读写标准输入输出，不需要 fork 一个 shell 副本。
+         *
+         * @param command 命令名
+         * @return bool 是否可以
+         */
+        static bool isInProcessBuiltin(const std::string &command);
+
+        /**
+         * @brief 是否是只产生输出的内置命令
+         *
+         * 这些命令不读标准输入、不修改 shell 的状态，输出量小，在管道中先在 shell 进程中
+         * 运行并把输出暂存在内存中，再写入管道。
+         *
+         * @param command 命令名
+         * @return bool 是否是
+         */
+        static bool isProducerBuiltin(const std::string &command);
+
+        /**
+         * @brief 在 shell 进程中运行 buffered 阶段，输出保存到 stage.output
+         *
+         * @param stage 阶段
+         */
+        void runBufferedStage(PipelineStage &stage);
+
+        /**
+         * @brief 把 buffered 阶段的输出写入它的管道
+         *
+         * 放得进管道缓冲区时直接写入并关闭管道；否则交给写线程，读者读多少写多少，
+         * shell 不会阻塞。
+         *
+         * @param stage 阶段
+         */
+        void writeBufferedOutput(PipelineStage &stage);
+
+        /**
+         * @brief 在 shell 进程中运行 in_process 阶段
+         *
+         * 把阶段的管道端接到标准输入输出，执行命令后恢复。其余阶段都已经启动，
+         * 读写管道不会因为对端还没有运行而阻塞。
+         *
+         * @param stage 阶段
+         */
+        void runInProcessStage(PipelineStage &stage);
+
+        /**
+         * @brief 启动命令的进程替换
+         *
+         * 每个 <(cmd)、>(cmd) 在后台子进程中执行，通过管道与命令相连；
+         * args 中对应的参数换成 /dev/fd/N。子进程登记到作业控制中回收。
+         *
+         * @param command 命令节点
+         * @param args 参数列表，原地替换
+         * @param fds 输出参数，父进程中打开的管道端，命令结束后由调用者关闭
+         * @return bool 是否成功，失败时已输出错误信息并关闭 fds
+         */
+        bool startProcessSubstitutions(const CommandNode *command, std::vector<std::string> &args,
+                                       std::vector<int> &fds);
+
+        /**
+         * @brief 展开命令的参数
+         *
+         * 只展开词法分析时记录了分段的参数，纯字面量的参数不再扫描，原样使用。
+         * 进程替换的占位参数是字面量，可以在启动进程替换之后展开。
+         *
+         * @param command 命令节点
+         * @param args 参数列表，原地替换为展开结果
+         */
+        void expandArgs(const CommandNode *command, std::vector<std::string> &args);
+
+        /**
+         * @brief 设置阶段的描述符操作
+         *
+         * @param stage 阶段
+         * @param input 作为标准输入的管道读端，-1 表示不修改
+         * @param output 作为标准输出的管道写端，-1 表示不修改
+         * @param pipe_fds 启动时打开着、子进程中需要关闭的管道描述符
+         */
+        void setPipelineActions(PipelineStage &stage, int input, int output, const std::vector<int> &pipe_fds) const;
+
+        /**
+         * @brief 启动一个阶段
+         *
+         * @param stage 阶段
+         */
+        void launchPipelineStage(PipelineStage &stage);
+
+        /**
+         * @brief 重试失败的启动并报告错误
+         *
+         * @param stage 阶段
+         */
+        void finishPipelineStage(PipelineStage &stage);
+
+        /**
+         * @brief 依次创建管道并启动各阶段
+         *
+         * @param stages 各阶段
+         * @param use_pgid 是否把管道放进新的进程组
+         * @param pipe_size 管道缓冲区大小（字节），0 表示系统默认
+         */
+        void launchPipelineSequential(std::vector<PipelineStage> &stages, bool use_pgid, size_t pipe_size);
+
+        /**
+         * @brief 预先创建全部管道，由线程池并行启动外部命令阶段
+         *
+         * 创建管道失败时关闭已创建的管道，改用 launchPipelineSequential 启动。
+         *
+         * @param stages 各阶段
+         * @param pool 线程池
+         * @param use_pgid 是否把管道放进新的进程组
+         * @param pipe_size 管道缓冲区大小（字节），0 表示系统默认
+         * @return size_t 并行启动的阶段数
+         */
+        size_t launchPipelineParallel(std::vector<PipelineStage> &stages, ThreadPool *pool, bool use_pgid,
+                                      size_t pipe_size);
+
+        /**
+         * @brief 获取非特权进程可以设置的最大管道缓冲区
+         *
+         * @return size_t /proc/sys/fs/pipe-max-size 的值（字节）
+         */
+        size_t getPipeMaxSize();
+
+        /**
+         * @brief pipesize=auto 时扩大长时间运行的管道的缓冲区
+         *
+         * 最后一个阶段在 PIPE_AUTO_GROW_DELAY_MS 内没有结束时，把仍在运行的阶段的输入管道
+         * 扩大到 pipe-max-size，减少大流量管道的上下文切换。
+         *
+         * @param stages 已启动的各阶段
+         */
+        void growLongRunningPipes(const std::vector<PipelineStage> &stages);
+
+        /**
+         * @brief 获取并行创建进程用的线程池
+         *
+         * @return ThreadPool* 线程池指针；只有一个 CPU 或在 fork 出的子进程中时为 nullptr
+         */
+        ThreadPool *getSpawnPool();
+
+        /**
+         * @brief 为工作线程中创建的阶段选择后端
+         *
+         * @param plan 进程创建信息
+         * @return SpawnBackend* vfork 或 posix_spawn 后端
+         */
+        SpawnBackend *selectParallelSpawnBackend(const SpawnPlan &plan) const;
+
         /**
          * @brief 执行列表
          *
          * @param list 列表节点
+         * @param flags 执行标志，EXEC_TAIL 只传给最后一条命令
          * @return int 执行结果状态码
          */
-        int executeList(const ListNode *list);
+        int executeList(const ListNode *list, int flags);
 
         /**
          * @brief 执行 if 语句
          *
          * @param if_node if 节点
+         * @param flags 执行标志，EXEC_TAIL 只传给 then/else 部分
          * @return int 执行结果状态码
          */
-        int executeIf(const IfNode *if_node);
+        int executeIf(const IfNode *if_node, int flags);
 
         /**
          * @brief 执行 for 循环
@@ -103,9 +359,10 @@ namespace dash
          * @brief 执行 case 语句
          *
          * @param case_node case 节点
+         * @param flags 执行标志
          * @return int 执行结果状态码
          */
-        int executeCase(const CaseNode *case_node);
+        int executeCase(const CaseNode *case_node, int flags);
 
         /**
          * @brief 执行子 shell
@@ -115,17 +372,86 @@ namespace dash
          */
         int executeSubshell(const SubshellNode *subshell);
 
+        /**
+         * @brief 为命令选择进程创建后端
+         *
+         * 子进程需要运行 shell 代码时只能使用 fork；否则优先使用不复制页表的后端。
+         * 指定了 fork 后端但 RSS 已超过 forkthreshold 时，改用 vfork/posix_spawn。
+         *
+         * @param plan 进程创建信息
+         * @return SpawnBackend* 选中的后端
+         */
+        SpawnBackend *selectSpawnBackend(const SpawnPlan &plan);
+
+        /**
+         * @brief 用指定后端创建进程
+         *
+         * 使用 fork 后端时记录耗时，需要时先采样内存占用。
+         *
+         * @param backend 后端
+         * @param plan 进程创建信息
+         * @return SpawnResult 创建结果
+         */
+        SpawnResult spawnWith(SpawnBackend *backend, const SpawnPlan &plan);
+
+        /**
+         * @brief 记录一次 fork 的耗时，打开 forkstats 时输出统计信息
+         *
+         * @param elapsed_us fork 耗时（微秒）
+         */
+        void recordFork(long elapsed_us);
+
+        /**
+         * @brief fork 前采样内存占用
+         *
+         * 只在打开 forkstats 时采样；选择后端时已经采样过的，直接沿用那次的结果。
+         */
+        void sampleBeforeFork();
+
+        /**
+         * @brief 处理可以重试的进程创建失败
+         *
+         * 命令哈希表中的路径已失效（ENOENT）时重新查找；exec 报告 ENOEXEC 时
+         * 改用 fork 后端，由子进程解释脚本。
+         *
+         * @param command 用户输入的命令名
+         * @param plan 进程创建信息，重新查找后会更新命令路径
+         * @param result 第一次创建的结果
+         * @return SpawnResult 最终结果
+         */
+        SpawnResult retrySpawn(const std::string &command, SpawnPlan &plan, SpawnResult result);
+
+        /**
+         * @brief 报告进程创建失败并返回对应状态码
+         *
+         * @param plan 进程创建信息
+         * @param result 创建结果
+         * @return int 状态码（命令不存在为 127，无法执行为 126，重定向失败为 1）
+         */
+        int reportSpawnError(const SpawnPlan &plan, const SpawnResult &result) const;
+
+        /**
+         * @brief 等待子进程结束
+         *
+         * @param pid 子进程 PID
+         * @param usage 输出参数，子进程的资源使用情况，为 nullptr 时不记录
+         * @return int 子进程状态码
+         */
+        int waitForChild(pid_t pid, struct rusage *usage = nullptr) const;
+
         /**
          * @brief 执行外部命令
          *
          * @param command 命令
-         * @param args 参数列表
-         * @param redirections 重定向列表
-         * @param background 是否后台运行
+         * @param args 参数列表（包含命令名）
+         * @param redirections 重定向计划
+         * @param flags 执行标志，带 EXEC_TAIL 时直接在当前进程 exec
+         * @param inherited_fds 需要传给命令的描述符（进程替换的管道）
          * @return int 执行结果状态码
          */
         int executeExternalCommand(const std::string &command, const std::vector<std::string> &args,
-                                   const std::vector<Redirection> &redirections, bool background);
+                                   const RedirectionPlan &redirections, int flags,
+                                   const std::vector<int> &inherited_fds);
 
         /**
          * @brief 检查是否是内置命令
@@ -150,11 +476,23 @@ namespace dash
         void registerBuiltins();
 
     public:
+        /**
+         * @brief 执行标志
+         */
+        enum ExecFlags
+        {
+            EXEC_NONE = 0,
+            EXEC_TAIL = 1,  // 节点是本进程执行的最后一条命令，外部命令可以直接 exec 而不 fork
+            EXEC_FORKED = 2 // 后台简单命令已经在自己的子进程中运行，不再当作后台命令
+        };
+
         /**
          * @brief 在子进程中执行命令
          *
+         * 直接 exec，不返回。
+         *
          * @param command 命令
-         * @param args 参数列表
+         * @param args 参数列表（包含命令名）
          */
         void exec_in_child(const std::string &command, const std::vector<std::string> &args);
 
@@ -174,9 +512,59 @@ namespace dash
          * @brief 执行节点
          *
          * @param node 节点
+         * @param flags 执行标志
          * @return int 执行结果状态码
          */
-        int execute(const Node *node);
+        int execute(const Node *node, int flags = EXEC_NONE);
+
+        /**
+         * @brief 在 fork 出的子进程中执行节点并退出
+         *
+         * 最后一条外部命令直接 exec；exit 内置命令以其状态码退出。
+         *
+         * @param node 节点
+         * @param flags 附加的执行标志，EXEC_TAIL 总是带上
+         */
+        [[noreturn]] void executeAndExit(const Node *node, int flags = EXEC_NONE);
+
+        /**
+         * @brief fork 一个运行 shell 代码的子进程
+         *
+         * 记录 fork 耗时，打开 forkstats 时先采样内存占用，其余与 fork() 相同。
+         *
+         * @return pid_t 与 fork() 相同
+         */
+        pid_t forkProcess();
+
+        /**
+         * @brief 获取 fork 开销监控
+         *
+         * @return ForkMonitor* 监控对象指针
+         */
+        ForkMonitor *getForkMonitor() const { return fork_monitor_.get(); }
+
+        /**
+         * @brief 忘记缓存的 /dev/null 描述符
+         *
+         * 子进程关闭了所有 close-on-exec 描述符后调用，之后需要时重新打开。
+         */
+        void forgetDevNull() { dev_null_fd_ = -1; }
+
+        /**
+         * @brief 执行管道
+         *
+         * 外部命令阶段在父进程中准备好参数和描述符操作，由进程创建后端直接启动；
+         * 其余阶段 fork 后执行，不再为每一级管道复制一个 shell。外部命令阶段较多时
+         * 预先创建全部管道，由线程池并行调用 posix_spawn/vfork；否则边创建管道边启动。
+         * 作业控制打开时各阶段加入以第一个阶段为组长的进程组。前台管道结束后
+         * PIPESTATUS 为各阶段的状态（以空格分隔）。变量 DASH_PIPELINE_STATS
+         * 非空时在标准错误输出启动耗时。
+         *
+         * @param nodes 管道各阶段，从左到右
+         * @param background 是否在后台运行（不等待）
+         * @return int 最后一个阶段的状态码；打开 pipefail 时为最后一个失败阶段的状态码
+         */
+        int executePipeline(const std::vector<const Node *> &nodes, bool background = false);
 
         /**
          * @brief 获取上一次执行状态
@@ -192,6 +580,74 @@ namespace dash
          */
         void setLastStatus(int status) { last_status_ = status; }
 
+        /**
+         * @brief 设置进程创建后端
+         *
+         * @param type 后端类型，AUTO 表示自动选择
+         */
+        void setSpawnBackend(SpawnBackendType type);
+
+        /**
+         * @brief 获取进程创建后端设置
+         *
+         * @return SpawnBackendType 后端类型
+         */
+        SpawnBackendType getSpawnBackend() const;
+
+        /**
+         * @brief 启动 zygote 辅助进程
+         *
+         * 应在 shell 启动早期、堆还很小的时候调用。启动后自动选择时外部命令优先交给辅助进程创建。
+         *
+         * @return bool 是否成功
+         */
+        bool startZygote();
+
+        /**
+         * @brief 获取命令哈希表
+         *
+         * @return CommandTable* 命令哈希表指针
+         */
+        CommandTable *getCommandTable() const { return command_table_.get(); }
+
+        /**
+         * @brief 获取内存管道中当前阶段的输入
+         *
+         * @return MemoryStdio* 不在内存管道中运行时为 nullptr
+         */
+        MemoryStdio *getMemoryStdio() const { return memory_stdio_; }
+
+        /**
+         * @brief 为内置命令读一行标准输入
+         *
+         * 在内存管道中从前一个阶段的输出读，否则逐字节读描述符 0，不多读下一行的内容。
+         *
+         * @param line 输出参数，读到的内容，不含换行符
+         * @return bool 是否读到了换行符；读到文件末尾或出错时为 false
+         */
+        bool readInputLine(std::string &line);
+
+        /**
+         * @brief 用外部命令替换 shell 进程（exec cmd）
+         *
+         * 先停止 zygote 辅助进程，避免它成为新程序的子进程。
+         *
+         * @param args 命令及参数
+         * @return int 失败时的状态码（找不到为 127，不能执行为 126）；成功时不返回
+         */
+        int replaceShell(const std::vector<std::string> &args);
+
+        /**
+         * @brief 查找外部命令的完整路径
+         *
+         * 命令名含 '/' 时原样返回；否则通过命令哈希表查找。
+         *
+         * @param command 命令名
+         * @param count_hit 是否计入命中次数
+         * @return std::string 完整路径，找不到时为空
+         */
+        std::string findCommand(const std::string &command, bool count_hit = true);
+
         /**
          * @brief 获取 Shell 对象
          *
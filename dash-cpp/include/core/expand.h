@@ -10,6 +10,7 @@
 #include <vector>
 #include <memory>
 #include "../dash.h"
+#include "core/lexer.h"
 
 namespace dash {
 
@@ -60,6 +61,19 @@ public:
      */
     ExpandResult expandWord(const std::string& word);
 
+    /**
+     * @brief 按词法分析器记录的分段展开单词
+     * 
+     * 引号和转义已经由分段去掉，不再扫描单词：只展开参数、命令替换和波浪线段，
+     * 只对不加引号的展开结果按 IFS 分词，只在有不加引号的元字符时匹配路径名。
+     * 
+     * @param word 单词的值
+     * @param segments 单词的分段
+     * @param fields 输出参数，追加展开得到的字段，展开为空的单词不产生字段
+     */
+    void expandSegments(const std::string& word, const std::vector<WordSegment>& segments,
+                        std::vector<std::string>& fields);
+
     /**
      * @brief 执行路径扩展
      * 
@@ -0,0 +1,105 @@
+/**
+ * @file fork_monitor.h
+ * @brief fork 开销监控定义
+ */
+
+#ifndef DASH_FORK_MONITOR_H
+#define DASH_FORK_MONITOR_H
+
+#include <cstddef>
+
+namespace dash
+{
+
+    /**
+     * @brief 进程内存占用
+     */
+    struct MemoryUsage
+    {
+        long rss_kb = -1; // VmRSS，读取失败时为 -1
+        long pte_kb = -1; // VmPTE（页表大小），读取失败时为 -1
+    };
+
+    /**
+     * @brief fork 开销监控
+     *
+     * fork 需要复制整个页表，耗时随常驻内存增长。检查阈值或打开 forkstats 时，
+     * fork 前从 /proc/self/status 采样一次 VmRSS/VmPTE，并累计 fork 耗时，
+     * 供自适应选择后端和 set -o forkstats 使用。
+     */
+    class ForkMonitor
+    {
+    private:
+        MemoryUsage last_;         // 最近一次采样
+        long peak_rss_kb_;         // 采样到的最大 RSS
+        long peak_pte_kb_;         // 采样到的最大页表大小
+        unsigned long forks_;      // fork 次数
+        unsigned long avoided_;    // 因超过阈值改用 vfork/posix_spawn 的次数
+        long total_us_;            // fork 总耗时（微秒）
+        long max_us_;              // 单次 fork 最大耗时（微秒）
+        bool sampled_;             // 下一次 fork 前是否已经采样
+
+    public:
+        /**
+         * @brief 构造函数
+         */
+        ForkMonitor();
+
+        /**
+         * @brief 读取当前进程的内存占用
+         *
+         * @return MemoryUsage 内存占用
+         */
+        static MemoryUsage readMemoryUsage();
+
+        /**
+         * @brief 采样内存占用并更新峰值
+         *
+         * @return const MemoryUsage& 本次采样
+         */
+        const MemoryUsage &sample();
+
+        /**
+         * @brief 采样并检查 RSS 是否达到阈值
+         *
+         * @param threshold_kb 阈值（KB），0 表示不限制
+         * @return true RSS 已达到阈值，应避免 fork
+         * @return false 未达到或无法读取
+         */
+        bool exceeds(size_t threshold_kb);
+
+        /**
+         * @brief 下一次 fork 前是否已经采样
+         *
+         * 选择后端时检查阈值会采样一次，fork 前不必再读 /proc/self/status。
+         */
+        bool hasSample() const { return sampled_; }
+        /**
+         * @brief 记录一次 fork
+         *
+         * @param elapsed_us fork 耗时（微秒）
+         */
+        void recordFork(long elapsed_us);
+
+        /**
+         * @brief 记录一次被避免的 fork
+         */
+        void recordAvoided()
+        {
+            ++avoided_;
+            sampled_ = false;
+        }
+
+        // 统计信息
+        const MemoryUsage &getLastSample() const { return last_; }
+        long getPeakRss() const { return peak_rss_kb_; }
+        long getPeakPte() const { return peak_pte_kb_; }
+        unsigned long getForkCount() const { return forks_; }
+        unsigned long getAvoidedCount() const { return avoided_; }
+        long getTotalTime() const { return total_us_; }
+        long getMaxTime() const { return max_us_; }
+    };
+
+} // namespace dash
+
+#endif // DASH_FORK_MONITOR_H
@@ -54,11 +54,17 @@ namespace dash
 
     /**
      * @brief 文件输入源
+     *
+     * 脚本文件的描述符放在 0-9 以上并带 close-on-exec：0-9 留给脚本自己
+     * （exec 3>>log 不会覆盖正在读的脚本），命令也不会继承它。
      */
     class FileInputSource : public InputSource
     {
     private:
-        std::ifstream file_;
+        int fd_;               // 脚本文件描述符
+        std::string buffer_;   // 已读入、还没有返回的内容
+        size_t pos_;           // buffer_ 中下一行的开始位置
+        bool eof_;             // 是否已经读到文件末尾
         std::string filename_;
 
     public:
@@ -231,6 +237,17 @@ namespace dash
          */
         std::string readLine(bool show_prompt);
 
+        /**
+         * @brief 读取命令的后续一行（Here 文档的正文、跨行的引号和命令替换）
+         *
+         * 与 readLine 不同，能区分空行和输入结束。交互式读取标准输入时先显示 PS2。
+         *
+         * @param line 输出参数，读取的行
+         * @return true 读到一行
+         * @return false 输入结束
+         */
+        bool readContinuationLine(std::string &line);
+
         /**
          * @brief 将文件作为输入源
          *
@@ -259,6 +276,13 @@ namespace dash
          */
         bool popFile();
 
+        /**
+         * @brief 丢弃所有输入源
+         *
+         * 用于子进程改为解释另一个脚本时，之后由调用者压入新的输入源。
+         */
+        void reset();
+
         /**
          * @brief 检查是否到达文件末尾
          *
@@ -6,16 +6,19 @@
 #ifndef DASH_LEXER_H
 #define DASH_LEXER_H
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <memory>
-#include <queue>
+#include <functional>
 
 namespace dash
 {
 
     // 前向声明
     class Shell;
+    struct HereDoc;
 
     /**
      * @brief 词法单元类型
@@ -26,31 +29,70 @@ namespace dash
         ASSIGNMENT,  // 变量赋值（name=value）
         OPERATOR,    // 操作符（|, &, ;, &&, ||, >, <, >> 等）
         IO_NUMBER,   // IO 编号（如 2> 中的 2）
+        PROCESS_SUBST, // 进程替换，值为 < 或 > 加上括号内的命令
         NEWLINE,     // 换行符
         END_OF_INPUT // 输入结束
     };
 
+    /**
+     * @brief 单词中的一段
+     *
+     * 词法分析时记录单词的值由哪些部分组成：引号已经去掉，反斜杠留在值中，但不属于
+     * 任何一段。展开时按段处理，不需要重新扫描单词。
+     */
+    struct WordSegment
+    {
+        enum Kind : uint8_t
+        {
+            LITERAL,       // 不加引号的普通字符，包括反斜杠转义的字符
+            SINGLE_QUOTED, // 单引号中的字符
+            DOUBLE_QUOTED, // 双引号中不展开的字符
+            PARAM,         // 参数展开 $name、${...}、$1、$? 等
+            COMMAND,       // 命令替换 $(cmd) 或 `cmd`
+            ARITH,         // 算术展开 $((expr))
+            GLOB,          // 不加引号的路径名匹配元字符 * ? [
+            TILDE          // 单词开头的 ~ 或 ~user
+        };
+
+        Kind kind;
+        bool quoted;   // 在双引号中：展开的结果不再分词，也不匹配路径名
+        size_t offset; // 在单词的值中的位置
+        size_t length; // 长度
+    };
+
     /**
      * @brief 词法单元类
+     *
+     * 值一般是输入缓冲区中的一段，只保存 string_view，不复制。去掉了引号的单词和
+     * 进程替换的值与输入中的原文不同，才用 text_ 保存自己的副本。
      */
     class Token
     {
     private:
         TokenType type_;
-        std::string value_;
+        std::string_view view_; // 值在输入缓冲区中的位置，owned_ 为 true 时不使用
+        std::string text_;      // 自己保存的值
+        bool owned_;
         int line_number_;
         int column_;
+        bool quoted_; // 单词中出现过引号或反斜杠
+        std::vector<WordSegment> segments_; // 单词的分段，值就是展开结果时为空
 
     public:
+        /**
+         * @brief 默认构造函数，构造空的 END_OF_INPUT 词法单元
+         */
+        Token();
+
         /**
          * @brief 构造函数
          *
          * @param type 词法单元类型
-         * @param value 词法单元值
+         * @param value 词法单元值，不复制，调用者保证它在词法单元使用期间有效
          * @param line_number 行号
          * @param column 列号
          */
-        Token(TokenType type, const std::string &value, int line_number, int column);
+        Token(TokenType type, std::string_view value, int line_number, int column);
 
         /**
          * @brief 获取词法单元类型
@@ -62,9 +104,29 @@ namespace dash
         /**
          * @brief 获取词法单元值
          *
-         * @return const std::string& 词法单元值
+         * @return std::string_view 词法单元值
+         */
+        std::string_view getValue() const { return owned_ ? std::string_view(text_) : view_; }
+
+        /**
+         * @brief 设置值并由词法单元自己保存
+         *
+         * @param text 值
+         */
+        void setText(std::string text);
+
+        /**
+         * @brief 值还指向输入缓冲区时复制一份自己保存
          */
-        const std::string &getValue() const { return value_; }
+        void materialize();
+
+        /**
+         * @brief 值指向 from 中的一段时改为指向 to 中相同位置的一段
+         *
+         * @param from 原来的缓冲区
+         * @param to 内容相同的另一个缓冲区，不短于 from
+         */
+        void rebase(std::string_view from, std::string_view to);
 
         /**
          * @brief 获取行号
@@ -80,6 +142,35 @@ namespace dash
          */
         int getColumn() const { return column_; }
 
+        /**
+         * @brief 单词中是否出现过引号或反斜杠
+         *
+         * @return bool 是否有引用
+         */
+        bool isQuoted() const { return quoted_; }
+
+        /**
+         * @brief 设置引用标志
+         *
+         * @param quoted 是否有引用
+         */
+        void setQuoted(bool quoted) { quoted_ = quoted; }
+
+        /**
+         * @brief 获取单词的分段
+         *
+         * @return const std::vector<WordSegment>& 分段列表，为空表示单词是纯字面量，
+         *         不需要展开、去引号和路径名匹配
+         */
+        const std::vector<WordSegment> &getSegments() const { return segments_; }
+
+        /**
+         * @brief 设置单词的分段
+         *
+         * @param segments 分段列表
+         */
+        void setSegments(std::vector<WordSegment> segments) { segments_ = std::move(segments); }
+
         /**
          * @brief 将词法单元转换为字符串
          *
@@ -88,19 +179,42 @@ namespace dash
         std::string toString() const;
     };
 
+    /**
+     * @brief 预先分析好的词法单元序列
+     *
+     * ParallelLexer 并行分析脚本的结果，每一行命令的词法单元与逐行读取脚本时解析器
+     * 看到的相同，值指向脚本的原文。
+     */
+    struct TokenStream
+    {
+        std::vector<Token> tokens;               // 所有命令的词法单元，不含换行符
+        std::vector<size_t> commands;            // 每一行命令最后一个词法单元之后的下标，空行不算
+        std::vector<std::string> heredoc_bodies; // Here 文档的正文，按出现的顺序
+        size_t next_heredoc = 0;                 // 下一个要取出的正文
+    };
+
     /**
      * @brief 词法分析器类
      */
     class Lexer
     {
     private:
+        static constexpr size_t LOOKAHEAD = 8; // 前瞻缓冲区的容量，必须是 2 的幂
+
         Shell *shell_;
         std::string input_;
         size_t position_;
         int line_number_;
         int column_;
-        std::queue<std::unique_ptr<Token>> token_queue_;
+        Token lookahead_[LOOKAHEAD]; // 环形前瞻缓冲区，保存 peekToken 读出和 ungetToken 放回的词法单元
+        size_t lookahead_head_;      // 第一个词法单元的下标
+        size_t lookahead_count_;     // 缓冲区中词法单元的数量
         bool eof_seen_;
+        std::vector<std::shared_ptr<HereDoc>> pending_heredocs_; // 等待读取正文的 Here 文档
+        std::function<bool(std::string &)> line_reader_;         // 输入不够时读取下一行，可以为空
+        TokenStream *stream_;  // 不为空时从中依次取出词法单元，不分析输入
+        size_t stream_pos_;    // 下一个要取出的词法单元
+        size_t stream_end_;    // 取到这里为止
 
         /**
          * @brief 获取当前字符
@@ -114,6 +228,13 @@ namespace dash
          */
         void advance();
 
+        /**
+         * @brief 一次前进到 end，更新行号和列号
+         *
+         * @param end 新的位置，不超过输入末尾
+         */
+        void advanceTo(size_t end);
+
         /**
          * @brief 前瞻一个字符
          *
@@ -126,19 +247,41 @@ namespace dash
          */
         void skipWhitespace();
 
+        /**
+         * @brief 获取输入中从 start 到当前位置的一段
+         *
+         * @param start 起始位置
+         * @return std::string_view 指向输入缓冲区的一段
+         */
+        std::string_view slice(size_t start) const;
+
+        /**
+         * @brief 从输入中扫描下一个词法单元，不经过前瞻缓冲区
+         *
+         * @return Token 词法单元
+         */
+        Token scanToken();
+
         /**
          * @brief 解析单词
          *
-         * @return std::unique_ptr<Token> 单词词法单元
+         * @return Token 单词词法单元
          */
-        std::unique_ptr<Token> parseWord();
+        Token parseWord();
 
         /**
          * @brief 解析操作符
          *
-         * @return std::unique_ptr<Token> 操作符词法单元
+         * @return Token 操作符词法单元
+         */
+        Token parseOperator();
+
+        /**
+         * @brief 解析进程替换 <(cmd) 或 >(cmd)
+         *
+         * @return Token 进程替换词法单元
          */
-        std::unique_ptr<Token> parseOperator();
+        Token parseProcessSubstitution();
 
         /**
          * @brief 解析注释
@@ -163,6 +306,35 @@ namespace dash
          */
         bool isOperatorChar(char c) const;
 
+        /**
+         * @brief 读取所有等待中的 Here 文档正文
+         *
+         * 在换行符之后或输入结束时调用，正文从当前位置开始，到只含定界符的一行为止。
+         */
+        void readHereDocs();
+
+        /**
+         * @brief 通过 line_reader_ 向输入追加一行
+         *
+         * 追加可能使输入缓冲区重新分配，前瞻缓冲区中的词法单元先改为保存自己的副本。
+         *
+         * @param continuation 为 true 时输入在一个单词中间结束，新的一行接在换行符之后
+         *                     （输入末尾没有换行符）；为 false 时追加 Here 文档正文的一行
+         * @return bool 是否读到了新的一行
+         */
+        bool readMoreInput(bool continuation = false);
+
+        /**
+         * @brief 在输入末尾处还没有结束的引号、命令替换或反斜杠之后继续读入下一行
+         *
+         * 已经分析的部分和当前的状态（引号、括号的嵌套）保持不变，只分析新读入的内容，
+         * 粘贴多行内容时总的分析时间与输入长度成正比。
+         *
+         * @return bool 是否读到了新的一行；当前位置不在输入的最后一个字符或末尾、
+         *              或者没有更多输入时为 false
+         */
+        bool continueLine();
+
     public:
         /**
          * @brief 构造函数
@@ -175,29 +347,64 @@ namespace dash
          * @brief 设置输入
          *
          * @param input 输入字符串
+         * @param line_reader 输入不够时（Here 文档的正文、跨行的引号和命令替换）读取下一行，
+         *                    读到时返回 true；为空表示输入只有 input
+         */
+        void setInput(std::string_view input, std::function<bool(std::string &)> line_reader = nullptr);
+
+        /**
+         * @brief 改为依次返回 stream 中已经分析好的词法单元
+         *
+         * 取完 [begin, end) 后返回 END_OF_INPUT；其间登记的 Here 文档依次取用
+         * stream 中的正文。下一次 setInput 时恢复分析输入。
+         *
+         * @param stream 词法单元序列，词法单元被移走
+         * @param begin 第一个词法单元的下标
+         * @param end 最后一个词法单元之后的下标
          */
-        void setInput(const std::string &input);
+        void setTokens(TokenStream *stream, size_t begin, size_t end);
+
+        /**
+         * @brief 把指向输入缓冲区的值改为指向 source 中相同的位置
+         *
+         * 词法单元要在输入被替换之后继续使用、而 source 与输入内容相同时使用，不必复制值。
+         *
+         * @param token 刚由 nextToken 返回的词法单元
+         * @param source 与当前输入内容相同的文本
+         */
+        void rebase(Token &token, std::string_view source) const;
+
+        /**
+         * @brief 登记一个 Here 文档，下一个换行符之后读取它的正文
+         *
+         * @param heredoc Here 文档
+         */
+        void addHereDoc(std::shared_ptr<HereDoc> heredoc);
 
         /**
          * @brief 获取下一个词法单元
          *
-         * @return std::unique_ptr<Token> 下一个词法单元
+         * 值可能指向输入缓冲区，在下一次 setInput 或读取 Here 文档正文之前有效，
+         * 需要保留的值由调用者复制。
+         *
+         * @return Token 下一个词法单元
          */
-        std::unique_ptr<Token> nextToken();
+        Token nextToken();
 
         /**
          * @brief 前瞻下一个词法单元
          *
-         * @return const Token* 下一个词法单元的指针，不转移所有权
+         * @return const Token* 下一个词法单元的指针，在下一次 nextToken 之前有效
          */
         const Token *peekToken();
 
         /**
-         * @brief 将词法单元放回队列
+         * @brief 将词法单元放回前瞻缓冲区，下一次 nextToken 首先返回它
          *
          * @param token 要放回的词法单元
+         * @throws ShellException 前瞻缓冲区已满
          */
-        void ungetToken(std::unique_ptr<Token> token);
+        void ungetToken(Token token);
     };
 
 } // namespace dash
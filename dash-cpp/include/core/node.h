@@ -10,6 +10,8 @@
 #include <vector>
 #include <memory>
 #include "../dash.h"
+#include "core/lexer.h"
+#include "core/redirection.h"
 
 namespace dash
 {
@@ -17,32 +19,6 @@ namespace dash
     // 前向声明
     class Shell;
 
-    /**
-     * @brief 重定向类型
-     */
-    enum class RedirType
-    {
-        REDIR_INPUT,      // <
-        REDIR_OUTPUT,     // >
-        REDIR_APPEND,     // >>
-        REDIR_INPUT_DUP,  // <&
-        REDIR_OUTPUT_DUP, // >&
-        REDIR_HEREDOC     // <<
-    };
-
-    /**
-     * @brief 重定向结构体
-     */
-    struct Redirection
-    {
-        RedirType type;       // 重定向类型
-        int fd;               // 文件描述符
-        std::string filename; // 文件名或目标文件描述符
-
-        Redirection(RedirType t, int f, const std::string &fn)
-            : type(t), fd(f), filename(fn) {}
-    };
-
     /**
      * @brief 节点基类
      */
@@ -79,6 +55,27 @@ namespace dash
         virtual void print(int indent = 0) const = 0;
     };
 
+    /**
+     * @brief 进程替换 <(cmd) 或 >(cmd)
+     *
+     * 执行时替换成 /dev/fd/N，N 是连接到后台子进程的管道。
+     */
+    struct ProcessSubstitution
+    {
+        size_t arg_index;              // 在参数列表中的位置
+        bool output;                   // >(cmd)：命令写入管道，子进程从管道读
+        std::unique_ptr<Node> command; // 子进程执行的命令
+    };
+
+    /**
+     * @brief 需要展开的参数
+     */
+    struct ArgExpansion
+    {
+        size_t arg_index;                  // 在参数列表中的位置
+        std::vector<WordSegment> segments; // 词法分析器记录的分段
+    };
+
     /**
      * @brief 命令节点
      */
@@ -86,8 +83,11 @@ namespace dash
     {
     private:
         std::vector<std::string> args_;
+        std::vector<ArgExpansion> expansions_; // 不是纯字面量的参数，按位置排列
         std::vector<std::string> assignments_;
+        std::vector<ProcessSubstitution> process_substitutions_;
         std::vector<Redirection> redirections_;
+        RedirectionPlan redirection_plan_; // 解析时编译好的重定向
         bool background_; // 是否在后台运行
 
     public:
@@ -115,8 +115,9 @@ namespace dash
          * @brief 添加参数
          *
          * @param arg 参数
+         * @param segments 参数的分段，为空表示纯字面量，执行时原样使用
          */
-        void addArg(const std::string &arg);
+        void addArg(const std::string &arg, const std::vector<WordSegment> &segments = {});
 
         /**
          * @brief 添加变量赋值
@@ -126,12 +127,29 @@ namespace dash
         void addAssignment(const std::string &assignment);
 
         /**
-         * @brief 添加重定向
+         * @brief 添加重定向并编译到重定向计划中
          *
          * @param redir 重定向
+         * @throw ShellException 重定向无效时抛出语法错误
          */
         void addRedirection(const Redirection &redir);
 
+        /**
+         * @brief 添加进程替换参数
+         *
+         * @param text 原文，执行前作为占位参数
+         * @param output 是否是 >(cmd)
+         * @param command 子进程执行的命令
+         */
+        void addProcessSubstitution(const std::string &text, bool output, std::unique_ptr<Node> command);
+
+        /**
+         * @brief 获取进程替换
+         *
+         * @return const std::vector<ProcessSubstitution>& 进程替换列表
+         */
+        const std::vector<ProcessSubstitution> &getProcessSubstitutions() const { return process_substitutions_; }
+
         /**
          * @brief 获取参数
          *
@@ -139,6 +157,13 @@ namespace dash
          */
         const std::vector<std::string> &getArgs() const { return args_; }
 
+        /**
+         * @brief 获取需要展开的参数
+         *
+         * @return const std::vector<ArgExpansion>& 需要展开的参数，为空时所有参数都原样使用
+         */
+        const std::vector<ArgExpansion> &getArgExpansions() const { return expansions_; }
+
         /**
          * @brief 获取变量赋值
          *
@@ -153,6 +178,13 @@ namespace dash
          */
         const std::vector<Redirection> &getRedirections() const { return redirections_; }
 
+        /**
+         * @brief 获取编译好的重定向计划
+         *
+         * @return const RedirectionPlan& 重定向计划
+         */
+        const RedirectionPlan &getRedirectionPlan() const { return redirection_plan_; }
+
         /**
          * @brief 打印节点
          *
@@ -163,37 +195,36 @@ namespace dash
 
     /**
      * @brief 管道节点
+     *
+     * 按从左到右的顺序保存管道的各个阶段。
      */
     class PipeNode : public Node
     {
     private:
-        std::unique_ptr<Node> left_;
-        std::unique_ptr<Node> right_;
+        std::vector<std::unique_ptr<Node>> commands_;
         bool background_;
 
     public:
         /**
          * @brief 构造函数
          *
-         * @param left 左子节点
-         * @param right 右子节点
          * @param background 是否在后台运行
          */
-        PipeNode(std::unique_ptr<Node> left, std::unique_ptr<Node> right, bool background = false);
+        explicit PipeNode(bool background = false);
 
         /**
-         * @brief 获取左子节点
+         * @brief 添加一个阶段
          *
-         * @return Node* 左子节点指针
+         * @param command 命令节点
          */
-        Node *getLeft() const { return left_.get(); }
+        void addCommand(std::unique_ptr<Node> command);
 
         /**
-         * @brief 获取右子节点
+         * @brief 获取各个阶段
          *
-         * @return Node* 右子节点指针
+         * @return const std::vector<std::unique_ptr<Node>>& 阶段列表
          */
-        Node *getRight() const { return right_.get(); }
+        const std::vector<std::unique_ptr<Node>> &getCommands() const { return commands_; }
 
         /**
          * @brief 是否在后台运行
@@ -479,6 +510,7 @@ namespace dash
     private:
         std::unique_ptr<Node> commands_;
         std::vector<Redirection> redirections_;
+        RedirectionPlan redirection_plan_; // 解析时编译好的重定向
 
     public:
         /**
@@ -489,9 +521,10 @@ namespace dash
         explicit SubshellNode(std::unique_ptr<Node> commands);
 
         /**
-         * @brief 添加重定向
+         * @brief 添加重定向并编译到重定向计划中
          *
          * @param redir 重定向
+         * @throw ShellException 重定向无效时抛出语法错误
          */
         void addRedirection(const Redirection &redir);
 
@@ -509,6 +542,13 @@ namespace dash
          */
         const std::vector<Redirection> &getRedirections() const { return redirections_; }
 
+        /**
+         * @brief 获取编译好的重定向计划
+         *
+         * @return const RedirectionPlan& 重定向计划
+         */
+        const RedirectionPlan &getRedirectionPlan() const { return redirection_plan_; }
+
         /**
          * @brief 打印节点
          *
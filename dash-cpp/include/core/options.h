@@ -0,0 +1,201 @@
+/**
+ * @file options.h
+ * @brief Shell 选项（set -o）定义
+ */
+
+#ifndef DASH_OPTIONS_H
+#define DASH_OPTIONS_H
+
+#include <string>
+#include <cstddef>
+#include <ostream>
+#include "core/spawn.h"
+#include "core/char_class.h"
+
+namespace dash
+{
+
+    /**
+     * @brief Shell 选项
+     *
+     * 保存 set -o/+o 可以修改的选项。开关选项用 set -o name / set +o name 设置，
+     * 数值和选择选项用 set -o name=value 设置。
+     */
+    class ShellOptions
+    {
+    private:
+        bool fork_stats_;          // forkstats：每次 fork 前后输出内存占用和耗时
+        size_t fork_threshold_kb_; // forkthreshold：RSS 超过此值（KB）时不再 fork 外部命令，0 表示不限制
+        int spawn_backend_;        // spawn：外部命令的进程创建后端（SpawnBackendType）
+        int scan_method_;          // scan：词法分析器批量扫描字符的实现（ScanMethod）
+        bool pipefail_;            // pipefail：管道的状态取最后一个失败阶段的状态
+        bool multios_;             // multios：同一描述符的多个输出重定向同时写入所有文件
+        bool io_uring_;            // iouring：命令替换、Here 文档和内置命令输出使用 io_uring
+        bool no_exec_;             // noexec：非交互 shell 只读入并解析命令，不执行
+        size_t pipe_size_kb_;      // pipesize：管道缓冲区大小（KB），0 为系统默认，SIZE_AUTO 为自动
+
+        /**
+         * @brief 选项类型
+         */
+        enum class Kind
+        {
+            FLAG,  // 开关
+            SIZE,      // 数值，可带 k/m/g 后缀
+            SIZE_AUTO, // 数值或 auto
+            CHOICE     // 从固定的几个名字中选择
+        };
+
+        /**
+         * @brief 选项表项
+         */
+        struct Entry
+        {
+            const char *name;
+            Kind kind;
+            bool ShellOptions::*flag;
+            size_t ShellOptions::*size;
+            int ShellOptions::*choice;
+            const char *const *choices; // CHOICE 选项可选的名字，以 nullptr 结尾
+        };
+
+        static const Entry entries_[];
+
+        /**
+         * @brief 查找选项
+         *
+         * @param name 选项名
+         * @return const Entry* 表项，找不到时为 nullptr
+         */
+        static const Entry *find(const std::string &name);
+
+        /**
+         * @brief 把数值或选择选项的当前值转换成文本
+         *
+         * @param entry 表项
+         * @return std::string 当前值
+         */
+        std::string formatValue(const Entry &entry) const;
+
+    public:
+        static constexpr size_t SIZE_AUTO = static_cast<size_t>(-1); // SIZE_AUTO 选项设为 auto 时的值
+
+        /**
+         * @brief 构造函数，所有选项取默认值
+         */
+        ShellOptions();
+
+        /**
+         * @brief 打开或关闭开关选项
+         *
+         * @param name 选项名
+         * @param value 是否打开
+         * @return bool 选项存在且是开关选项时返回 true
+         */
+        bool setFlag(const std::string &name, bool value);
+
+        /**
+         * @brief 设置数值或选择选项
+         *
+         * @param name 选项名
+         * @param value 数值，可带 k/m/g 后缀（单位 KB）；或可选的名字之一
+         * @return bool 选项存在且数值有效时返回 true
+         */
+        bool setValue(const std::string &name, const std::string &value);
+
+        /**
+         * @brief 输出所有选项的当前值（set -o）
+         *
+         * @param out 输出流
+         */
+        void print(std::ostream &out) const;
+
+        /**
+         * @brief 以可重新执行的 set 命令形式输出所有选项（set +o）
+         *
+         * @param out 输出流
+         */
+        void printCommands(std::ostream &out) const;
+
+        /**
+         * @brief 解析带 k/m/g 后缀的大小
+         *
+         * @param text 文本
+         * @param kb 输出参数，以 KB 为单位的大小
+         * @return bool 是否有效
+         */
+        static bool parseSize(const std::string &text, size_t &kb);
+
+        /**
+         * @brief 是否输出 fork 统计信息
+         *
+         * @return bool forkstats 选项
+         */
+        bool getForkStats() const { return fork_stats_; }
+
+        /**
+         * @brief 获取不再 fork 外部命令的 RSS 阈值
+         *
+         * @return size_t 阈值（KB），0 表示不限制
+         */
+        size_t getForkThreshold() const { return fork_threshold_kb_; }
+
+        /**
+         * @brief 是否打开 pipefail
+         *
+         * @return bool pipefail 选项
+         */
+        bool getPipefail() const { return pipefail_; }
+
+        /**
+         * @brief 是否打开 multios
+         *
+         * @return bool multios 选项
+         */
+        bool getMultios() const { return multios_; }
+
+        /**
+         * @brief 是否打开 iouring
+         *
+         * @return bool iouring 选项；内核不支持时调用者自动退回 read/write
+         */
+        bool getIoUring() const { return io_uring_; }
+
+        /**
+         * @brief 是否打开 noexec
+         *
+         * @return bool noexec 选项；交互 shell 忽略它
+         */
+        bool getNoExec() const { return no_exec_; }
+
+        /**
+         * @brief 获取管道缓冲区大小
+         *
+         * @return size_t 大小（KB），0 表示系统默认，SIZE_AUTO 表示长时间运行的管道自动扩大
+         */
+        size_t getPipeSize() const { return pipe_size_kb_; }
+
+        /**
+         * @brief 获取外部命令的进程创建后端
+         *
+         * @return SpawnBackendType 后端类型，AUTO 表示自动选择
+         */
+        SpawnBackendType getSpawnBackend() const { return static_cast<SpawnBackendType>(spawn_backend_); }
+
+        /**
+         * @brief 获取词法分析器批量扫描字符的实现
+         *
+         * @return ScanMethod 实现，AUTO 表示 CPU 支持的最快实现
+         */
+        ScanMethod getScanMethod() const { return static_cast<ScanMethod>(scan_method_); }
+
+        /**
+         * @brief 设置外部命令的进程创建后端
+         *
+         * @param type 后端类型
+         */
+        void setSpawnBackend(SpawnBackendType type) { spawn_backend_ = static_cast<int>(type); }
+    };
+
+} // namespace dash
+
+#endif // DASH_OPTIONS_H
@@ -0,0 +1,115 @@
+/**
+ * @file parallel_lexer.h
+ * @brief 大脚本的并行词法分析
+ */
+
+#ifndef DASH_PARALLEL_LEXER_H
+#define DASH_PARALLEL_LEXER_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "core/lexer.h"
+
+namespace dash
+{
+
+    /**
+     * @brief 大脚本的并行词法分析
+     *
+     * 脚本逐行读取执行，跨行的只有 Here 文档的正文和没有结束的引号、命令替换。第一遍用
+     * memchr 找出含有 << 的行，只对这些行做词法分析得到定界符并跳过正文，把不在正文中的
+     * 行首作为分块的边界；第二遍由多个线程各自逐行分析一块，结果按顺序交给解析器。
+     *
+     * 第一遍只是估计：一块的最后一行命令跨过了边界时（跨行的引号，或者第一遍没有看出
+     * 的正文），这一块继续读到命令结束为止，同一组后面的块从错误的位置开始，作废后从
+     * 命令结束处重新分块。某一行分析出错时，从这一行起的输入交给调用者逐行处理，错误
+     * 信息和出错前执行到的位置都与逐行读取时相同。出现 alias 的块及之后的输入也逐行
+     * 处理：别名会改变后面各行的分析结果，不能提前分析。
+     */
+    class ParallelLexer
+    {
+    public:
+        static constexpr size_t CHUNK_SIZE = 1 << 20;      // 每个任务至少分析的字节数，到下一个边界为止
+        static constexpr size_t MIN_SIZE = 2 * CHUNK_SIZE; // 小于这个大小的脚本不值得并行分析
+
+    private:
+        /**
+         * @brief 一个任务分析的一块输入
+         */
+        struct Chunk
+        {
+            size_t begin;       // 在输入中的起始位置
+            size_t end;         // 结束位置
+            size_t stop;        // 分析到的位置，最后一行命令跨过边界时大于 end
+            bool failed;        // stop 处的一行分析出错，需要从这里起逐行处理
+            TokenStream result; // 分析结果，命令的下标从 0 开始
+        };
+
+        std::string_view text_;
+        size_t threads_;
+        size_t position_;           // 下一组块的起始位置
+        size_t scan_pos_;           // 第一遍扫描到的行首，不在 Here 文档的正文中
+        size_t alias_pos_;          // 第一次出现 alias 的位置
+        bool sequential_;           // 从 position_ 起的输入全部逐行处理
+        std::vector<Chunk> chunks_; // 正在交给调用者的一组块，结果的缓冲区重复使用
+        size_t chunk_count_;        // 这一组中块的数量
+        size_t next_chunk_;         // 下一个交给调用者的块
+
+        /**
+         * @brief 第一遍扫描：找到不早于 target、不在 Here 文档正文中的第一个行首
+         *
+         * @param target 最早的位置
+         * @return size_t 行首的位置，没有时为输入的长度
+         */
+        size_t findSplit(size_t target);
+
+        /**
+         * @brief 跳过 Here 文档的正文，与 Lexer 读取正文的方式相同
+         *
+         * @param pos 正文开始的位置
+         * @param line 含有 << 的一行
+         * @return size_t 正文之后的位置，一块之内找不到定界符时为 pos
+         */
+        size_t skipHereDocs(size_t pos, std::string_view line) const;
+
+        /**
+         * @brief 第二遍：逐行分析一块输入，在工作线程中执行
+         *
+         * @param chunk 要分析的块
+         */
+        void tokenizeChunk(Chunk &chunk) const;
+
+        /**
+         * @brief 划分下一组块并行分析
+         *
+         * @return bool 是否得到了至少一块
+         */
+        bool tokenizeNext();
+
+    public:
+        /**
+         * @brief 构造函数
+         *
+         * @param text 整个脚本，在分析结果使用期间有效
+         * @param threads 同时分析的块数
+         */
+        ParallelLexer(std::string_view text, size_t threads);
+
+        /**
+         * @brief 取得下一段输入
+         *
+         * 每次并行分析 threads 块，之后逐块把结果交换到 stream 中，stream 原有的缓冲区
+         * 留给下一组重复使用；不能并行分析的输入放入 rest。
+         *
+         * @param stream 输出参数，分析好的词法单元，值指向脚本原文
+         * @param rest 输出参数，需要逐行处理的输入，为空表示没有
+         * @return bool 是否还有输入
+         */
+        bool next(TokenStream &stream, std::string_view &rest);
+    };
+
+} // namespace dash
+
+#endif // DASH_PARALLEL_LEXER_H
@@ -110,9 +110,9 @@ namespace dash
          *
          * @param type 期望的词法单元类型
          * @param error_message 错误消息
-         * @return std::unique_ptr<Token> 词法单元
+         * @return Token 词法单元
          */
-        std::unique_ptr<Token> expectToken(TokenType type, const std::string &error_message);
+        Token expectToken(TokenType type, const std::string &error_message);
 
         /**
          * @brief 跳过换行符
@@ -127,6 +127,15 @@ namespace dash
          */
         bool isReservedWord(const std::string &word) const;
 
+        /**
+         * @brief 检查下一个词法单元是否结束命令列表
+         *
+         * 输入结束、除 ( 以外的操作符和 then/do/done/fi 等保留字结束命令列表。
+         *
+         * @return bool 是否结束
+         */
+        bool atListEnd();
+
         /**
          * @brief 检查是否是重定向操作符
          *
@@ -160,8 +169,18 @@ namespace dash
          * @brief 设置输入
          *
          * @param input 输入字符串
+         * @param line_reader 输入不够时（例如 Here 文档的正文）读取下一行，为空表示输入只有 input
+         */
+        void setInput(const std::string &input, std::function<bool(std::string &)> line_reader = nullptr);
+
+        /**
+         * @brief 改为解析已经分析好的词法单元
+         *
+         * @param stream 词法单元序列
+         * @param begin 第一个词法单元的下标
+         * @param end 最后一个词法单元之后的下标
          */
-        void setInput(const std::string &input);
+        void setTokens(TokenStream *stream, size_t begin, size_t end);
 
         /**
          * @brief 获取词法分析器
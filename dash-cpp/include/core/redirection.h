@@ -0,0 +1,370 @@
+/**
+ * @file redirection.h
+ * @brief 重定向及编译后的重定向计划定义
+ */
+
+#ifndef DASH_REDIRECTION_H
+#define DASH_REDIRECTION_H
+
+#include <array>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/types.h>
+#include "core/spawn.h"
+
+namespace dash
+{
+
+    // 前向声明
+    class VariableManager;
+
+    /**
+     * @brief 重定向类型
+     */
+    enum class RedirType
+    {
+        REDIR_INPUT,      // <
+        REDIR_OUTPUT,     // >
+        REDIR_APPEND,     // >>
+        REDIR_INPUT_DUP,  // <&
+        REDIR_OUTPUT_DUP, // >&
+        REDIR_HEREDOC     // <<
+    };
+
+    /**
+     * @brief Here 文档
+     *
+     * 解析器遇到 << 时创建，词法分析器读到下一个换行符后填入正文。
+     */
+    struct HereDoc
+    {
+        std::string delimiter; // 去掉引号后的定界符
+        std::string body;      // 正文，每行以换行符结尾
+        bool expand;           // 定界符没有引号时展开正文中的 $ 和 `
+        bool strip_tabs;       // <<- 去掉每行开头的制表符
+
+        HereDoc(const std::string &d, bool e, bool s)
+            : delimiter(d), expand(e), strip_tabs(s) {}
+
+        /**
+         * @brief 由 << 之后的单词得到定界符
+         *
+         * @param word 词法分析器给出的单词，引号已经去掉
+         * @return std::string 去掉反斜杠后的定界符
+         */
+        static std::string delimiterOf(std::string_view word);
+    };
+
+    /**
+     * @brief 重定向结构体
+     */
+    struct Redirection
+    {
+        RedirType type;       // 重定向类型
+        int fd;               // 文件描述符
+        std::string filename; // 文件名或目标文件描述符
+        std::shared_ptr<HereDoc> heredoc; // REDIR_HEREDOC 的正文
+
+        Redirection(RedirType t, int f, const std::string &fn)
+            : type(t), fd(f), filename(fn) {}
+    };
+
+    /**
+     * @brief 重复重定向的描述符缓存
+     *
+     * 循环中每次迭代都执行的 >>file 复用同一个描述符，省去每次的 open/close。
+     * >file 不缓存：POSIX 要求每次都是新的打开，有自己的偏移量，共享描述符时截断
+     * 会影响仍在后台写入的上一次命令；追加写总是写到文件末尾，共享偏移量没有区别。
+     * 以展开后的路径和打开标志为键；每次使用前 stat 路径并与缓存的设备号和 inode
+     * 比较，文件被删除、改名替换（例如日志轮转）或 cd 后相对路径指向别的文件时重新打开。
+     * 只缓存普通文件，描述符放在 RedirectionPlan::MAX_FD 以上并带 O_CLOEXEC。
+     */
+    class RedirectionCache
+    {
+    public:
+        static constexpr size_t MAX_ENTRIES = 16; // 最多缓存的描述符数量
+
+    private:
+        /**
+         * @brief 缓存项
+         */
+        struct Entry
+        {
+            std::string path; // 展开后的路径
+            int flags;        // 打开标志
+            int fd;           // 缓存的描述符
+            dev_t dev;        // 打开时文件所在的设备
+            ino_t ino;        // 打开时文件的 inode
+        };
+
+        std::vector<Entry> entries_;
+
+    public:
+        RedirectionCache() = default;
+        RedirectionCache(const RedirectionCache &) = delete;
+        RedirectionCache &operator=(const RedirectionCache &) = delete;
+
+        /**
+         * @brief 析构函数，关闭所有缓存的描述符
+         */
+        ~RedirectionCache() { clear(); }
+
+        /**
+         * @brief 打开文件，能复用时返回缓存的描述符
+         *
+         * 只复用带 O_APPEND 的描述符，其余标志直接打开。
+         *
+         * @param path 展开后的路径
+         * @param flags 打开标志
+         * @param cached 输出参数，描述符属于缓存时为 true，否则调用者负责关闭
+         * @return int 描述符，失败时为 -1（errno 保留）
+         */
+        int open(const std::string &path, int flags, bool &cached);
+
+        /**
+         * @brief 关闭所有缓存的描述符
+         */
+        void clear();
+    };
+
+    /**
+     * @brief 缓存的作用域
+     *
+     * 循环和顶层命令列表开始时创建；没有外层作用域时启用自己的缓存，
+     * 结束时关闭缓存的描述符。嵌套的作用域沿用外层的缓存。
+     */
+    class RedirectionCacheScope
+    {
+    private:
+        RedirectionCache *&active_; // 执行器当前使用的缓存
+        bool owner_;                // 是否由本作用域启用
+        RedirectionCache cache_;
+
+    public:
+        /**
+         * @brief 构造函数
+         *
+         * @param active 执行器当前使用的缓存，为 nullptr 时改为指向本作用域的缓存
+         */
+        explicit RedirectionCacheScope(RedirectionCache *&active)
+            : active_(active), owner_(active == nullptr)
+        {
+            if (owner_)
+            {
+                active_ = &cache_;
+            }
+        }
+
+        /**
+         * @brief 析构函数，结束本作用域启用的缓存
+         */
+        ~RedirectionCacheScope()
+        {
+            if (owner_)
+            {
+                active_ = nullptr;
+            }
+        }
+
+        RedirectionCacheScope(const RedirectionCacheScope &) = delete;
+        RedirectionCacheScope &operator=(const RedirectionCacheScope &) = delete;
+    };
+
+    /**
+     * @brief 执行重定向时由执行器提供的环境
+     */
+    struct RedirectionContext
+    {
+        const VariableManager *vars; // 用于展开文件名和 Here 文档
+        int dev_null_fd;             // 缓存的 /dev/null 描述符，-1 表示不使用
+        RedirectionCache *cache;     // 重复重定向的描述符缓存，为 nullptr 表示不缓存
+        std::vector<pid_t> *relays;  // 多目标输出的中继进程，调用者在命令结束后等待；
+                                     // 为 nullptr 表示不启用 multios，同一描述符只保留最后一个重定向
+        bool io_uring;               // 用 io_uring 写 Here 文档正文
+    };
+
+    /**
+     * @brief 编译后的重定向计划
+     *
+     * 在解析时把重定向列表编译成固定的步骤：打开标志、目标描述符和不含 $ 或 `
+     * 的文件名都提前算好，执行时只剩系统调用。被重定向的描述符只能是 0-9，
+     * 保存原描述符用的是固定大小的表。
+     *
+     * 同一描述符连续的多个输出重定向（cmd >a >b）编译成一组。启用 multios 时
+     * 描述符接到一个管道，由中继进程用 tee(2) 和 splice(2) 在内核中把数据复制到
+     * 组内的每个文件，不经过用户空间。
+     */
+    class RedirectionPlan
+    {
+    public:
+        static constexpr int MAX_FD = 10; // 可重定向的描述符上限，保存的副本都放在此值以上
+
+        /**
+         * @brief 重定向执行完后需要恢复的描述符
+         */
+        class SavedFds
+        {
+        private:
+            static constexpr int UNSAVED = -1; // 没有被重定向
+            static constexpr int CLOSED = -2;  // 重定向前是关闭的，恢复时关闭
+
+            std::array<int, MAX_FD> saved_; // 每个描述符的副本
+
+        public:
+            /**
+             * @brief 构造函数
+             */
+            SavedFds() { saved_.fill(UNSAVED); }
+
+            /**
+             * @brief 保存描述符（已保存过的不再保存）
+             *
+             * @param fd 描述符，必须小于 MAX_FD
+             * @return bool 是否成功
+             */
+            bool save(int fd);
+
+            /**
+             * @brief 恢复所有保存的描述符
+             */
+            void restore();
+        };
+
+        /**
+         * @brief 执行方式
+         */
+        enum class Mode
+        {
+            RESTORE, // 保存原描述符，之后可以恢复（内置命令）
+            CHILD,   // 子进程中执行，之后会 exec 或退出，不保存
+            PERSIST  // exec 不带命令时的重定向，保留到 shell 退出，不保存
+        };
+
+    private:
+        /**
+         * @brief 编译后的一个重定向
+         */
+        struct Step
+        {
+            RedirType type;
+            int fd;           // 被重定向的描述符
+            std::string word; // 文件名或目标描述符的原文
+            bool literal;     // word 不需要展开
+            int flags;        // 打开文件的标志
+            int target_fd;    // 复制重定向的目标，-1 表示关闭（>&-）；word 需要展开时在执行时计算
+            std::shared_ptr<const HereDoc> heredoc; // Here 文档
+            std::vector<size_t> outputs; // 多目标输出组中后续步骤的下标，只在组的第一个步骤中
+            size_t head;                 // 所在多目标输出组第一个步骤的下标，不在组中时是自己的下标
+        };
+
+        std::vector<Step> steps_;
+
+        /**
+         * @brief 取得步骤的文件名或目标
+         *
+         * @param step 步骤
+         * @param vars 变量管理器
+         * @return std::string 展开后的文本
+         */
+        static std::string resolveWord(const Step &step, const VariableManager &vars);
+
+        /**
+         * @brief 取得复制重定向的目标描述符
+         *
+         * @param step 步骤
+         * @param vars 变量管理器
+         * @param target 输出参数，目标描述符，-1 表示关闭
+         * @return bool 目标是否有效
+         */
+        static bool resolveTarget(const Step &step, const VariableManager &vars, int &target);
+
+        /**
+         * @brief 创建读取 Here 文档正文的描述符
+         *
+         * 正文放得进管道缓冲区时直接写入管道；否则写入 memfd，读者得到可以 seek 的描述符。
+         * 两种方式都不创建临时文件。返回的描述符带 O_CLOEXEC。
+         *
+         * @param step Here 文档步骤
+         * @param context 执行环境，用于展开正文和选择写入方式
+         * @return int 描述符，失败时为 -1（errno 保留）
+         */
+        static int openHereDoc(const Step &step, const RedirectionContext &context);
+
+        /**
+         * @brief 在当前进程中打开输入输出重定向的文件
+         *
+         * @param step 步骤
+         * @param context 执行环境
+         * @param filename 输出参数，展开后的文件名，用于错误信息
+         * @param owned 输出参数，描述符是否需要调用者关闭（缓存的和 /dev/null 不需要）
+         * @return int 描述符，失败时为 -1（errno 保留）
+         */
+        static int openFile(const Step &step, const RedirectionContext &context, std::string &filename,
+                            bool &owned);
+
+        /**
+         * @brief 打开多目标输出组的所有文件并启动中继进程
+         *
+         * @param step 组的第一个步骤
+         * @param context 执行环境，中继进程的 PID 追加到 context.relays
+         * @return int 管道写端（带 O_CLOEXEC），复制到 step.fd；失败时为 -1，已输出错误信息
+         */
+        int startRelay(const Step &step, const RedirectionContext &context) const;
+
+    public:
+        /**
+         * @brief 编译并追加一个重定向
+         *
+         * @param redir 重定向
+         * @throw ShellException 描述符超出 0-9 时抛出语法错误
+         */
+        void add(const Redirection &redir);
+
+        /**
+         * @brief 是否没有重定向
+         *
+         * @return bool 是否为空
+         */
+        bool empty() const { return steps_.empty(); }
+
+        /**
+         * @brief 在当前进程中执行重定向
+         *
+         * 失败时输出错误信息，RESTORE 模式下已经做的重定向会被恢复。
+         *
+         * @param context 执行环境
+         * @param mode 执行方式
+         * @param saved RESTORE 模式下保存原描述符的表，CHILD 模式下忽略
+         * @return bool 是否成功
+         */
+        bool apply(const RedirectionContext &context, Mode mode, SavedFds *saved) const;
+
+        /**
+         * @brief 转换为进程创建后端使用的文件描述符操作
+         *
+         * 文件名在调用进程中展开，Here 文档和缓存的文件在调用进程中准备好描述符，
+         * 子进程只需复制。创建子进程后调用者负责关闭 opened_fds。
+         *
+         * @param context 执行环境
+         * @param actions 输出参数，追加的文件描述符操作
+         * @param opened_fds 输出参数，在调用进程中打开、不属于缓存的描述符
+         * @return bool 是否成功，失败时已输出错误信息并关闭 opened_fds
+         */
+        bool buildFileActions(const RedirectionContext &context, std::vector<FileAction> &actions,
+                              std::vector<int> &opened_fds) const;
+
+        /**
+         * @brief 等待多目标输出的中继进程把数据写完
+         *
+         * 调用前必须关闭所有中继管道的写端。
+         *
+         * @param relays 中继进程，等待后清空
+         */
+        static void waitRelays(std::vector<pid_t> &relays);
+    };
+
+} // namespace dash
+
+#endif // DASH_REDIRECTION_H
@@ -0,0 +1,154 @@
+/**
+ * @file server.h
+ * @brief Shell 服务模式定义
+ */
+
+#ifndef DASH_SERVER_H
+#define DASH_SERVER_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <sys/types.h>
+#include "utils/fd_channel.h"
+
+namespace dash
+{
+
+    // 前向声明
+    class Shell;
+    class Node;
+
+    /**
+     * @brief Shell 服务
+     *
+     * dash --serve <socket> 启动一个常驻的、已经初始化好的 shell 进程，在 UNIX 套接字上
+     * 接收命令字符串、环境、当前目录和标准输入输出描述符。每个请求由服务进程 fork 出的
+     * 子进程执行（不再需要进程启动、导入环境和注册内置命令），结束后把退出状态返回给客户端。
+     * 只调用无状态内置命令的请求直接在服务进程中执行。
+     */
+    class ShellServer
+    {
+    private:
+        Shell *shell_;
+        std::string socket_path_;
+        int listen_fd_;
+        std::unordered_map<pid_t, int> running_; // 正在执行的请求：子进程 PID -> 客户端连接
+        std::unordered_map<int, MessageReceiver> pending_; // 请求还没有收完的连接 -> 接收状态
+
+        /**
+         * @brief 接受一个连接，请求收完之前不阻塞服务
+         */
+        void acceptClient();
+
+        /**
+         * @brief 读取连接上已经到达的请求数据，收完后处理请求
+         *
+         * @param conn 客户端连接
+         */
+        void receiveRequest(int conn);
+
+        /**
+         * @brief 处理收完的请求
+         *
+         * @param conn 客户端连接
+         * @param body 消息体
+         * @param fds 客户端传来的描述符
+         */
+        void handleRequest(int conn, const std::string &body, const std::vector<int> &fds);
+
+        /**
+         * @brief 检查请求能否在服务进程中直接执行
+         *
+         * @param node 解析后的命令
+         * @param fds 客户端传来的描述符
+         * @param targets 描述符对应的位置
+         * @return true 可以直接执行
+         * @return false 需要 fork 子进程
+         */
+        bool canRunInProcess(const Node *node, const std::vector<int> &fds, const std::vector<int> &targets) const;
+
+        /**
+         * @brief 在服务进程中执行请求
+         *
+         * @param node 解析后的命令
+         * @param fds 客户端传来的描述符
+         * @param targets 描述符对应的位置
+         * @return int 执行结果状态码
+         */
+        int runInProcess(const Node *node, const std::vector<int> &fds, const std::vector<int> &targets);
+
+        /**
+         * @brief 在子进程中执行请求，不返回
+         */
+        [[noreturn]] void runChild(const std::string &command, const std::vector<std::string> &env,
+                                   const std::vector<int> &fds, const std::vector<int> &targets);
+
+        /**
+         * @brief 处理客户端连接上的数据（转发信号或客户端断开）
+         *
+         * @param pid 请求对应的子进程 PID
+         */
+        void handleClientInput(pid_t pid);
+
+        /**
+         * @brief 回收结束的请求子进程并把状态返回给客户端
+         *
+         * 只等待 running_ 中的进程，不回收服务的其他子进程（如 --zygote 的辅助进程）。
+         */
+        void reapChildren();
+
+    public:
+        /**
+         * @brief 构造函数
+         *
+         * @param shell Shell 对象指针
+         * @param socket_path 套接字路径
+         */
+        ShellServer(Shell *shell, const std::string &socket_path);
+
+        /**
+         * @brief 析构函数
+         */
+        ~ShellServer();
+
+        ShellServer(const ShellServer &) = delete;
+        ShellServer &operator=(const ShellServer &) = delete;
+
+        /**
+         * @brief 运行服务，直到收到 SIGINT 或 SIGTERM
+         *
+         * @return int 退出状态码
+         */
+        int run();
+    };
+
+    /**
+     * @brief 检查命令行是否是客户端调用
+     *
+     * 支持 dash --client <socket> -c <command>，以及设置了 DASH_SERVER 环境变量时的
+     * dash -c <command>，这样可以直接替换 sh -c。
+     *
+     * @param argc 参数数量
+     * @param argv 参数数组
+     * @param socket_path 输出参数，套接字路径
+     * @param command 输出参数，命令字符串
+     * @return true 是客户端调用
+     * @return false 不是
+     */
+    bool getClientRequest(int argc, char *argv[], std::string &socket_path, std::string &command);
+
+    /**
+     * @brief 把命令交给服务执行并等待结果
+     *
+     * 等待期间收到的 SIGINT、SIGQUIT、SIGTERM、SIGHUP 会转发给执行请求的进程。
+     *
+     * @param socket_path 套接字路径
+     * @param command 命令字符串
+     * @return int 命令的退出状态码；无法连接服务时返回 -1（调用者应自行执行命令）
+     */
+    int runClient(const std::string &socket_path, const std::string &command);
+
+} // namespace dash
+
+#endif // DASH_SERVER_H
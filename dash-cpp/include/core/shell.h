@@ -20,8 +20,9 @@ namespace dash
     class Executor;
     class VariableManager;
     class JobControl;
-    class PipeNode;
     class BGJobAdapter; // 添加适配器的前向声明
+    class ShellOptions;
+    class Node;
 
     /**
      * @brief Shell 类
@@ -31,6 +32,7 @@ namespace dash
     class Shell
     {
     private:
+        std::unique_ptr<ShellOptions> options_; // set -o 选项，其他组件构造时可能读取
         std::unique_ptr<InputHandler> input_;
         std::unique_ptr<VariableManager> variable_manager_;
         std::unique_ptr<Parser> parser_;
@@ -41,10 +43,13 @@ namespace dash
         bool interactive_;
         bool exit_requested_;
         int exit_status_;
+        bool use_zygote_; // 是否启动 zygote 辅助进程创建外部命令
+        size_t lex_threads_; // --lex-threads 指定的脚本词法分析线程数，0 表示按 CPU 数量
 
         std::string script_file_;
         std::vector<std::string> script_args_;
         std::string command_string_;
+        std::string serve_socket_; // --serve 指定的套接字路径，非空时以服务模式运行
         
         /**
          * @brief 设置信号处理函数
@@ -80,17 +85,32 @@ namespace dash
         int runScript();
 
         /**
-         * @brief 显示提示符
+         * @brief 逐行读取并执行输入处理器中的命令，直到输入结束或 shell 退出
          */
-        void displayPrompt();
+        void runLines();
 
         /**
-         * @brief 执行管道
+         * @brief 并行分析整个脚本文件后逐行执行
+         *
+         * 只用于足够大的普通文件且有多个分析线程时；每一行命令的解析和执行与逐行读取相同。
          *
-         * @param node 管道节点
+         * @return bool 是否已经执行了脚本，为 false 时由调用者逐行读取
+         */
+        bool runTokenizedScript();
+
+        /**
+         * @brief 执行解析好的命令，noexec 时只检查语法
+         *
+         * @param command 命令树，可以为空
+         * @param flags 执行标志（Executor::ExecFlags）
          * @return int 执行结果状态码
          */
-        int execute_pipeline(const PipeNode *node);
+        int executeParsed(const Node *command, int flags);
+
+        /**
+         * @brief 显示提示符
+         */
+        void displayPrompt();
 
     public:
         // 信号处理相关
@@ -158,6 +178,13 @@ namespace dash
          */
         JobControl *getJobControl() const;
 
+        /**
+         * @brief 获取 shell 选项
+         *
+         * @return ShellOptions* 选项指针
+         */
+        ShellOptions *getOptions() const;
+
         /**
          * @brief 获取后台任务控制适配器
          *
@@ -181,13 +208,28 @@ namespace dash
         int getExitStatus() const;
         
         /**
-         * @brief 执行后台命令
+         * @brief 在当前进程中解释一个脚本文件，不返回
+         *
+         * 外部命令 exec 失败且 errno 为 ENOEXEC（没有 #! 的脚本）时，在已经 fork 出的
+         * 子进程中调用：重置变量、作业表和输入栈后直接用本进程的解析器执行文件，
+         * 省去再 exec 一个解释器。
+         *
+         * @param path 脚本路径
+         * @param args 参数列表（args[0] 为命令名）
+         */
+        [[noreturn]] void runScriptInChild(const std::string &path, const std::vector<std::string> &args);
+
+        /**
+         * @brief 解析并执行命令字符串
+         *
+         * 用于 -c 选项、服务模式和逐行执行脚本文件。
          *
-         * @param command 命令字符串
-         * @param args 参数数组
+         * @param command_string 命令字符串
+         * @param flags 执行标志（Executor::ExecFlags）
+         * @param more_input 命令没有写完时（例如 Here 文档的正文）继续从输入处理器读取
          * @return int 执行结果状态码
          */
-        int executeBackground(const std::string &command, std::vector<std::string> &args);
+        int executeString(const std::string &command_string, int flags, bool more_input = false);
     };
 
 } // namespace dash
@@ -0,0 +1,174 @@
+/**
+ * @file spawn.h
+ * @brief 外部命令创建后端定义
+ */
+
+#ifndef DASH_SPAWN_H
+#define DASH_SPAWN_H
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <sys/types.h>
+
+namespace dash
+{
+
+    /**
+     * @brief 进程创建后端类型
+     */
+    enum class SpawnBackendType
+    {
+        AUTO,        // 自动选择
+        FORK,        // 完整 fork + exec
+        VFORK,       // clone(CLONE_VM | CLONE_VFORK) + exec
+        POSIX_SPAWN, // posix_spawn
+        ZYGOTE       // 由启动时创建的辅助进程 fork + exec
+    };
+
+    /**
+     * @brief 子进程中执行的文件描述符操作
+     */
+    struct FileAction
+    {
+        enum Kind
+        {
+            OPEN,  // 打开 path 到 fd
+            DUP2,  // 复制 source_fd 到 fd
+            CLOSE  // 关闭 fd
+        };
+
+        Kind kind;
+        int fd;
+        int source_fd;
+        std::string path;
+        int flags;
+        mode_t mode;
+
+        FileAction(Kind k, int f, int src = -1, const std::string &p = "", int fl = 0, mode_t m = 0)
+            : kind(k), fd(f), source_fd(src), path(p), flags(fl), mode(m) {}
+    };
+
+    /**
+     * @brief 一次进程创建所需的全部信息
+     *
+     * 所有字符串都在父进程中准备好，子进程只执行系统调用。
+     */
+    struct SpawnPlan
+    {
+        std::string command;             // 命令名或路径
+        std::vector<std::string> args;   // argv，args[0] 为命令名
+        std::vector<FileAction> actions; // 按顺序执行的文件描述符操作
+        pid_t pgid = -1;                 // -1 不修改进程组，0 为新建进程组
+        bool needs_shell = false;        // 子进程需要运行 shell 代码
+
+        // exec 因 ENOEXEC 失败（没有 #! 的脚本）时在子进程中调用，不返回。
+        // 只有子进程能运行 shell 代码的 fork 后端和 execInPlace 使用，其他后端照常报告 ENOEXEC
+        std::function<void(const SpawnPlan &)> script_handler;
+    };
+
+    /**
+     * @brief 进程创建结果
+     */
+    struct SpawnResult
+    {
+        pid_t pid = -1;         // 子进程 PID，失败时为 -1
+        int error = 0;          // 失败时的 errno
+        int failed_action = -1; // 失败的文件操作下标，-1 表示 exec 失败
+    };
+
+    /**
+     * @brief 在当前进程中执行文件描述符操作
+     *
+     * 只调用异步信号安全的函数，可在 vfork 子进程中使用。
+     *
+     * @param actions 文件描述符操作列表
+     * @return int 成功返回 -1，失败返回失败操作的下标（errno 保留）
+     */
+    int runFileActions(const std::vector<FileAction> &actions);
+
+    /**
+     * @brief 在当前进程中执行文件描述符操作并 exec
+     *
+     * 用于不再需要 shell 的场合（如 sh -c 的最后一条命令），省去一次 fork 和 wait。
+     * 成功时不返回；ENOEXEC 时交给 plan.script_handler（如果有）。
+     *
+     * @param plan 进程创建信息
+     * @return SpawnResult 失败时的结果
+     */
+    SpawnResult execInPlace(const SpawnPlan &plan);
+
+    /**
+     * @brief 获取进程创建后端名称
+     *
+     * @param type 后端类型
+     * @return const char* 名称
+     */
+    const char *spawnBackendName(SpawnBackendType type);
+
+    /**
+     * @brief 进程创建后端基类
+     */
+    class SpawnBackend
+    {
+    public:
+        /**
+         * @brief 虚析构函数
+         */
+        virtual ~SpawnBackend() = default;
+
+        /**
+         * @brief 获取后端类型
+         *
+         * @return SpawnBackendType 后端类型
+         */
+        virtual SpawnBackendType getType() const = 0;
+
+        /**
+         * @brief 创建子进程并执行命令
+         *
+         * 失败时子进程已被回收，返回结果中 pid 为 -1。
+         *
+         * @param plan 进程创建信息
+         * @return SpawnResult 创建结果
+         */
+        virtual SpawnResult spawn(const SpawnPlan &plan) = 0;
+    };
+
+    /**
+     * @brief fork 后端
+     *
+     * 复制整个地址空间，适用于任何情况。
+     */
+    class ForkSpawnBackend : public SpawnBackend
+    {
+    public:
+        SpawnBackendType getType() const override { return SpawnBackendType::FORK; }
+        SpawnResult spawn(const SpawnPlan &plan) override;
+    };
+
+    /**
+     * @brief vfork 后端
+     *
+     * 使用 clone(CLONE_VM | CLONE_VFORK) 共享地址空间，不复制页表。
+     */
+    class VforkSpawnBackend : public SpawnBackend
+    {
+    public:
+        SpawnBackendType getType() const override { return SpawnBackendType::VFORK; }
+        SpawnResult spawn(const SpawnPlan &plan) override;
+    };
+
+    /**
+     * @brief posix_spawn 后端
+     */
+    class PosixSpawnBackend : public SpawnBackend
+    {
+    public:
+        SpawnBackendType getType() const override { return SpawnBackendType::POSIX_SPAWN; }
+        SpawnResult spawn(const SpawnPlan &plan) override;
+    };
+
+} // namespace dash
+
+#endif // DASH_SPAWN_H
@@ -0,0 +1,90 @@
+/**
+ * @file zygote.h
+ * @brief Zygote 进程创建后端定义
+ */
+
+#ifndef DASH_ZYGOTE_H
+#define DASH_ZYGOTE_H
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "core/spawn.h"
+
+namespace dash
+{
+
+    /**
+     * @brief Zygote 进程创建后端
+     *
+     * 在 shell 启动时（堆还很小的时候）fork 出一个辅助进程。之后每个外部命令都通过
+     * socketpair 把 argv、envp、当前目录描述符和需要继承的描述符（SCM_RIGHTS）发给它，
+     * 由它从自己很小的地址空间 fork 并 exec，fork 的代价不再随 shell 的堆增长。
+     *
+     * 辅助进程使用 CLONE_PARENT 创建子进程，新进程的父进程仍然是 shell，
+     * 因此 waitpid 和作业控制不需要任何改变。
+     */
+    class ZygoteSpawnBackend : public SpawnBackend
+    {
+    private:
+        int socket_fd_;          // 与辅助进程通信的套接字
+        pid_t zygote_pid_;       // 辅助进程 PID
+        pid_t owner_pid_;        // 启动辅助进程的 shell 进程 PID
+        SpawnBackend *fallback_; // 辅助进程不可用时使用的后端
+
+    public:
+        /**
+         * @brief 构造函数
+         *
+         * @param fallback 辅助进程不可用时使用的后端
+         */
+        explicit ZygoteSpawnBackend(SpawnBackend *fallback);
+
+        /**
+         * @brief 析构函数，关闭套接字并回收辅助进程
+         */
+        ~ZygoteSpawnBackend() override;
+
+        ZygoteSpawnBackend(const ZygoteSpawnBackend &) = delete;
+        ZygoteSpawnBackend &operator=(const ZygoteSpawnBackend &) = delete;
+
+        /**
+         * @brief 启动辅助进程
+         *
+         * @return true 启动成功
+         * @return false 启动失败
+         */
+        bool start();
+
+        /**
+         * @brief 停止辅助进程
+         *
+         * 关闭套接字，由创建它的 shell 调用时同时回收辅助进程。
+         */
+        void stop();
+
+        /**
+         * @brief 当前进程能否使用辅助进程
+         *
+         * 只有启动辅助进程的 shell 自己能使用它（子 shell 中的请求会交错，
+         * 而且新进程的父进程不是子 shell）。
+         *
+         * @return true 可以使用
+         * @return false 不能使用
+         */
+        bool isUsable() const;
+
+        /**
+         * @brief 获取辅助进程 PID
+         *
+         * @return pid_t 辅助进程 PID，未启动时为 -1
+         */
+        pid_t getZygotePid() const { return zygote_pid_; }
+
+        SpawnBackendType getType() const override { return SpawnBackendType::ZYGOTE; }
+        SpawnResult spawn(const SpawnPlan &plan) override;
+    };
+
+} // namespace dash
+
+#endif // DASH_ZYGOTE_H
@@ -256,6 +256,7 @@ namespace dash
         int terminal_fd_;
         pid_t shell_pgid_;
         int current_job_id_; // 当前作业ID
+        std::vector<pid_t> helper_pids_; // 进程替换、多目标输出中继等辅助子进程，不属于任何作业
 
         /**
          * @brief 初始化作业控制
@@ -378,6 +379,27 @@ namespace dash
          */
         void cleanupJobs();
 
+        /**
+         * @brief 清空作业表并关闭作业控制
+         *
+         * 用于子进程改为解释另一个脚本时：父 shell 的作业不属于新脚本。
+         */
+        void reset();
+
+        /**
+         * @brief 登记辅助子进程（进程替换 <(cmd)、>(cmd)，后台命令的多目标输出中继）
+         *
+         * 这些子进程不是作业，不出现在 jobs 中，由 reapHelperProcesses 回收。
+         *
+         * @param pid 子进程 PID
+         */
+        void addHelperProcess(pid_t pid);
+
+        /**
+         * @brief 回收已经结束的辅助子进程，不阻塞
+         */
+        void reapHelperProcesses();
+
         /**
          * @brief 获取所有作业
          * 
@@ -0,0 +1,169 @@
+/**
+ * @file fd_channel.h
+ * @brief UNIX 套接字消息与描述符传递工具
+ */
+
+#ifndef DASH_FD_CHANNEL_H
+#define DASH_FD_CHANNEL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dash
+{
+
+    /**
+     * @brief 一次消息最多传递的描述符数量
+     */
+    constexpr size_t FD_CHANNEL_MAX_FDS = 64;
+
+    /**
+     * @brief 一条消息体的最大长度
+     *
+     * 消息中最大的部分是参数和环境变量：按 Linux 默认的 ARG_MAX（2 MB）计算，
+     * 再给环境变量和其余字段留 1 MB。消息头声明的长度超过它时直接丢弃连接。
+     */
+    constexpr size_t FD_CHANNEL_MAX_MESSAGE = 3 * 1024 * 1024;
+
+    /**
+     * @brief 消息体序列化
+     *
+     * 整数固定为 64 位本机字节序，字符串为长度加内容。只用于同一主机上的进程之间。
+     */
+    class MessageWriter
+    {
+    private:
+        std::string buffer_;
+
+    public:
+        void putInt(int64_t value);
+        void putString(const std::string &value);
+        void putStrings(const std::vector<std::string> &values);
+
+        const std::string &data() const { return buffer_; }
+    };
+
+    /**
+     * @brief 消息体反序列化
+     *
+     * 数据不足时 ok() 返回 false，之后读取的值均为空。
+     */
+    class MessageReader
+    {
+    private:
+        const std::string &buffer_;
+        size_t pos_;
+        bool ok_;
+
+    public:
+        explicit MessageReader(const std::string &buffer) : buffer_(buffer), pos_(0), ok_(true) {}
+
+        int64_t getInt();
+        std::string getString();
+        std::vector<std::string> getStrings();
+
+        bool ok() const { return ok_; }
+    };
+
+    /**
+     * @brief 读取指定长度的数据
+     *
+     * @return bool 是否读满（EOF 或出错时为 false）
+     */
+    bool readFully(int fd, void *buf, size_t length);
+
+    /**
+     * @brief 向套接字发送指定长度的数据，对端关闭时不产生 SIGPIPE
+     *
+     * @return bool 是否全部发送
+     */
+    bool sendFully(int sock, const void *buf, size_t length);
+
+    /**
+     * @brief 发送一条消息，描述符随消息头通过 SCM_RIGHTS 传递
+     *
+     * @param sock 套接字
+     * @param body 消息体
+     * @param fds 要传递的描述符，不超过 FD_CHANNEL_MAX_FDS 个
+     * @return bool 是否成功（消息体超过 FD_CHANNEL_MAX_MESSAGE 时为 false，errno 为 E2BIG）
+     */
+    bool sendMessage(int sock, const std::string &body, const std::vector<int> &fds);
+
+    /**
+     * @brief 接收一条消息
+     *
+     * 收到的描述符带 close-on-exec。失败时已收到的描述符会被关闭。
+     * 消息体超过 FD_CHANNEL_MAX_MESSAGE 的消息视为无效。
+     *
+     * @param sock 套接字
+     * @param body 输出参数，消息体
+     * @param fds 输出参数，收到的描述符
+     * @return bool 是否成功（对端关闭时为 false）
+     */
+    bool recvMessage(int sock, std::string &body, std::vector<int> &fds);
+
+    /**
+     * @brief 分次接收一条消息
+     *
+     * 每次套接字可读时调用 receive()，只读取已经到达的数据，不会阻塞；消息不完整时
+     * 返回 PENDING，等下一次可读再继续。用于单线程的服务同时等待多个连接。
+     * 消息体随数据到达逐步增长，不按消息头声明的长度预先分配。
+     */
+    class MessageReceiver
+    {
+    public:
+        /**
+         * @brief 接收状态
+         */
+        enum class Status
+        {
+            PENDING,  // 消息还没有收完
+            COMPLETE, // 收到了完整的消息
+            FAILED    // 对端关闭或消息无效，已收到的描述符已关闭
+        };
+
+    private:
+        uint32_t header_[2]; // 消息头：消息体长度和描述符数量
+        size_t received_;    // 已收到的字节数，包括消息头
+        std::string body_;   // 已收到的消息体
+        std::vector<int> fds_;
+
+        /**
+         * @brief 关闭已收到的描述符并返回 FAILED
+         */
+        Status fail();
+
+    public:
+        MessageReceiver() : header_{0, 0}, received_(0) {}
+
+        /**
+         * @brief 析构函数，关闭没有取走的描述符
+         */
+        ~MessageReceiver();
+
+        MessageReceiver(const MessageReceiver &) = delete;
+        MessageReceiver &operator=(const MessageReceiver &) = delete;
+
+        /**
+         * @brief 读取套接字上已经到达的数据
+         *
+         * 收到的描述符带 close-on-exec。
+         *
+         * @param sock 套接字
+         * @return Status 接收状态
+         */
+        Status receive(int sock);
+
+        /**
+         * @brief 取走收到的消息，在 receive() 返回 COMPLETE 之后调用
+         *
+         * @param body 输出参数，消息体
+         * @param fds 输出参数，收到的描述符，由调用者关闭
+         */
+        void take(std::string &body, std::vector<int> &fds);
+    };
+
+} // namespace dash
+
+#endif // DASH_FD_CHANNEL_H
@@ -0,0 +1,146 @@
+/**
+ * @file io_ring.h
+ * @brief shell 内部 I/O 使用的 io_uring 封装
+ */
+
+#ifndef DASH_IO_RING_H
+#define DASH_IO_RING_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace dash
+{
+
+    /**
+     * @brief io_uring 封装
+     *
+     * 直接使用 io_uring_setup/io_uring_enter 系统调用，不依赖 liburing。读取时把
+     * 几个读请求用 IOSQE_IO_LINK 串成一条链、一次提交，数据读进注册过的固定缓冲区；
+     * 写入时把大块数据拆成串联的写请求一次提交。链中某个请求读写不满时后面的请求
+     * 被内核取消，从断开处重新提交，顺序不会乱。
+     *
+     * 每个进程一个环，fork 出的子进程第一次使用时重新创建。内核不支持或被 seccomp
+     * 禁止时 get() 返回 nullptr，调用者使用普通的 read/write。环不是线程安全的，
+     * 只在主线程中使用。
+     */
+    class IoRing
+    {
+    public:
+        static constexpr unsigned ENTRIES = 8;             // 提交队列深度，也是一条链最多的请求数
+        static constexpr unsigned BUFFERS = 4;             // 注册的固定缓冲区数量
+        static constexpr size_t BUFFER_SIZE = 64 * 1024;   // 每个固定缓冲区的大小
+        static constexpr size_t WRITE_CHUNK = 1024 * 1024; // 一个写请求最多写的字节数
+
+    private:
+        int ring_fd_;
+        void *sq_ring_;
+        void *cq_ring_;
+        size_t sq_ring_size_;
+        size_t cq_ring_size_;
+        io_uring_sqe *sqes_;
+        size_t sqes_size_;
+        unsigned *sq_tail_;
+        unsigned *sq_mask_;
+        unsigned *sq_array_;
+        unsigned *cq_head_;
+        unsigned *cq_tail_;
+        unsigned *cq_mask_;
+        io_uring_cqe *cqes_;
+        unsigned pending_;          // 已填好、还没有提交的请求数
+        std::vector<char> buffers_; // BUFFERS 个固定缓冲区，连续存放
+        bool registered_;           // 缓冲区是否注册成功；失败时（如 RLIMIT_MEMLOCK 太小）用普通读请求
+        pid_t owner_;               // 创建环的进程
+
+        /**
+         * @brief 构造函数，只初始化成员，由 setup() 创建环
+         */
+        IoRing();
+
+        /**
+         * @brief 创建环、映射队列并注册缓冲区
+         *
+         * @return bool 是否成功
+         */
+        bool setup();
+
+        /**
+         * @brief 取得下一个提交队列项，清零后返回
+         *
+         * @return io_uring_sqe* 提交队列项
+         */
+        io_uring_sqe *nextSqe();
+
+        /**
+         * @brief 提交已填好的请求并等待全部完成
+         *
+         * @param count 请求数量
+         * @param results 输出参数，按 user_data 存放每个请求的结果（负数为 -errno）
+         * @return int 0 表示成功，否则为 io_uring_enter 的 errno
+         */
+        int submitAndWait(unsigned count, int *results);
+
+    public:
+        ~IoRing();
+        IoRing(const IoRing &) = delete;
+        IoRing &operator=(const IoRing &) = delete;
+
+        /**
+         * @brief 获取当前进程的环
+         *
+         * @return IoRing* 环，不可用时为 nullptr（失败会被记住，不再重试）
+         */
+        static IoRing *get();
+
+        /**
+         * @brief 一直读到文件末尾，追加到 out
+         *
+         * @param fd 描述符
+         * @param out 输出参数，读到的数据追加在后面
+         * @return int 0 表示成功，否则为 errno
+         */
+        int readAll(int fd, std::string &out);
+
+        /**
+         * @brief 把数据全部写入描述符
+         *
+         * 对端已关闭时和 write 一样会产生 SIGPIPE，调用者负责忽略或阻塞。
+         *
+         * @param fd 描述符
+         * @param data 数据
+         * @param size 字节数
+         * @param written 输出参数，已经写入的字节数，出错时调用者可以从这里接着写
+         * @return int 0 表示成功，否则为 errno
+         */
+        int writeAll(int fd, const char *data, size_t size, size_t &written);
+
+        /**
+         * @brief 读到文件末尾：use_ring 为 true 且环可用时用 io_uring，否则用 read
+         *
+         * @param fd 描述符
+         * @param out 输出参数，读到的数据追加在后面
+         * @param use_ring 是否使用 io_uring
+         * @return int 0 表示成功，否则为 errno
+         */
+        static int readFully(int fd, std::string &out, bool use_ring);
+
+        /**
+         * @brief 全部写入：use_ring 为 true 且环可用时用 io_uring，否则用 write
+         *
+         * @param fd 描述符
+         * @param data 数据
+         * @param size 字节数
+         * @param use_ring 是否使用 io_uring
+         * @return int 0 表示成功，否则为 errno
+         */
+        static int writeFully(int fd, const char *data, size_t size, bool use_ring);
+    };
+
+} // namespace dash
+
+#endif // DASH_IO_RING_H
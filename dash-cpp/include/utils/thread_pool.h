@@ -0,0 +1,90 @@
+/**
+ * @file thread_pool.h
+ * @brief 固定大小的工作线程池定义
+ */
+
+#ifndef DASH_THREAD_POOL_H
+#define DASH_THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dash
+{
+
+    /**
+     * @brief 固定大小的工作线程池
+     *
+     * 只用于批量执行短小的任务（如并行创建管道各阶段的进程）。工作线程屏蔽所有信号，
+     * 信号始终由主线程处理，shell 的信号标志和被中断的系统调用行为不变。
+     */
+    class ThreadPool
+    {
+    private:
+        std::vector<std::thread> workers_;
+        std::deque<std::function<void()>> queue_;
+        std::mutex mutex_;
+        std::condition_variable work_cv_; // 有新任务或需要退出
+        std::condition_variable done_cv_; // 一批任务全部完成
+        size_t pending_;                  // 尚未完成的任务数
+        bool stopping_;
+
+        /**
+         * @brief 工作线程主循环
+         */
+        void workerLoop();
+
+        /**
+         * @brief 取出一个任务
+         *
+         * @param task 输出参数，取出的任务
+         * @return bool 是否取到任务
+         */
+        bool takeTask(std::function<void()> &task);
+
+        /**
+         * @brief 标记一个任务完成
+         */
+        void finishTask();
+
+    public:
+        /**
+         * @brief 构造函数
+         *
+         * @param threads 工作线程数量
+         */
+        explicit ThreadPool(size_t threads);
+
+        /**
+         * @brief 析构函数，等待所有工作线程退出
+         */
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        /**
+         * @brief 获取工作线程数量
+         *
+         * @return size_t 工作线程数量
+         */
+        size_t size() const { return workers_.size(); }
+
+        /**
+         * @brief 执行一批任务并等待全部完成
+         *
+         * 调用线程也参与执行任务。
+         *
+         * @param tasks 任务列表
+         */
+        void runAll(std::vector<std::function<void()>> &tasks);
+    };
+
+} // namespace dash
+
+#endif // DASH_THREAD_POOL_H
@@ -113,6 +113,7 @@ namespace dash
     private:
         Shell *shell_;
         std::unordered_map<std::string, std::unique_ptr<Variable>> variables_;
+        unsigned long path_generation_; // PATH 每次变化时递增
 
         /**
          * @brief 执行命令替换并返回输出
@@ -142,6 +143,24 @@ namespace dash
          */
         void initialize();
 
+        /**
+         * @brief 用给定的环境替换当前导出的变量
+         *
+         * 删除所有导出的变量（只读的除外），清空进程环境，再导入 env。
+         * 值没有变化的变量保持不动，PATH 相同时命令哈希表不会失效。
+         *
+         * @param env "名称=值" 形式的环境变量列表
+         */
+        void importEnvironment(const std::vector<std::string> &env);
+
+        /**
+         * @brief 删除所有未导出的变量
+         *
+         * 只读变量和特殊变量保留。用于子进程改为解释另一个脚本时，
+         * 新脚本只能看到环境中的变量。
+         */
+        void clearUnexported();
+
         /**
          * @brief 设置变量
          *
@@ -197,6 +216,33 @@ namespace dash
          */
         bool setReadOnly(const std::string &name);
 
+        /**
+         * @brief 保存的变量值
+         */
+        struct SavedVariable
+        {
+            std::string name;
+            bool existed;
+            std::string value;
+        };
+
+        /**
+         * @brief 保存一组变量的当前值
+         *
+         * 在 shell 进程中按子 shell 的语义运行命令时使用，之后用 restoreVariables 撤销修改。
+         *
+         * @param names 变量名列表
+         * @return std::vector<SavedVariable> 保存的值
+         */
+        std::vector<SavedVariable> saveVariables(const std::vector<std::string> &names) const;
+
+        /**
+         * @brief 把变量恢复为 saveVariables 保存的值，原来不存在的变量被删除
+         *
+         * @param saved 保存的值
+         */
+        void restoreVariables(const std::vector<SavedVariable> &saved);
+
         /**
          * @brief 获取所有变量名
          *
@@ -228,6 +274,15 @@ namespace dash
          */
         std::string expand(const std::string &str) const;
 
+        /**
+         * @brief 获取 PATH 代数
+         *
+         * PATH 每次被设置或删除时递增，命令哈希表据此判断缓存是否失效。
+         *
+         * @return unsigned long PATH 代数
+         */
+        unsigned long getPathGeneration() const { return path_generation_; }
+
         /**
          * @brief 更新特殊变量
          *
@@ -0,0 +1,313 @@
+/**
+ * @file cat_command.cpp
+ * @brief Cat命令类实现
+ */
+
+#include <iostream>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include "builtins/cat_command.h"
+#include "core/shell.h"
+#include "core/executor.h"
+
+namespace dash
+{
+
+    namespace
+    {
+        // 每次系统调用最多复制的字节数，内核会按实际能复制的量返回
+        const size_t COPY_CHUNK = 1 << 30;
+
+        /**
+         * @brief 是否表示内核不支持这种复制方式，应该退回到 read/write
+         */
+        bool isUnsupported(int error)
+        {
+            return error == EINVAL || error == ENOSYS || error == EXDEV || error == EOPNOTSUPP ||
+                   error == EBADF;
+        }
+    }
+
+    CatCommand::CatCommand(Shell *shell)
+        : BuiltinCommand(shell)
+    {
+    }
+
+    int CatCommand::execute(const std::vector<std::string> &args)
+    {
+        size_t i = 1;
+
+        // 处理选项，-u（不缓冲）是默认行为
+        for (; i < args.size() && args[i].size() > 1 && args[i][0] == '-'; ++i)
+        {
+            if (args[i] == "--")
+            {
+                ++i;
+                break;
+            }
+            if (args[i] == "-u")
+            {
+                continue;
+            }
+            std::cerr << "cat: 无效选项: " << args[i] << std::endl;
+            std::cerr << "cat: 用法: cat [-u] [file ...]" << std::endl;
+            return 1;
+        }
+
+        std::vector<std::string> files(args.begin() + i, args.end());
+        if (files.empty())
+        {
+            files.push_back("-");
+        }
+
+        MemoryStdio *stdio = shell_->getExecutor()->getMemoryStdio();
+        if (stdio)
+        {
+            return copyToStream(files, *stdio);
+        }
+
+        // 之前的内置命令可能还有输出留在 std::cout 中，直接写描述符前先写出去
+        std::cout.flush();
+
+        struct stat out_st;
+        if (fstat(STDOUT_FILENO, &out_st) == -1)
+        {
+            std::cerr << "cat: write error: " << strerror(errno) << std::endl;
+            return 1;
+        }
+
+        // 在 shell 进程中运行：读者退出时不能让 SIGPIPE 杀死 shell，改为检查 EPIPE
+        struct sigaction ignore, old_sigpipe;
+        memset(&ignore, 0, sizeof(ignore));
+        ignore.sa_handler = SIG_IGN;
+        sigaction(SIGPIPE, &ignore, &old_sigpipe);
+
+        int status = 0;
+        for (const auto &file : files)
+        {
+            bool is_stdin = file == "-";
+            int fd = is_stdin ? STDIN_FILENO : open(file.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd == -1)
+            {
+                std::cerr << "cat: " << file << ": " << strerror(errno) << std::endl;
+                status = 1;
+                continue;
+            }
+
+            struct stat in_st;
+            int error = 0;
+            bool write_error = false;
+            if (fstat(fd, &in_st) == -1)
+            {
+                error = errno;
+            }
+            else if (S_ISREG(in_st.st_mode) && S_ISREG(out_st.st_mode) && in_st.st_dev == out_st.st_dev &&
+                     in_st.st_ino == out_st.st_ino && in_st.st_size > 0)
+            {
+                std::cerr << "cat: " << file << ": input file is output file" << std::endl;
+                status = 1;
+            }
+            else
+            {
+                error = copy(fd, STDOUT_FILENO, chooseMethod(in_st, out_st), write_error);
+            }
+
+            if (!is_stdin)
+            {
+                close(fd);
+            }
+
+            if (error == EINTR)
+            {
+                // 在 shell 进程中被 Ctrl+C 打断
+                status = 128 + SIGINT;
+                break;
+            }
+            if (error == EPIPE && write_error)
+            {
+                // 与外部 cat 被 SIGPIPE 终止时的状态一致
+                status = 128 + SIGPIPE;
+                break;
+            }
+            if (error != 0)
+            {
+                if (write_error)
+                {
+                    std::cerr << "cat: write error: " << strerror(error) << std::endl;
+                    status = 1;
+                    break;
+                }
+                std::cerr << "cat: " << file << ": " << strerror(error) << std::endl;
+                status = 1;
+            }
+        }
+
+        sigaction(SIGPIPE, &old_sigpipe, nullptr);
+        return status;
+    }
+
+    std::string CatCommand::getName() const
+    {
+        return "cat";
+    }
+
+    std::string CatCommand::getHelp() const
+    {
+        return "cat [-u] [file ...] - 连接文件并输出到标准输出";
+    }
+
+    int CatCommand::copyToStream(const std::vector<std::string> &files, MemoryStdio &stdio)
+    {
+        int status = 0;
+        for (const auto &file : files)
+        {
+            bool is_stdin = file == "-";
+            if (is_stdin && stdio.input)
+            {
+                std::cout.write(stdio.input->data() + stdio.input_pos,
+                                static_cast<std::streamsize>(stdio.input->size() - stdio.input_pos));
+                stdio.input_pos = stdio.input->size();
+                continue;
+            }
+
+            int fd = is_stdin ? STDIN_FILENO : open(file.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd == -1)
+            {
+                std::cerr << "cat: " << file << ": " << strerror(errno) << std::endl;
+                status = 1;
+                continue;
+            }
+
+            static char buffer[128 * 1024];
+            ssize_t n;
+            while ((n = read(fd, buffer, sizeof(buffer))) != 0)
+            {
+                if (n == -1)
+                {
+                    if (errno == EINTR && !Shell::received_sigint)
+                    {
+                        continue;
+                    }
+                    std::cerr << "cat: " << file << ": " << strerror(errno) << std::endl;
+                    status = 1;
+                    break;
+                }
+                std::cout.write(buffer, n);
+            }
+
+            if (!is_stdin)
+            {
+                close(fd);
+            }
+        }
+        return status;
+    }
+
+    CatCommand::CopyMethod CatCommand::chooseMethod(const struct stat &in, const struct stat &out)
+    {
+        // /proc、/sys 下的文件大小为 0，内容在读取时生成，copy_file_range 会直接返回 0
+        if (S_ISREG(in.st_mode) && in.st_size == 0)
+        {
+            return CopyMethod::READ_WRITE;
+        }
+        if (S_ISREG(in.st_mode) && S_ISREG(out.st_mode))
+        {
+            return CopyMethod::COPY_FILE_RANGE;
+        }
+        if (S_ISREG(in.st_mode) && S_ISSOCK(out.st_mode))
+        {
+            return CopyMethod::SENDFILE;
+        }
+        // 输入是终端、字符设备或套接字时 splice 要攒满一块才返回，交互使用时看不到逐行输出
+        if ((S_ISFIFO(in.st_mode) || S_ISREG(in.st_mode)) && (S_ISFIFO(in.st_mode) || S_ISFIFO(out.st_mode)))
+        {
+            return CopyMethod::SPLICE;
+        }
+        return CopyMethod::READ_WRITE;
+    }
+
+    int CatCommand::copy(int in, int out, CopyMethod method, bool &write_error)
+    {
+        // 内核中复制：都使用并更新两端的文件偏移，中途退回 read/write 时从当前位置接着复制
+        while (method != CopyMethod::READ_WRITE)
+        {
+            ssize_t n;
+            switch (method)
+            {
+            case CopyMethod::COPY_FILE_RANGE:
+                n = copy_file_range(in, nullptr, out, nullptr, COPY_CHUNK, 0);
+                break;
+            case CopyMethod::SENDFILE:
+                n = sendfile(out, in, nullptr, COPY_CHUNK);
+                break;
+            default:
+                n = splice(in, nullptr, out, nullptr, COPY_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE);
+                break;
+            }
+
+            if (n == 0)
+            {
+                return 0;
+            }
+            if (n > 0)
+            {
+                continue;
+            }
+            if (errno == EINTR)
+            {
+                if (Shell::received_sigint)
+                {
+                    return EINTR;
+                }
+                continue;
+            }
+            if (isUnsupported(errno))
+            {
+                method = CopyMethod::READ_WRITE;
+                break;
+            }
+            // 出错的是哪一端无法从返回值区分：EPIPE、ENOSPC 之类只能来自输出
+            write_error = errno == EPIPE || errno == ENOSPC || errno == EDQUOT || errno == EFBIG;
+            return errno;
+        }
+
+        static char buffer[128 * 1024];
+        while (true)
+        {
+            ssize_t n = read(in, buffer, sizeof(buffer));
+            if (n == 0)
+            {
+                return 0;
+            }
+            if (n == -1)
+            {
+                if (errno == EINTR && !Shell::received_sigint)
+                {
+                    continue;
+                }
+                return errno;
+            }
+
+            ssize_t written = 0;
+            while (written < n)
+            {
+                ssize_t w = write(out, buffer + written, static_cast<size_t>(n - written));
+                if (w == -1)
+                {
+                    if (errno == EINTR && !Shell::received_sigint)
+                    {
+                        continue;
+                    }
+                    write_error = true;
+                    return errno;
+                }
+                written += w;
+            }
+        }
+    }
+
+} // namespace dash
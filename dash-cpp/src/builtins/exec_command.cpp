@@ -0,0 +1,55 @@
+/**
+ * @file exec_command.cpp
+ * @brief Exec命令类实现
+ */
+
+#include "builtins/exec_command.h"
+#include "core/shell.h"
+#include "core/executor.h"
+#include "utils/error.h"
+
+namespace dash
+{
+
+    ExecCommand::ExecCommand(Shell *shell)
+        : BuiltinCommand(shell)
+    {
+    }
+
+    int ExecCommand::execute(const std::vector<std::string> &args)
+    {
+        size_t first = 1;
+        if (first < args.size() && args[first] == "--")
+        {
+            ++first;
+        }
+
+        // 只有重定向：执行器已经把它们永久作用于 shell
+        if (first == args.size())
+        {
+            return 0;
+        }
+
+        std::vector<std::string> command(args.begin() + first, args.end());
+        int status = shell_->getExecutor()->replaceShell(command);
+
+        // 返回说明 exec 失败；非交互式 shell 随之退出
+        if (!shell_->isInteractive())
+        {
+            shell_->exit(status);
+            throw ShellException(ExceptionType::EXIT, "Exit requested");
+        }
+        return status;
+    }
+
+    std::string ExecCommand::getName() const
+    {
+        return "exec";
+    }
+
+    std::string ExecCommand::getHelp() const
+    {
+        return "exec [command [arg ...]] - 用命令替换 shell；不带命令时重定向对 shell 永久生效";
+    }
+
+} // namespace dash
@@ -0,0 +1,104 @@
+/**
+ * @file hash_command.cpp
+ * @brief Hash命令类实现
+ */
+
+#include <iostream>
+#include <iomanip>
+#include "builtins/hash_command.h"
+#include "core/shell.h"
+#include "core/executor.h"
+#include "core/command_table.h"
+
+namespace dash
+{
+
+    HashCommand::HashCommand(Shell *shell)
+        : BuiltinCommand(shell)
+    {
+    }
+
+    int HashCommand::execute(const std::vector<std::string> &args)
+    {
+        Executor *executor = shell_->getExecutor();
+        CommandTable *table = executor->getCommandTable();
+        size_t i = 1;
+
+        // 处理选项
+        for (; i < args.size() && args[i].size() > 1 && args[i][0] == '-'; ++i)
+        {
+            if (args[i] == "--")
+            {
+                ++i;
+                break;
+            }
+            if (args[i] == "-r")
+            {
+                table->clear();
+                continue;
+            }
+            std::cerr << "hash: 无效选项: " << args[i] << std::endl;
+            std::cerr << "hash: 用法: hash [-r] [name ...]" << std::endl;
+            return 1;
+        }
+
+        // 没有参数时列出哈希表
+        if (i == args.size())
+        {
+            if (args.size() > 1)
+            {
+                return 0;
+            }
+
+            auto entries = table->getEntries();
+            bool header = false;
+            for (const auto &pair : entries)
+            {
+                if (pair.second.path.empty())
+                {
+                    continue;
+                }
+                if (!header)
+                {
+                    std::cout << "hits\tcommand" << std::endl;
+                    header = true;
+                }
+                std::cout << std::setw(4) << pair.second.hits << "\t" << pair.second.path << std::endl;
+            }
+            if (!header)
+            {
+                std::cout << "hash: hash table empty" << std::endl;
+            }
+            return 0;
+        }
+
+        // 查找并记录指定的命令
+        int status = 0;
+        for (; i < args.size(); ++i)
+        {
+            const std::string &name = args[i];
+            if (name.find('/') != std::string::npos)
+            {
+                continue;
+            }
+            table->remove(name);
+            if (executor->findCommand(name, false).empty())
+            {
+                std::cerr << "hash: " << name << ": not found" << std::endl;
+                status = 1;
+            }
+        }
+        return status;
+    }
+
+    std::string HashCommand::getName() const
+    {
+        return "hash";
+    }
+
+    std::string HashCommand::getHelp() const
+    {
+        return "hash [-r] [name ...] - 记录并显示命令的完整路径";
+    }
+
+} // namespace dash
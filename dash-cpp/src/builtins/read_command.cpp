@@ -0,0 +1,169 @@
+/**
+ * @file read_command.cpp
+ * @brief Read命令类实现
+ */
+
+#include <iostream>
+#include "builtins/read_command.h"
+#include "core/shell.h"
+#include "core/executor.h"
+#include "variable/variable_manager.h"
+
+namespace dash
+{
+
+    ReadCommand::ReadCommand(Shell *shell)
+        : BuiltinCommand(shell)
+    {
+    }
+
+    int ReadCommand::execute(const std::vector<std::string> &args)
+    {
+        bool raw = false;
+        size_t first = parseOptions(args, raw);
+        if (first == 0)
+        {
+            std::cerr << "read: 用法: read [-r] [name ...]" << std::endl;
+            return 2;
+        }
+        std::vector<std::string> names = getVariableNames(args);
+
+        // 读一个逻辑行：没有 -r 时，反斜杠转义下一个字符，行尾的反斜杠表示续行
+        Executor *executor = shell_->getExecutor();
+        std::string text;
+        std::vector<bool> escaped;
+        bool complete;
+        while (true)
+        {
+            std::string line;
+            complete = executor->readInputLine(line);
+            bool continued = false;
+            for (size_t i = 0; i < line.size(); ++i)
+            {
+                if (!raw && line[i] == '\\')
+                {
+                    if (i + 1 == line.size())
+                    {
+                        continued = complete;
+                        break;
+                    }
+                    ++i;
+                    text += line[i];
+                    escaped.push_back(true);
+                    continue;
+                }
+                text += line[i];
+                escaped.push_back(false);
+            }
+            if (!continued)
+            {
+                break;
+            }
+        }
+
+        VariableManager *vars = shell_->getVariableManager();
+        std::string ifs = vars->exists("IFS") ? vars->get("IFS") : " \t\n";
+        auto isSeparator = [&](size_t pos)
+        {
+            return !escaped[pos] && ifs.find(text[pos]) != std::string::npos;
+        };
+        auto isSpace = [&](size_t pos)
+        {
+            return isSeparator(pos) && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\n');
+        };
+
+        size_t pos = 0;
+        while (pos < text.size() && isSpace(pos))
+        {
+            ++pos;
+        }
+
+        int status = complete ? 0 : 1;
+        for (size_t n = 0; n < names.size(); ++n)
+        {
+            std::string value;
+            if (n + 1 < names.size())
+            {
+                while (pos < text.size() && !isSeparator(pos))
+                {
+                    value += text[pos++];
+                }
+                // 分隔符是一串空白，或者一个非空白的 IFS 字符连同两侧的空白
+                while (pos < text.size() && isSpace(pos))
+                {
+                    ++pos;
+                }
+                if (pos < text.size() && isSeparator(pos))
+                {
+                    ++pos;
+                    while (pos < text.size() && isSpace(pos))
+                    {
+                        ++pos;
+                    }
+                }
+            }
+            else
+            {
+                // 最后一个变量得到剩余部分，去掉末尾的空白
+                size_t end = text.size();
+                while (end > pos && isSpace(end - 1))
+                {
+                    --end;
+                }
+                value = text.substr(pos, end - pos);
+            }
+
+            if (!vars->set(names[n], value))
+            {
+                std::cerr << "read: " << names[n] << ": is read only" << std::endl;
+                status = 1;
+            }
+        }
+        return status;
+    }
+
+    std::string ReadCommand::getName() const
+    {
+        return "read";
+    }
+
+    std::string ReadCommand::getHelp() const
+    {
+        return "read [-r] [name ...] - 从标准输入读一行并按 IFS 分割赋给变量";
+    }
+
+    std::vector<std::string> ReadCommand::getVariableNames(const std::vector<std::string> &args)
+    {
+        bool raw = false;
+        size_t first = parseOptions(args, raw);
+        if (first == 0)
+        {
+            return {};
+        }
+        if (first == args.size())
+        {
+            return {"REPLY"};
+        }
+        return std::vector<std::string>(args.begin() + first, args.end());
+    }
+
+    size_t ReadCommand::parseOptions(const std::vector<std::string> &args, bool &raw)
+    {
+        size_t i = 1;
+        for (; i < args.size() && args[i].size() > 1 && args[i][0] == '-'; ++i)
+        {
+            if (args[i] == "--")
+            {
+                return i + 1;
+            }
+            if (args[i] == "-r")
+            {
+                raw = true;
+                continue;
+            }
+            return 0;
+        }
+        return i;
+    }
+
+} // namespace dash
@@ -0,0 +1,76 @@
+/**
+ * @file set_command.cpp
+ * @brief Set命令类实现
+ */
+
+#include <iostream>
+#include "builtins/set_command.h"
+#include "core/shell.h"
+#include "core/options.h"
+
+namespace dash
+{
+
+    SetCommand::SetCommand(Shell *shell)
+        : BuiltinCommand(shell)
+    {
+    }
+
+    int SetCommand::execute(const std::vector<std::string> &args)
+    {
+        ShellOptions *options = shell_->getOptions();
+
+        // 没有参数或只有 -o/+o 时列出选项
+        if (args.size() == 1 || (args.size() == 2 && args[1] == "-o"))
+        {
+            options->print(std::cout);
+            return 0;
+        }
+        if (args.size() == 2 && args[1] == "+o")
+        {
+            options->printCommands(std::cout);
+            return 0;
+        }
+
+        for (size_t i = 1; i < args.size(); ++i)
+        {
+            const std::string &arg = args[i];
+            if ((arg != "-o" && arg != "+o") || i + 1 >= args.size())
+            {
+                std::cerr << "set: 无效选项: " << arg << std::endl;
+                std::cerr << "set: 用法: set [-o|+o] [name | name=value]" << std::endl;
+                return 1;
+            }
+
+            bool enable = arg == "-o";
+            const std::string &name = args[++i];
+            size_t equals = name.find('=');
+            bool ok;
+            if (equals == std::string::npos)
+            {
+                ok = options->setFlag(name, enable);
+            }
+            else
+            {
+                ok = enable && options->setValue(name.substr(0, equals), name.substr(equals + 1));
+            }
+            if (!ok)
+            {
+                std::cerr << "set: " << name << ": 无效的选项名或值" << std::endl;
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    std::string SetCommand::getName() const
+    {
+        return "set";
+    }
+
+    std::string SetCommand::getHelp() const
+    {
+        return "set [-o|+o] [name | name=value] - 查看和修改 shell 选项";
+    }
+
+} // namespace dash
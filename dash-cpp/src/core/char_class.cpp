@@ -0,0 +1,147 @@
+/**
+ * @file char_class.cpp
+ * @brief 字符分类的批量扫描实现
+ */
+
+#include "core/char_class.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define DASH_SCAN_X86 1
+#endif
+
+namespace dash
+{
+
+    namespace
+    {
+        using FindFunction = size_t (*)(const char *data, size_t pos, size_t size, const CharClass::StopSet &set);
+
+        /**
+         * @brief 逐字节查表
+         */
+        size_t findScalar(const char *data, size_t pos, size_t size, const CharClass::StopSet &set)
+        {
+            while (pos < size && !CharClass::is(data[pos], set.mask))
+            {
+                ++pos;
+            }
+            return pos;
+        }
+
+#if defined(DASH_SCAN_X86) && defined(__SSE2__)
+        /**
+         * @brief 每次比较 16 个字节：与每个目标字节比较一次，结果合并
+         */
+        size_t findSse2(const char *data, size_t pos, size_t size, const CharClass::StopSet &set)
+        {
+            const __m128i *targets = reinterpret_cast<const __m128i *>(set.repeated);
+            for (; pos + 16 <= size; pos += 16)
+            {
+                __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+                __m128i hit = _mm_setzero_si128();
+                for (size_t i = 0; i < set.count; ++i)
+                {
+                    hit = _mm_or_si128(hit, _mm_cmpeq_epi8(block, _mm_load_si128(targets + i)));
+                }
+                unsigned bits = static_cast<unsigned>(_mm_movemask_epi8(hit));
+                if (bits != 0)
+                {
+                    return pos + static_cast<size_t>(__builtin_ctz(bits));
+                }
+            }
+            return findScalar(data, pos, size, set);
+        }
+#endif
+
+#if defined(DASH_SCAN_X86)
+        /**
+         * @brief 每次检查 32 个字节：按低 4 位和高 4 位各查一次表，两个结果相与不为 0
+         *        的字节属于集合
+         */
+        __attribute__((target("avx2"))) size_t findAvx2(const char *data, size_t pos, size_t size,
+                                                          const CharClass::StopSet &set)
+        {
+            const __m256i low_table = _mm256_broadcastsi128_si256(
+                _mm_load_si128(reinterpret_cast<const __m128i *>(set.low_nibble)));
+            const __m256i high_table = _mm256_broadcastsi128_si256(
+                _mm_load_si128(reinterpret_cast<const __m128i *>(set.high_nibble)));
+            const __m256i nibble = _mm256_set1_epi8(0x0f);
+
+            for (; pos + 32 <= size; pos += 32)
+            {
+                __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + pos));
+                __m256i low = _mm256_and_si256(block, nibble);
+                __m256i high = _mm256_and_si256(_mm256_srli_epi16(block, 4), nibble);
+                __m256i hit = _mm256_and_si256(_mm256_shuffle_epi8(low_table, low),
+                                               _mm256_shuffle_epi8(high_table, high));
+                unsigned miss = static_cast<unsigned>(
+                    _mm256_movemask_epi8(_mm256_cmpeq_epi8(hit, _mm256_setzero_si256())));
+                if (miss != 0xffffffffu)
+                {
+                    return pos + static_cast<size_t>(__builtin_ctz(~miss));
+                }
+            }
+            return findScalar(data, pos, size, set);
+        }
+#endif
+
+        /**
+         * @brief 选择实现，CPU 不支持时退回较慢的实现
+         */
+        FindFunction chooseFind(ScanMethod method, const char *&name)
+        {
+#if defined(DASH_SCAN_X86)
+            __builtin_cpu_init();
+            if ((method == ScanMethod::AUTO || method == ScanMethod::AVX2) && __builtin_cpu_supports("avx2"))
+            {
+                name = "avx2";
+                return findAvx2;
+            }
+#if defined(__SSE2__)
+            if (method != ScanMethod::SCALAR)
+            {
+                name = "sse2";
+                return findSse2;
+            }
+#endif
+#endif
+            (void)method;
+            name = "scalar";
+            return findScalar;
+        }
+
+        const char *find_name = nullptr;
+        ScanMethod find_method = ScanMethod::AUTO;
+        FindFunction find_function = chooseFind(find_method, find_name);
+    }
+
+    size_t CharClass::find(std::string_view text, size_t pos, const StopSet &set)
+    {
+        if (pos >= text.size())
+        {
+            return text.size();
+        }
+        // 单词很短，当前字符经常就是目标，不必进入向量循环
+        if (is(text[pos], set.mask))
+        {
+            return pos;
+        }
+        return find_function(text.data(), pos + 1, text.size(), set);
+    }
+
+    void CharClass::setMethod(ScanMethod method)
+    {
+        if (method != find_method)
+        {
+            find_method = method;
+            find_function = chooseFind(method, find_name);
+        }
+    }
+
+    const char *CharClass::methodName()
+    {
+        return find_name;
+    }
+
+} // namespace dash
@@ -0,0 +1,107 @@
+/**
+ * @file command_table.cpp
+ * @brief 命令位置哈希表实现
+ */
+
+#include <algorithm>
+#include <sys/stat.h>
+#include "core/command_table.h"
+
+namespace dash
+{
+
+    CommandTable::CommandTable()
+        : path_generation_(0)
+    {
+    }
+
+    std::string CommandTable::searchPath(const std::string &name, const std::string &path, bool &cacheable)
+    {
+        cacheable = true;
+        size_t start = 0;
+        while (start <= path.size())
+        {
+            size_t end = path.find(':', start);
+            if (end == std::string::npos)
+            {
+                end = path.size();
+            }
+            std::string dir = path.substr(start, end - start);
+            start = end + 1;
+
+            if (dir.empty())
+            {
+                dir = ".";
+            }
+
+            // 相对目录的结果随当前目录变化，不能缓存
+            bool relative = dir[0] != '/';
+
+            std::string fullname = dir + "/" + name;
+            struct stat st;
+            if (stat(fullname.c_str(), &st) == 0 && S_ISREG(st.st_mode) && (st.st_mode & 0111))
+            {
+                cacheable = !relative;
+                return fullname;
+            }
+
+            if (relative)
+            {
+                cacheable = false;
+            }
+        }
+        return "";
+    }
+
+    CommandTable::Entry CommandTable::lookup(const std::string &name, const std::string &path,
+                                             unsigned long path_generation, bool count_hit)
+    {
+        // PATH 变化后，之前的结果全部失效
+        if (path_generation != path_generation_)
+        {
+            entries_.clear();
+            path_generation_ = path_generation;
+        }
+
+        auto it = entries_.find(name);
+        if (it != entries_.end())
+        {
+            if (count_hit)
+            {
+                it->second.hits++;
+            }
+            return it->second;
+        }
+
+        bool cacheable;
+        std::string fullname = searchPath(name, path, cacheable);
+        Entry entry{fullname, count_hit ? 1 : 0};
+        if (cacheable)
+        {
+            entries_[name] = entry;
+        }
+        return entry;
+    }
+
+    void CommandTable::remove(const std::string &name)
+    {
+        entries_.erase(name);
+    }
+
+    void CommandTable::clear()
+    {
+        entries_.clear();
+    }
+
+    std::vector<std::pair<std::string, CommandTable::Entry>> CommandTable::getEntries() const
+    {
+        std::vector<std::pair<std::string, Entry>> result(entries_.begin(), entries_.end());
+        std::sort(result.begin(), result.end(),
+                  [](const std::pair<std::string, Entry> &a, const std::pair<std::string, Entry> &b)
+                  {
+                      return a.first < b.first;
+                  });
+        return result;
+    }
+
+} // namespace dash
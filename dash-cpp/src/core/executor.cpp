@@ -4,17 +4,30 @@
  */
 
 #include <iostream>
+#include <sstream>
+#include <csignal>
+#include <pthread.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <poll.h>
 #include <cstring>
+#include <cerrno>
 #include <algorithm>
+#include <chrono>
+#include <thread>
 #include "core/executor.h"
+#include "core/expand.h"
 #include "core/shell.h"
 #include "core/node.h"
+#include "core/options.h"
 #include "job/job_control.h"
 #include "utils/error.h"
+#include "utils/io_ring.h"
 #include "variable/variable_manager.h"
 #include "builtins/cd_command.h"
 #include "builtins/echo_command.h"
@@ -23,21 +36,199 @@
 #include "builtins/jobs_command.h"
 #include "builtins/fg_command.h"
 #include "builtins/bg_command.h"
+#include "builtins/hash_command.h"
+#include "builtins/set_command.h"
+#include "builtins/cat_command.h"
+#include "builtins/read_command.h"
+#include "builtins/exec_command.h"
 
 namespace dash
 {
 
+    namespace
+    {
+        /**
+         * @brief 关闭并清空一组描述符
+         *
+         * @param fds 描述符列表
+         */
+        void closeFds(std::vector<int> &fds)
+        {
+            for (int fd : fds)
+            {
+                close(fd);
+            }
+            fds.clear();
+        }
+
+        /**
+         * @brief 生成管道的命令文本，用于作业列表
+         *
+         * @param nodes 各阶段的节点
+         * @return std::string 各阶段的参数，以 " | " 连接；复合命令显示为 "..."
+         */
+        std::string describePipeline(const std::vector<const Node *> &nodes)
+        {
+            std::string text;
+            for (const Node *node : nodes)
+            {
+                if (!text.empty())
+                {
+                    text += " | ";
+                }
+                if (node->getType() != NodeType::COMMAND)
+                {
+                    text += "...";
+                    continue;
+                }
+                const auto &args = static_cast<const CommandNode *>(node)->getArgs();
+                for (size_t i = 0; i < args.size(); ++i)
+                {
+                    text += i == 0 ? args[i] : " " + args[i];
+                }
+            }
+            return text;
+        }
+
+        /**
+         * @brief 创建管道，两端都带 close-on-exec 并放到 10 以上
+         *
+         * 放到 10 以上是为了不与阶段的标准输入输出和用户重定向的描述符冲突；
+         * exec 成功的阶段自动关闭不属于自己的管道。
+         *
+         * @param fds 输出参数，读端和写端
+         * @param size 缓冲区大小（字节），0 表示系统默认
+         * @return bool 是否成功，失败时 errno 有效
+         */
+        bool createPipe(int fds[2], size_t size)
+        {
+            if (pipe2(fds, O_CLOEXEC) == -1)
+            {
+                return false;
+            }
+            if (size > 0)
+            {
+                // 超出用户的管道内存配额时内核拒绝调整，保持默认大小即可
+                fcntl(fds[1], F_SETPIPE_SZ, static_cast<int>(size));
+            }
+            for (int i = 0; i < 2; ++i)
+            {
+                if (fds[i] >= 10)
+                {
+                    continue;
+                }
+                int high = fcntl(fds[i], F_DUPFD_CLOEXEC, 10);
+                if (high == -1)
+                {
+                    int saved_errno = errno;
+                    close(fds[0]);
+                    close(fds[1]);
+                    errno = saved_errno;
+                    return false;
+                }
+                close(fds[i]);
+                fds[i] = high;
+            }
+            return true;
+        }
+
+        /**
+         * @brief 把数据全部写入描述符
+         *
+         * @param fd 描述符
+         * @param data 数据
+         * @return bool 是否写完
+         */
+        bool writeAll(int fd, const std::string &data)
+        {
+            size_t written = 0;
+            while (written < data.size())
+            {
+                ssize_t n = write(fd, data.data() + written, data.size() - written);
+                if (n == -1 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n <= 0)
+                {
+                    return false;
+                }
+                written += static_cast<size_t>(n);
+            }
+            return true;
+        }
+
+        /**
+         * @brief 忽略 SIGPIPE 把数据全部写入描述符
+         *
+         * 在 shell 进程中代替内置命令写管道：读者已经退出时返回 false，而不是终止 shell。
+         *
+         * @param fd 描述符
+         * @param data 数据
+         * @param use_ring 是否使用 io_uring
+         * @return bool 是否写完
+         */
+        bool writeIgnoringSigpipe(int fd, const std::string &data, bool use_ring)
+        {
+            struct sigaction ignore, old_sigpipe;
+            memset(&ignore, 0, sizeof(ignore));
+            ignore.sa_handler = SIG_IGN;
+            sigaction(SIGPIPE, &ignore, &old_sigpipe);
+            bool ok = IoRing::writeFully(fd, data.data(), data.size(), use_ring) == 0;
+            sigaction(SIGPIPE, &old_sigpipe, nullptr);
+            return ok;
+        }
+
+        /**
+         * @brief 检查一次打开这么多描述符是否会超出进程的限制
+         *
+         * @param count 需要同时打开的描述符数量
+         * @return bool 是否有足够的余量
+         */
+        bool haveFdBudget(size_t count)
+        {
+            // 为用户重定向和 shell 自己使用的描述符留出余量
+            const size_t reserve = 64;
+            struct rlimit limit;
+            if (getrlimit(RLIMIT_NOFILE, &limit) == -1 || limit.rlim_cur == RLIM_INFINITY)
+            {
+                return true;
+            }
+            return count + reserve <= limit.rlim_cur;
+        }
+    }
+
     Executor::Executor(Shell *shell)
-        : shell_(shell), last_status_(0)
+        : shell_(shell), last_status_(0),
+          fork_backend_(std::make_unique<ForkSpawnBackend>()),
+          vfork_backend_(std::make_unique<VforkSpawnBackend>()),
+          posix_spawn_backend_(std::make_unique<PosixSpawnBackend>()),
+          zygote_backend_(std::make_unique<ZygoteSpawnBackend>(vfork_backend_.get())),
+          command_table_(std::make_unique<CommandTable>()),
+          fork_monitor_(std::make_unique<ForkMonitor>()),
+          spawn_pool_owner_(getpid()),
+          pipe_max_size_(0),
+          dev_null_fd_(-1),
+          redir_cache_(nullptr),
+          memory_stdio_(nullptr)
     {
         registerBuiltins();
     }
 
     Executor::~Executor()
     {
+        // fork 出的子进程中工作线程并不存在，不能等待它们退出
+        if (spawn_pool_owner_ != getpid())
+        {
+            spawn_pool_.release();
+        }
+        if (dev_null_fd_ != -1)
+        {
+            close(dev_null_fd_);
+        }
     }
 
-    int Executor::execute(const Node *node)
+    int Executor::execute(const Node *node, int flags)
     {
         if (!node)
         {
@@ -51,7 +242,9 @@ namespace dash
             switch (node->getType())
             {
             case NodeType::COMMAND:
-                status = executeCommand(static_cast<const CommandNode *>(node));
+                status = executeCommand(static_cast<const CommandNode *>(node), flags);
+                // 简单命令相当于只有一个阶段的管道
+                shell_->getVariableManager()->set("PIPESTATUS", std::to_string(status));
                 break;
 
             case NodeType::PIPE:
@@ -59,11 +252,15 @@ namespace dash
                 break;
 
             case NodeType::LIST:
-                status = executeList(static_cast<const ListNode *>(node));
+            {
+                // 同一个命令列表中重复的重定向复用描述符
+                RedirectionCacheScope scope(redir_cache_);
+                status = executeList(static_cast<const ListNode *>(node), flags);
                 break;
+            }
 
             case NodeType::IF:
-                status = executeIf(static_cast<const IfNode *>(node));
+                status = executeIf(static_cast<const IfNode *>(node), flags);
                 break;
 
             case NodeType::FOR:
@@ -75,7 +272,7 @@ namespace dash
                 break;
 
             case NodeType::CASE:
-                status = executeCase(static_cast<const CaseNode *>(node));
+                status = executeCase(static_cast<const CaseNode *>(node), flags);
                 break;
 
             case NodeType::SUBSHELL:
@@ -86,239 +283,1139 @@ namespace dash
                 throw ShellException(ExceptionType::INTERNAL, "Unknown node type");
             }
 
+            // 回收已经结束的辅助子进程
+            JobControl *job_control = shell_->getJobControl();
+            if (job_control)
+            {
+                job_control->reapHelperProcesses();
+            }
+
             last_status_ = status;
+            // 展开参数时用到的 $? 在每条命令结束后更新
+            shell_->getVariableManager()->updateSpecialVars(status);
             return status;
         }
         catch (const ShellException &e)
         {
+            // exit 需要一直传到执行循环的最外层
+            if (e.getType() == ExceptionType::EXIT)
+            {
+                throw;
+            }
             std::cerr << e.getTypeString() << ": " << e.what() << std::endl;
             last_status_ = 1;
+            shell_->getVariableManager()->updateSpecialVars(1);
             return 1;
         }
         catch (const std::exception &e)
         {
             std::cerr << "Error: " << e.what() << std::endl;
             last_status_ = 1;
+            shell_->getVariableManager()->updateSpecialVars(1);
             return 1;
         }
     }
 
-    int Executor::executeCommand(const CommandNode *command)
+    void Executor::executeAndExit(const Node *node, int flags)
+    {
+        int status;
+        try
+        {
+            status = execute(node, EXEC_TAIL | flags);
+        }
+        catch (const ShellException &)
+        {
+            // 只有 exit 会传到这里
+            status = shell_->getExitStatus();
+        }
+        std::cout.flush();
+        std::cerr.flush();
+        exit(status);
+    }
+
+    int Executor::executeCommand(const CommandNode *command, int flags)
     {
-        // 获取命令参数
+        // 后台命令相当于只有一个阶段的后台管道，重定向和进程替换与前台命令相同
+        if (command->isBackground() && !(flags & EXEC_FORKED))
+        {
+            return executePipeline({command}, true);
+        }
+
+        // 获取命令参数，启动进程替换后展开，管道端在命令结束后关闭
         std::vector<std::string> args = command->getArgs();
+        std::vector<int> substitution_fds;
+        if (!startProcessSubstitutions(command, args, substitution_fds))
+        {
+            return 1;
+        }
+        expandArgs(command, args);
+
         if (args.empty())
         {
+            // 只有变量赋值的命令：在当前 shell 中设置变量
+            VariableManager *vars = shell_->getVariableManager();
+            for (const auto &assignment : command->getAssignments())
+            {
+                size_t pos = assignment.find('=');
+                if (pos == std::string::npos)
+                {
+                    continue;
+                }
+                std::string name = assignment.substr(0, pos);
+                if (!vars->set(name, vars->expand(assignment.substr(pos + 1))))
+                {
+                    std::cerr << "dash: " << name << ": is read only" << std::endl;
+                    return 1;
+                }
+            }
             return 0;
         }
 
-        // 获取命令名
-        std::string cmd_name = args[0];
-        args.erase(args.begin());
-
-        if (isBuiltin(cmd_name))
+        // 获取命令名（内置命令和外部命令都以 args[0] 作为命令名）
+        std::string cmd_name = args[0];
+
+        if (cmd_name == "exec")
+        {
+            // exec 的重定向作用于 shell 本身，不恢复；中继进程随描述符关闭结束，由作业控制回收
+            std::cout.flush();
+            std::cerr.flush();
+            std::vector<pid_t> relays;
+            bool redirect_success = applyRedirections(command->getRedirectionPlan(),
+                                                      RedirectionPlan::Mode::PERSIST, nullptr, relays);
+            closeFds(substitution_fds);
+            JobControl *job_control = shell_->getJobControl();
+            for (pid_t relay : relays)
+            {
+                if (job_control)
+                {
+                    job_control->addHelperProcess(relay);
+                }
+            }
+            if (!redirect_success)
+            {
+                return 1;
+            }
+            return executeBuiltin(cmd_name, args);
+        }
+
+        if (isBuiltin(cmd_name))
+        {
+            // 设置重定向
+            RedirectionPlan::SavedFds saved_fds;
+            std::vector<pid_t> relays;
+            bool redirect_success = applyRedirections(command->getRedirectionPlan(),
+                                                      RedirectionPlan::Mode::RESTORE, &saved_fds, relays);
+
+            if (!redirect_success)
+            {
+                closeFds(substitution_fds);
+                RedirectionPlan::waitRelays(relays);
+                return 1;
+            }
+
+            // 执行内置命令
+            int status = executeBuiltin(cmd_name, args);
+
+            // 恢复重定向；写入被关闭的描述符会让 std::cout 进入错误状态，一并清除
+            std::cout.flush();
+            saved_fds.restore();
+            std::cout.clear();
+
+            // 恢复后中继管道的写端都已关闭，等中继把数据写完
+            closeFds(substitution_fds);
+            RedirectionPlan::waitRelays(relays);
+            return status;
+        }
+
+        // 执行外部命令
+        int status = executeExternalCommand(cmd_name, args, command->getRedirectionPlan(), flags, substitution_fds);
+        closeFds(substitution_fds);
+        return status;
+    }
+
+    int Executor::executePipe(const PipeNode *pipe_node)
+    {
+        std::vector<const Node *> stages;
+        stages.reserve(pipe_node->getCommands().size());
+        for (const auto &command : pipe_node->getCommands())
+        {
+            stages.push_back(command.get());
+        }
+        return executePipeline(stages, pipe_node->isBackground());
+    }
+
+    void Executor::expandArgs(const CommandNode *command, std::vector<std::string> &args)
+    {
+        const auto &expansions = command->getArgExpansions();
+        if (expansions.empty())
+        {
+            return;
+        }
+
+        Expand expand(*shell_);
+        std::vector<std::string> expanded;
+        expanded.reserve(args.size());
+        auto next = expansions.begin();
+        for (size_t i = 0; i < args.size(); ++i)
+        {
+            if (next != expansions.end() && next->arg_index == i)
+            {
+                expand.expandSegments(args[i], next->segments, expanded);
+                ++next;
+            }
+            else
+            {
+                expanded.push_back(std::move(args[i]));
+            }
+        }
+        args = std::move(expanded);
+    }
+
+    ThreadPool *Executor::getSpawnPool()
+    {
+        // fork 出的子进程中没有工作线程
+        if (spawn_pool_owner_ != getpid())
+        {
+            return nullptr;
+        }
+        if (!spawn_pool_)
+        {
+            // 调用线程也参与创建进程，工作线程数比 CPU 数少一个
+            unsigned int cpus = std::thread::hardware_concurrency();
+            size_t threads = std::min<size_t>(cpus > 0 ? cpus : 1, PIPELINE_MAX_SPAWN_THREADS) - 1;
+            if (threads == 0)
+            {
+                return nullptr;
+            }
+            spawn_pool_ = std::make_unique<ThreadPool>(threads);
+        }
+        return spawn_pool_.get();
+    }
+
+    bool Executor::startProcessSubstitutions(const CommandNode *command, std::vector<std::string> &args,
+                                             std::vector<int> &fds)
+    {
+        const auto &substitutions = command->getProcessSubstitutions();
+        if (substitutions.empty())
+        {
+            return true;
+        }
+
+        std::cout.flush();
+        std::cerr.flush();
+        for (const auto &substitution : substitutions)
+        {
+            int pipe_fds[2];
+            if (!createPipe(pipe_fds, 0))
+            {
+                std::cerr << "dash: pipe: " << strerror(errno) << std::endl;
+                closeFds(fds);
+                return false;
+            }
+
+            // <(cmd) 的子进程写管道，命令读；>(cmd) 反过来
+            int child_end = substitution.output ? pipe_fds[0] : pipe_fds[1];
+            int parent_end = substitution.output ? pipe_fds[1] : pipe_fds[0];
+            pid_t pid = forkProcess();
+            if (pid == 0)
+            {
+                dup2(child_end, substitution.output ? STDIN_FILENO : STDOUT_FILENO);
+                close(pipe_fds[0]);
+                close(pipe_fds[1]);
+                closeFds(fds);
+                executeAndExit(substitution.command.get());
+            }
+            close(child_end);
+            if (pid == -1)
+            {
+                std::cerr << "dash: fork: " << strerror(errno) << std::endl;
+                close(parent_end);
+                closeFds(fds);
+                return false;
+            }
+
+            JobControl *job_control = shell_->getJobControl();
+            if (job_control)
+            {
+                job_control->addHelperProcess(pid);
+            }
+            fds.push_back(parent_end);
+            args[substitution.arg_index] = "/dev/fd/" + std::to_string(parent_end);
+        }
+        return true;
+    }
+
+    void Executor::preparePipelineStage(PipelineStage &stage)
+    {
+        // 外部命令的阶段在父进程中准备好，由进程创建后端直接启动；其余阶段 fork 后执行
+        const CommandNode *command = stage.node->getType() == NodeType::COMMAND
+                                         ? static_cast<const CommandNode *>(stage.node)
+                                         : nullptr;
+        // 命令名需要展开时也交给 shell 副本
+        if (!command || command->getArgs().empty() || isBuiltin(command->getArgs()[0]) ||
+            (!command->getArgExpansions().empty() && command->getArgExpansions().front().arg_index == 0))
+        {
+            stage.plan.needs_shell = true;
+            return;
+        }
+
+        stage.name = command->getArgs()[0];
+        std::string fullname = findCommand(stage.name);
+        if (fullname.empty())
+        {
+            std::cerr << "dash: " << stage.name << ": not found" << std::endl;
+            stage.status = 127;
+            return;
+        }
+
+        stage.plan.command = fullname;
+        stage.plan.args = command->getArgs();
+        if (!startProcessSubstitutions(command, stage.plan.args, stage.opened_fds))
+        {
+            stage.status = 1;
+            return;
+        }
+        expandArgs(command, stage.plan.args);
+        // 进程替换的管道带 close-on-exec，复制到自身以传给命令
+        for (int fd : stage.opened_fds)
+        {
+            stage.redirections.emplace_back(FileAction::DUP2, fd, fd);
+        }
+        if (!command->getRedirectionPlan().buildFileActions(getRedirectionContext(stage.relays), stage.redirections,
+                                                            stage.opened_fds))
+        {
+            stage.status = 1;
+            return;
+        }
+        stage.plan.script_handler = [this](const SpawnPlan &script)
+        {
+            shell_->runScriptInChild(script.command, script.args);
+        };
+    }
+
+    void Executor::setPipelineActions(PipelineStage &stage, int input, int output,
+                                      const std::vector<int> &pipe_fds) const
+    {
+        // 先接好管道，再关闭管道描述符，最后执行阶段自己的重定向。
+        // 管道都带 close-on-exec，exec 的阶段不需要逐个关闭（长管道中这是 O(N²) 个操作），
+        // 只有 fork 后运行 shell 代码的阶段需要
+        std::vector<FileAction> &actions = stage.plan.actions;
+        actions.clear();
+        if (input != -1)
+        {
+            actions.emplace_back(FileAction::DUP2, STDIN_FILENO, input);
+        }
+        if (output != -1)
+        {
+            actions.emplace_back(FileAction::DUP2, STDOUT_FILENO, output);
+        }
+        if (stage.plan.needs_shell)
+        {
+            for (int fd : pipe_fds)
+            {
+                if (fd != -1)
+                {
+                    actions.emplace_back(FileAction::CLOSE, fd);
+                }
+            }
+        }
+        actions.insert(actions.end(), stage.redirections.begin(), stage.redirections.end());
+    }
+
+    void Executor::launchPipelineStage(PipelineStage &stage)
+    {
+        stage.launched = true;
+        if (stage.in_process || stage.buffered)
+        {
+            // 启动阶段之后管道端会被关闭，留一份副本给之后在 shell 中运行或写入的阶段；
+            // buffered 阶段不读标准输入
+            int first_fd = stage.buffered ? STDOUT_FILENO : STDIN_FILENO;
+            for (const auto &action : stage.plan.actions)
+            {
+                if (action.kind == FileAction::DUP2 && action.fd >= first_fd && action.fd <= STDOUT_FILENO &&
+                    stage.stdio_fds[action.fd] == -1)
+                {
+                    stage.stdio_fds[action.fd] = fcntl(action.source_fd, F_DUPFD_CLOEXEC, RedirectionPlan::MAX_FD);
+                }
+            }
+            stage.result.pid = 0;
+            return;
+        }
+        if (!stage.plan.needs_shell)
+        {
+            stage.result = spawnWith(selectSpawnBackend(stage.plan), stage.plan);
+            return;
+        }
+
+        pid_t pid = forkProcess();
+        if (pid == 0)
+        {
+            if (stage.plan.pgid >= 0)
+            {
+                setpgid(0, stage.plan.pgid);
+            }
+            runFileActions(stage.plan.actions);
+            // 后台简单命令就运行在这个子进程中
+            executeAndExit(stage.node, stage.node->getType() == NodeType::COMMAND ? EXEC_FORKED : EXEC_NONE);
+        }
+        stage.result.pid = pid;
+        stage.result.error = pid == -1 ? errno : 0;
+    }
+
+    bool Executor::isInProcessBuiltin(const std::string &command)
+    {
+        return command == "cat";
+    }
+
+    bool Executor::isProducerBuiltin(const std::string &command)
+    {
+        return command == "echo" || command == "pwd" || command == "jobs";
+    }
+
+    bool Executor::isMemoryPipelineBuiltin(const std::string &command)
+    {
+        return isProducerBuiltin(command) || command == "cat" || command == "read";
+    }
+
+    int Executor::executeMemoryPipeline(const std::vector<const Node *> &nodes)
+    {
+        VariableManager *vars = shell_->getVariableManager();
+        std::string input;
+        std::string pipe_status;
+        int status = 0;
+        int failed_status = 0;
+        for (size_t i = 0; i < nodes.size(); ++i)
+        {
+            const CommandNode *command = static_cast<const CommandNode *>(nodes[i]);
+            bool last = i + 1 == nodes.size();
+
+            MemoryStdio stdio;
+            stdio.input = i == 0 ? nullptr : &input;
+            std::vector<VariableManager::SavedVariable> saved_vars;
+            if (command->getArgs()[0] == "read")
+            {
+                saved_vars = vars->saveVariables(ReadCommand::getVariableNames(command->getArgs()));
+            }
+
+            std::ostringstream output;
+            std::streambuf *saved = std::cout.rdbuf(output.rdbuf());
+            memory_stdio_ = &stdio;
+            try
+            {
+                status = executeCommand(command, 0);
+            }
+            catch (...)
+            {
+                memory_stdio_ = nullptr;
+                std::cout.rdbuf(saved);
+                vars->restoreVariables(saved_vars);
+                throw;
+            }
+            memory_stdio_ = nullptr;
+            std::cout.rdbuf(saved);
+            std::cout.clear();
+            input = output.str();
+            vars->restoreVariables(saved_vars);
+
+            // 最后一个阶段写到 shell 自己的标准输出，读者已经退出时与外部命令被 SIGPIPE 终止的状态一致
+            if (last)
+            {
+                std::cout.flush();
+                if (!writeIgnoringSigpipe(STDOUT_FILENO, input, shell_->getOptions()->getIoUring()))
+                {
+                    status = 128 + SIGPIPE;
+                }
+            }
+
+            if (!pipe_status.empty())
+            {
+                pipe_status += ' ';
+            }
+            pipe_status += std::to_string(status);
+            if (status != 0)
+            {
+                failed_status = status;
+            }
+        }
+        vars->set("PIPESTATUS", pipe_status);
+
+        if (shell_->getOptions()->getPipefail())
+        {
+            return failed_status;
+        }
+        return status;
+    }
+
+    bool Executor::readInputLine(std::string &line)
+    {
+        line.clear();
+        if (memory_stdio_ && memory_stdio_->input)
+        {
+            const std::string &input = *memory_stdio_->input;
+            size_t start = memory_stdio_->input_pos;
+            size_t end = input.find('\n', start);
+            if (end == std::string::npos)
+            {
+                line.assign(input, start, std::string::npos);
+                memory_stdio_->input_pos = input.size();
+                return false;
+            }
+            line.assign(input, start, end - start);
+            memory_stdio_->input_pos = end + 1;
+            return true;
+        }
+
+        // 标准输入可能还要给后面的命令读，只能一个字节一个字节地读
+        char c;
+        while (true)
+        {
+            ssize_t n = read(STDIN_FILENO, &c, 1);
+            if (n == 1)
+            {
+                if (c == '\n')
+                {
+                    return true;
+                }
+                line += c;
+                continue;
+            }
+            if (n == -1 && errno == EINTR && !Shell::received_sigint)
+            {
+                continue;
+            }
+            return false;
+        }
+    }
+
+    void Executor::runBufferedStage(PipelineStage &stage)
+    {
+        std::ostringstream output;
+        std::streambuf *saved = std::cout.rdbuf(output.rdbuf());
+        try
+        {
+            stage.status = executeCommand(static_cast<const CommandNode *>(stage.node), 0);
+        }
+        catch (...)
+        {
+            std::cout.rdbuf(saved);
+            throw;
+        }
+        std::cout.rdbuf(saved);
+        std::cout.clear();
+        stage.output = output.str();
+    }
+
+    void Executor::writeBufferedOutput(PipelineStage &stage)
+    {
+        // 最后一个阶段写到 shell 自己的标准输出
+        int fd = stage.stdio_fds[STDOUT_FILENO];
+        stage.stdio_fds[STDOUT_FILENO] = -1;
+        if (fd == -1)
+        {
+            std::cout.flush();
+            if (!writeIgnoringSigpipe(STDOUT_FILENO, stage.output, shell_->getOptions()->getIoUring()))
+            {
+                stage.status = 128 + SIGPIPE;
+            }
+            return;
+        }
+
+        int capacity = fcntl(fd, F_GETPIPE_SZ);
+        if (capacity != -1 && stage.output.size() <= static_cast<size_t>(capacity))
+        {
+            // 管道是新建的、还是空的，写入不会阻塞
+            if (!writeIgnoringSigpipe(fd, stage.output, shell_->getOptions()->getIoUring()))
+            {
+                stage.status = 128 + SIGPIPE;
+            }
+            close(fd);
+            return;
+        }
+
+        stage.writer = std::thread([&stage, fd]()
+                                   {
+            // 只在本线程中阻塞 SIGPIPE：读者先退出时 write 返回 EPIPE，不会终止 shell
+            sigset_t mask;
+            sigemptyset(&mask);
+            sigaddset(&mask, SIGPIPE);
+            pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+            if (!writeAll(fd, stage.output))
+            {
+                stage.status = 128 + SIGPIPE;
+            }
+            close(fd); });
+    }
+
+    void Executor::runInProcessStage(PipelineStage &stage)
+    {
+        RedirectionPlan::SavedFds saved_fds;
+        int error = 0;
+        for (int fd = STDIN_FILENO; fd <= STDOUT_FILENO; ++fd)
+        {
+            if (stage.stdio_fds[fd] == -1)
+            {
+                continue;
+            }
+            if (error == 0 && (!saved_fds.save(fd) || dup2(stage.stdio_fds[fd], fd) == -1))
+            {
+                error = errno;
+            }
+            close(stage.stdio_fds[fd]);
+            stage.stdio_fds[fd] = -1;
+        }
+
+        if (error != 0)
+        {
+            std::cerr << "dash: " << strerror(error) << std::endl;
+            stage.status = 2;
+        }
+        else
+        {
+            try
+            {
+                stage.status = executeCommand(static_cast<const CommandNode *>(stage.node), 0);
+            }
+            catch (...)
+            {
+                std::cout.flush();
+                saved_fds.restore();
+                std::cout.clear();
+                throw;
+            }
+        }
+
+        // 恢复后管道写端关闭，下一个阶段读到 EOF
+        std::cout.flush();
+        saved_fds.restore();
+        std::cout.clear();
+    }
+
+    void Executor::finishPipelineStage(PipelineStage &stage)
+    {
+        if (!stage.launched)
+        {
+            return;
+        }
+        if (!stage.name.empty())
+        {
+            stage.result = retrySpawn(stage.name, stage.plan, stage.result);
+        }
+        if (stage.result.pid == -1)
+        {
+            if (stage.plan.needs_shell)
+            {
+                std::cerr << "dash: fork: " << strerror(stage.result.error) << std::endl;
+                stage.status = 2;
+            }
+            else
+            {
+                stage.status = reportSpawnError(stage.plan, stage.result);
+            }
+        }
+    }
+
+    void Executor::launchPipelineSequential(std::vector<PipelineStage> &stages, bool use_pgid, size_t pipe_size)
+    {
+        // 边创建管道边启动：任何时候只打开上一个管道的读端和当前管道，
+        // 再长的管道也不会用完描述符
+        pid_t pgid = use_pgid ? 0 : -1;
+        int input = -1;
+        std::vector<int> held; // 留给在 shell 中运行的阶段的管道端，之后 fork 的阶段要关闭
+        for (size_t i = 0; i < stages.size(); ++i)
+        {
+            PipelineStage &stage = stages[i];
+            int fds[2] = {-1, -1};
+            if (i + 1 < stages.size() && !createPipe(fds, pipe_size))
+            {
+                std::cerr << "dash: pipe: " << strerror(errno) << std::endl;
+                for (size_t j = i; j < stages.size(); ++j)
+                {
+                    stages[j].status = 2;
+                }
+                break;
+            }
+
+            std::vector<int> open_fds = {input, fds[0], fds[1]};
+            open_fds.insert(open_fds.end(), held.begin(), held.end());
+            setPipelineActions(stage, input, fds[1], open_fds);
+            stage.plan.pgid = pgid;
+            if (stage.plan.needs_shell || stage.status == 0)
+            {
+                launchPipelineStage(stage);
+                finishPipelineStage(stage);
+                // 第一个成功启动的阶段成为进程组组长，其余阶段加入它的进程组
+                if (pgid == 0 && stage.result.pid > 0)
+                {
+                    pgid = stage.result.pid;
+                }
+                if (stage.in_process || stage.buffered)
+                {
+                    held.insert(held.end(), std::begin(stage.stdio_fds), std::end(stage.stdio_fds));
+                }
+            }
+
+            if (input != -1)
+            {
+                close(input);
+            }
+            if (fds[1] != -1)
+            {
+                close(fds[1]);
+            }
+            input = fds[0];
+        }
+        if (input != -1)
+        {
+            close(input);
+        }
+    }
+
+    size_t Executor::launchPipelineParallel(std::vector<PipelineStage> &stages, ThreadPool *pool, bool use_pgid,
+                                            size_t pipe_size)
+    {
+        size_t count = stages.size();
+
+        // 预先创建全部管道，各阶段的描述符操作都在启动前确定
+        std::vector<int> pipe_fds;
+        pipe_fds.reserve(2 * (count - 1));
+        for (size_t i = 0; i + 1 < count; ++i)
+        {
+            int fds[2];
+            if (!createPipe(fds, pipe_size))
+            {
+                // 改为边创建边启动：需要的描述符更少，仍然失败时按相同方式报告并设置各阶段状态
+                for (int fd : pipe_fds)
+                {
+                    close(fd);
+                }
+                launchPipelineSequential(stages, use_pgid, pipe_size);
+                return 0;
+            }
+            pipe_fds.push_back(fds[0]);
+            pipe_fds.push_back(fds[1]);
+        }
+        for (size_t i = 0; i < count; ++i)
+        {
+            setPipelineActions(stages[i], i > 0 ? pipe_fds[2 * (i - 1)] : -1,
+                               i + 1 < count ? pipe_fds[2 * i + 1] : -1, pipe_fds);
+        }
+
+        // 组长必须先创建，其余阶段才能加入它的进程组；在 shell 中运行的阶段不能当组长
+        size_t leader = 0;
+        while (leader < count && (stages[leader].in_process || stages[leader].buffered))
+        {
+            ++leader;
+        }
+        if (use_pgid && leader < count)
+        {
+            stages[leader].plan.pgid = 0;
+            if (stages[leader].plan.needs_shell || stages[leader].status == 0)
+            {
+                launchPipelineStage(stages[leader]);
+            }
+            pid_t pgid = stages[leader].result.pid > 0 ? stages[leader].result.pid : -1;
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (i != leader)
+                {
+                    stages[i].plan.pgid = pgid;
+                }
+            }
+        }
+
+        // 外部命令阶段交给线程池，工作线程中只使用 vfork 或 posix_spawn
+        std::vector<std::function<void()>> tasks;
+        for (size_t i = 0; i < count; ++i)
+        {
+            PipelineStage *stage = &stages[i];
+            if (stage->launched || stage->plan.needs_shell || stage->status != 0)
+            {
+                continue;
+            }
+            stage->launched = true;
+            tasks.emplace_back([this, stage]()
+                               { stage->result = selectParallelSpawnBackend(stage->plan)->spawn(stage->plan); });
+        }
+        size_t parallel = tasks.size();
+        pool->runAll(tasks);
+
+        // 需要运行 shell 代码的阶段只能在主线程中 fork；在 shell 中运行的阶段最后留住管道端，
+        // 不让 fork 出的阶段继承
+        for (size_t i = 0; i < count; ++i)
+        {
+            if (!stages[i].launched && stages[i].plan.needs_shell && !stages[i].in_process &&
+                !stages[i].buffered)
+            {
+                launchPipelineStage(stages[i]);
+            }
+        }
+        for (auto &stage : stages)
+        {
+            if (!stage.launched && (stage.in_process || stage.buffered))
+            {
+                launchPipelineStage(stage);
+            }
+        }
+
+        // 失败的阶段在主线程中按顺序重试并报告，之后父进程才能关闭管道
+        for (auto &stage : stages)
+        {
+            finishPipelineStage(stage);
+        }
+        for (int fd : pipe_fds)
+        {
+            close(fd);
+        }
+        return parallel;
+    }
+
+    int Executor::executePipeline(const std::vector<const Node *> &nodes, bool background)
+    {
+        if (nodes.empty())
+        {
+            return 0;
+        }
+
+        auto start_time = std::chrono::steady_clock::now();
+        size_t count = nodes.size();
+
+        std::vector<PipelineStage> stages(count);
+        size_t external = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            stages[i].node = nodes[i];
+            preparePipelineStage(stages[i]);
+            if (!stages[i].plan.needs_shell && stages[i].status == 0)
+            {
+                ++external;
+            }
+        }
+
+        // 全部是内置命令时整个管道在内存中运行
+        if (!background && count > 1)
+        {
+            bool all_builtin = true;
+            for (const Node *node : nodes)
+            {
+                const CommandNode *command = node->getType() == NodeType::COMMAND
+                                                 ? static_cast<const CommandNode *>(node)
+                                                 : nullptr;
+                if (!command || command->getArgs().empty() || command->isBackground() ||
+                    !isMemoryPipelineBuiltin(command->getArgs()[0]) || !command->getRedirectionPlan().empty() ||
+                    !command->getProcessSubstitutions().empty())
+                {
+                    all_builtin = false;
+                    break;
+                }
+            }
+            if (all_builtin)
+            {
+                return executeMemoryPipeline(nodes);
+            }
+        }
+
+        // 内置命令阶段尽量在 shell 进程中运行，不 fork shell 副本：
+        // 只产生输出的命令先运行，输出暂存在内存中；读写标准输入输出的命令（如 cat）
+        // 在其余阶段启动后运行，只能有一个，shell 运行它时无法同时为另一个这样的阶段读写管道
+        if (!background)
+        {
+            bool have_in_process = false;
+            for (auto &stage : stages)
+            {
+                const CommandNode *command = stage.node->getType() == NodeType::COMMAND
+                                                 ? static_cast<const CommandNode *>(stage.node)
+                                                 : nullptr;
+                if (!command || command->getArgs().empty() || command->isBackground())
+                {
+                    continue;
+                }
+                const std::string &name = command->getArgs()[0];
+                if (isProducerBuiltin(name) && command->getRedirectionPlan().empty() &&
+                    command->getProcessSubstitutions().empty())
+                {
+                    stage.buffered = true;
+                    runBufferedStage(stage);
+                }
+                else if (!have_in_process && isInProcessBuiltin(name))
+                {
+                    stage.in_process = true;
+                    have_in_process = true;
+                }
+            }
+        }
+
+        // 作业控制打开时整个管道在一个新进程组中，第一个阶段为组长
+        bool use_pgid = shell_->getJobControl() && shell_->getJobControl()->isEnabled();
+
+        // 外部命令阶段足够多、描述符也够用时，预先创建全部管道并行启动
+        ThreadPool *pool = nullptr;
+        SpawnBackendType backend = getSpawnBackend();
+        if (external >= PIPELINE_PARALLEL_MIN_STAGES &&
+            (backend == SpawnBackendType::AUTO || backend == SpawnBackendType::VFORK ||
+             backend == SpawnBackendType::POSIX_SPAWN) &&
+            haveFdBudget(2 * (count - 1)))
+        {
+            pool = getSpawnPool();
+        }
+
+        // 固定大小的管道在创建时调整；自动模式等管道运行一段时间后再扩大
+        size_t pipe_size_kb = shell_->getOptions()->getPipeSize();
+        size_t pipe_size = 0;
+        if (pipe_size_kb != ShellOptions::SIZE_AUTO && pipe_size_kb > 0)
+        {
+            pipe_size = std::min(pipe_size_kb * 1024, getPipeMaxSize());
+        }
+
+        std::cout.flush();
+        std::cerr.flush();
+
+        size_t parallel = 0;
+        if (pool)
+        {
+            parallel = launchPipelineParallel(stages, pool, use_pgid, pipe_size);
+        }
+        else
+        {
+            launchPipelineSequential(stages, use_pgid, pipe_size);
+        }
+        for (auto &stage : stages)
+        {
+            closeFds(stage.opened_fds);
+        }
+        bool show_stats = !shell_->getVariableManager()->get("DASH_PIPELINE_STATS").empty();
+        if (show_stats)
+        {
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                               std::chrono::steady_clock::now() - start_time)
+                               .count();
+            std::cerr << "dash: pipeline: " << count << " stages (" << parallel
+                      << " parallel) started in " << elapsed << " us" << std::endl;
+        }
+
+        for (auto &stage : stages)
+        {
+            if (stage.buffered && stage.launched)
+            {
+                writeBufferedOutput(stage);
+            }
+        }
+        for (auto &stage : stages)
+        {
+            if (stage.in_process && stage.launched)
+            {
+                runInProcessStage(stage);
+            }
+        }
+
+        if (background)
+        {
+            // 后台管道登记为作业，jobs、fg 可以找到它；后台简单命令也走这里
+            JobControl *job_control = shell_->getJobControl();
+            int job_id = -1;
+            pid_t last_pid = -1;
+            for (const auto &stage : stages)
+            {
+                if (stage.result.pid <= 0)
+                {
+                    continue;
+                }
+                if (job_control && job_id == -1)
+                {
+                    job_id = job_control->addJob(describePipeline(nodes), stage.result.pid);
+                    job_control->setCurrentJobId(job_id);
+                }
+                if (job_control)
+                {
+                    job_control->addProcess(job_id, stage.result.pid, describePipeline({stage.node}));
+                }
+                last_pid = stage.result.pid;
+            }
+            if (job_id != -1)
+            {
+                std::cout << "[" << job_id << "] " << last_pid << std::endl;
+            }
+            else if (last_pid > 0)
+            {
+                std::cout << "[" << last_pid << "] " << "Background job started" << std::endl;
+            }
+
+            // 中继随管道在后台运行，结束后由作业控制回收
+            for (auto &stage : stages)
+            {
+                for (pid_t relay : stage.relays)
+                {
+                    if (job_control)
+                    {
+                        job_control->addHelperProcess(relay);
+                    }
+                }
+            }
+            return 0;
+        }
+
+        if (pipe_size_kb == ShellOptions::SIZE_AUTO)
+        {
+            growLongRunningPipes(stages);
+        }
+
+        // 在同一个循环中回收所有阶段，记录每个阶段的状态
+        std::string pipe_status;
+        int status = 0;
+        int failed_status = 0;
+        for (auto &stage : stages)
+        {
+            if (stage.result.pid > 0)
+            {
+                stage.status = waitForChild(stage.result.pid, show_stats ? &stage.usage : nullptr);
+            }
+            if (stage.writer.joinable())
+            {
+                stage.writer.join();
+            }
+            if (!pipe_status.empty())
+            {
+                pipe_status += ' ';
+            }
+            pipe_status += std::to_string(stage.status);
+            status = stage.status;
+            if (stage.status != 0)
+            {
+                failed_status = stage.status;
+            }
+            RedirectionPlan::waitRelays(stage.relays);
+        }
+        shell_->getVariableManager()->set("PIPESTATUS", pipe_status);
+
+        if (show_stats)
         {
-            // 设置重定向
-            std::unordered_map<int, int> saved_fds;
-            bool redirect_success = applyRedirections(command->getRedirections(), saved_fds);
-
-            if (!redirect_success)
+            for (size_t i = 0; i < count; ++i)
             {
-                return 1;
+                const PipelineStage &stage = stages[i];
+                std::cerr << "dash: pipeline: stage " << i + 1;
+                if (!stage.name.empty())
+                {
+                    std::cerr << " (" << stage.name << ")";
+                }
+                std::cerr << ": status " << stage.status << ", " << stage.usage.ru_nvcsw << " voluntary + "
+                          << stage.usage.ru_nivcsw << " involuntary context switches" << std::endl;
             }
-
-            // 执行内置命令
-            int status = executeBuiltin(cmd_name, args);
-
-            // 恢复重定向
-            restoreRedirections(saved_fds);
-
-            return status;
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                               std::chrono::steady_clock::now() - start_time)
+                               .count();
+            std::cerr << "dash: pipeline: " << count << " stages finished in " << elapsed << " us" << std::endl;
         }
 
-        // 检查是否后台运行 - 首先检查命令节点的background标志
-        bool background = command->isBackground();
-        
-        // 同时检查参数中是否有 &
-        if (!args.empty() && args.back() == "&") {
-            background = true;
-            args.pop_back(); // 移除 &
+        // pipefail：管道的状态是最后一个失败阶段的状态
+        if (shell_->getOptions()->getPipefail())
+        {
+            return failed_status;
         }
-        
-        // 执行外部命令
-        return executeExternalCommand(cmd_name, args, command->getRedirections(), background);
+        return status;
     }
 
-    int Executor::executePipe(const PipeNode *pipe_node)
+    size_t Executor::getPipeMaxSize()
     {
-        // 如果是后台运行，创建作业
-        if (pipe_node->isBackground())
+        if (pipe_max_size_ == 0)
         {
-            // 创建作业
-            // 这里需要实现作业控制
-            // 暂时简单实现，后续完善
-            pid_t pid = fork();
-
-            if (pid == -1)
-            {
-                throw ShellException(ExceptionType::SYSTEM, "Failed to fork process");
-            }
-            else if (pid == 0)
+            // 非特权进程能设置的上限；读取失败时使用内核默认值 1 MiB
+            pipe_max_size_ = 1024 * 1024;
+            int fd = open("/proc/sys/fs/pipe-max-size", O_RDONLY | O_CLOEXEC);
+            if (fd != -1)
             {
-                // 子进程
-                // 执行管道
-                if (pipe_node->getRight())
+                char buffer[32];
+                ssize_t n = read(fd, buffer, sizeof(buffer) - 1);
+                close(fd);
+                if (n > 0)
                 {
-                    // 创建管道
-                    int pipefd[2];
-                    if (::pipe(pipefd) == -1)
-                    {
-                        std::cerr << "Failed to create pipe" << std::endl;
-                        exit(1);
-                    }
-
-                    // 创建左侧命令的子进程
-                    pid_t left_pid = fork();
-
-                    if (left_pid == -1)
-                    {
-                        std::cerr << "Failed to fork process" << std::endl;
-                        exit(1);
-                    }
-                    else if (left_pid == 0)
-                    {
-                        // 左侧命令的子进程
-                        // 关闭读取端
-                        close(pipefd[0]);
-
-                        // 将标准输出重定向到管道写入端
-                        dup2(pipefd[1], STDOUT_FILENO);
-                        close(pipefd[1]);
-
-                        // 执行左侧命令
-                        exit(execute(pipe_node->getLeft()));
-                    }
-
-                    // 创建右侧命令的子进程
-                    pid_t right_pid = fork();
-
-                    if (right_pid == -1)
-                    {
-                        std::cerr << "Failed to fork process" << std::endl;
-                        exit(1);
-                    }
-                    else if (right_pid == 0)
+                    buffer[n] = '\0';
+                    long value = strtol(buffer, nullptr, 10);
+                    if (value > 0)
                     {
-                        // 右侧命令的子进程
-                        // 关闭写入端
-                        close(pipefd[1]);
-
-                        // 将标准输入重定向到管道读取端
-                        dup2(pipefd[0], STDIN_FILENO);
-                        close(pipefd[0]);
-
-                        // 执行右侧命令
-                        exit(execute(pipe_node->getRight()));
+                        pipe_max_size_ = value;
                     }
-
-                    // 父进程关闭管道的两端
-                    close(pipefd[0]);
-                    close(pipefd[1]);
-
-                    // 等待左侧命令完成
-                    int status;
-                    waitpid(left_pid, &status, 0);
-
-                    // 等待右侧命令完成
-                    waitpid(right_pid, &status, 0);
-
-                    exit(WEXITSTATUS(status));
-                }
-                else
-                {
-                    // 只有左侧命令
-                    exit(execute(pipe_node->getLeft()));
                 }
             }
-
-            // 父进程
-            std::cout << "[" << pid << "] " << "Background job started" << std::endl;
-            return 0;
         }
+        return pipe_max_size_;
+    }
 
-        // 前台运行
-        if (pipe_node->getRight())
+    void Executor::growLongRunningPipes(const std::vector<PipelineStage> &stages)
+    {
+#ifdef SYS_pidfd_open
+        // 等最后一个阶段一小段时间：短管道不受影响，也不占用更多的内核内存
+        pid_t last_pid = stages.back().result.pid;
+        if (last_pid <= 0)
         {
-            // 创建管道
-            int pipefd[2];
-            if (::pipe(pipefd) == -1)
-            {
-                throw ShellException(ExceptionType::SYSTEM, "Failed to create pipe");
-            }
-
-            // 创建左侧命令的子进程
-            pid_t left_pid = fork();
+            return;
+        }
+        int pidfd = static_cast<int>(syscall(SYS_pidfd_open, last_pid, 0));
+        if (pidfd == -1)
+        {
+            return;
+        }
+        struct pollfd pfd = {pidfd, POLLIN, 0};
+        int ready;
+        do
+        {
+            ready = poll(&pfd, 1, PIPE_AUTO_GROW_DELAY_MS);
+        } while (ready == -1 && errno == EINTR);
+        close(pidfd);
+        if (ready != 0)
+        {
+            return;
+        }
 
-            if (left_pid == -1)
-            {
-                throw ShellException(ExceptionType::SYSTEM, "Failed to fork process");
-            }
-            else if (left_pid == 0)
+        // 父进程已经关闭了管道，通过读端阶段的 /proc/PID/fd/0 重新打开。
+        // 标准输入被重定向到终端或设备的阶段不能打开（可能获得控制终端或触发设备的打开操作），
+        // 先 stat 确认是管道；已经结束的阶段 stat 失败，跳过即可
+        int size = static_cast<int>(getPipeMaxSize());
+        for (size_t i = 1; i < stages.size(); ++i)
+        {
+            if (stages[i].result.pid <= 0)
             {
-                // 左侧命令的子进程
-                // 关闭读取端
-                close(pipefd[0]);
-
-                // 将标准输出重定向到管道写入端
-                dup2(pipefd[1], STDOUT_FILENO);
-                close(pipefd[1]);
-
-                // 执行左侧命令
-                exit(execute(pipe_node->getLeft()));
+                continue;
             }
-
-            // 创建右侧命令的子进程
-            pid_t right_pid = fork();
-
-            if (right_pid == -1)
+            std::string path = "/proc/" + std::to_string(stages[i].result.pid) + "/fd/0";
+            struct stat st;
+            if (stat(path.c_str(), &st) == -1 || !S_ISFIFO(st.st_mode))
             {
-                throw ShellException(ExceptionType::SYSTEM, "Failed to fork process");
+                continue;
             }
-            else if (right_pid == 0)
+            int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_NOCTTY | O_CLOEXEC);
+            if (fd != -1)
             {
-                // 右侧命令的子进程
-                // 关闭写入端
-                close(pipefd[1]);
-
-                // 将标准输入重定向到管道读取端
-                dup2(pipefd[0], STDIN_FILENO);
-                close(pipefd[0]);
-
-                // 执行右侧命令
-                exit(execute(pipe_node->getRight()));
+                fcntl(fd, F_SETPIPE_SZ, size);
+                close(fd);
             }
+        }
+#else
+        (void)stages;
+#endif
+    }
 
-            // 父进程关闭管道的两端
-            close(pipefd[0]);
-            close(pipefd[1]);
-
-            // 等待左侧命令完成
-            int status;
-            waitpid(left_pid, &status, 0);
-
-            // 等待右侧命令完成
-            waitpid(right_pid, &status, 0);
-
-            return WEXITSTATUS(status);
+    SpawnBackend *Executor::selectParallelSpawnBackend(const SpawnPlan &plan) const
+    {
+        // zygote 只有一个连接，fork 不是线程安全的：工作线程中只用 vfork 或 posix_spawn
+        switch (getSpawnBackend())
+        {
+        case SpawnBackendType::VFORK:
+            return vfork_backend_.get();
+        case SpawnBackendType::POSIX_SPAWN:
+            return posix_spawn_backend_.get();
+        default:
+            break;
         }
-        else
+        for (const auto &action : plan.actions)
         {
-            // 只有左侧命令
-            return execute(pipe_node->getLeft());
+            if (action.kind == FileAction::OPEN)
+            {
+                return vfork_backend_.get();
+            }
         }
+        return posix_spawn_backend_.get();
     }
 
-    int Executor::executeList(const ListNode *list)
+    int Executor::executeList(const ListNode *list, int flags)
     {
         int status = 0;
 
@@ -327,8 +1424,8 @@ namespace dash
 
         for (size_t i = 0; i < commands.size(); ++i)
         {
-            // 执行当前命令
-            status = execute(commands[i].get());
+            // 执行当前命令，只有最后一条命令之后 shell 才无事可做
+            status = execute(commands[i].get(), i + 1 == commands.size() ? flags : EXEC_NONE);
 
             // 根据操作符决定是否继续执行
             if (i < operators.size())
@@ -349,7 +1446,7 @@ namespace dash
         return status;
     }
 
-    int Executor::executeIf(const IfNode *if_node)
+    int Executor::executeIf(const IfNode *if_node, int flags)
     {
         // 执行条件
         int condition_status = execute(if_node->getCondition());
@@ -357,12 +1454,12 @@ namespace dash
         // 如果条件为真（状态码为0），执行 then 部分
         if (condition_status == 0)
         {
-            return execute(if_node->getThenPart());
+            return execute(if_node->getThenPart(), flags);
         }
         else if (if_node->getElsePart())
         {
             // 否则，如果有 else 部分，执行 else 部分
-            return execute(if_node->getElsePart());
+            return execute(if_node->getElsePart(), flags);
         }
 
         return condition_status;
@@ -376,6 +1473,9 @@ namespace dash
         const std::string &var = for_node->getVar();
         const auto &words = for_node->getWords();
 
+        // 每次迭代都执行的重定向复用同一个描述符，循环结束时关闭
+        RedirectionCacheScope scope(redir_cache_);
+
         // 遍历单词列表
         for (const auto &word : words)
         {
@@ -396,6 +1496,9 @@ namespace dash
     {
         int status = 0;
 
+        // 每次迭代都执行的重定向复用同一个描述符，循环结束时关闭
+        RedirectionCacheScope scope(redir_cache_);
+
         while (true)
         {
             // 执行条件
@@ -430,7 +1533,7 @@ namespace dash
         return status;
     }
 
-    int Executor::executeCase(const CaseNode *case_node)
+    int Executor::executeCase(const CaseNode *case_node, int flags)
     {
         int status = 0;
 
@@ -459,7 +1562,7 @@ namespace dash
             if (matched)
             {
                 // 执行匹配项的命令
-                status = execute(item->commands.get());
+                status = execute(item->commands.get(), flags);
                 break;
             }
         }
@@ -470,7 +1573,7 @@ namespace dash
     int Executor::executeSubshell(const SubshellNode *subshell)
     {
         // 创建子进程
-        pid_t pid = fork();
+        pid_t pid = forkProcess();
 
         if (pid == -1)
         {
@@ -480,21 +1583,31 @@ namespace dash
         {
             // 子进程
 
-            // 设置重定向
-            std::unordered_map<int, int> saved_fds;
-            bool redirect_success = applyRedirections(subshell->getRedirections(), saved_fds);
+            // 设置重定向，子进程不会再恢复
+            std::vector<pid_t> relays;
+            bool redirect_success = applyRedirections(subshell->getRedirectionPlan(), RedirectionPlan::Mode::CHILD,
+                                                      nullptr, relays);
 
             if (!redirect_success)
             {
                 exit(1);
             }
 
-            // 执行命令
-            int status = execute(subshell->getCommands());
-
-            // 恢复重定向
-            restoreRedirections(saved_fds);
+            if (relays.empty())
+            {
+                // 执行命令，子 shell 的最后一条外部命令直接 exec
+                executeAndExit(subshell->getCommands());
+            }
 
+            // 有多目标输出中继时不能 exec：关闭中继管道的写端，等中继写完再退出
+            int status = execute(subshell->getCommands());
+            std::cout.flush();
+            std::cerr.flush();
+            for (int fd = 0; fd < RedirectionPlan::MAX_FD; ++fd)
+            {
+                close(fd);
+            }
+            RedirectionPlan::waitRelays(relays);
             exit(status);
         }
 
@@ -505,186 +1618,337 @@ namespace dash
         return WEXITSTATUS(status);
     }
 
-    bool Executor::applyRedirections(const std::vector<Redirection> &redirections, std::unordered_map<int, int> &saved_fds)
+    bool Executor::applyRedirections(const RedirectionPlan &plan, RedirectionPlan::Mode mode,
+                                     RedirectionPlan::SavedFds *saved, std::vector<pid_t> &relays)
     {
-        for (const auto &redir : redirections)
+        if (plan.empty())
+        {
+            return true;
+        }
+        RedirectionContext context = getRedirectionContext(relays);
+        if (mode == RedirectionPlan::Mode::PERSIST)
         {
-            int fd = redir.fd;
-            std::string filename = redir.filename;
-            
-            // 对文件名进行变量展开
-            filename = shell_->getVariableManager()->expand(filename);
+            // 缓存的描述符复用时会被截断、回到文件开头，exec 打开的文件不能和它共享文件偏移
+            context.cache = nullptr;
+        }
+        return plan.apply(context, mode, saved);
+    }
+
+    RedirectionContext Executor::getRedirectionContext(std::vector<pid_t> &relays)
+    {
+        ShellOptions *options = shell_->getOptions();
+        return RedirectionContext{shell_->getVariableManager(), getDevNull(), redir_cache_,
+                                  options->getMultios() ? &relays : nullptr, options->getIoUring()};
+    }
 
-            // 保存原始文件描述符
-            int saved_fd = dup(fd);
-            if (saved_fd == -1)
+    int Executor::getDevNull()
+    {
+        if (dev_null_fd_ == -1)
+        {
+            int fd = open("/dev/null", O_RDWR | O_CLOEXEC);
+            if (fd != -1)
             {
-                // 恢复已保存的文件描述符
-                restoreRedirections(saved_fds);
-                return false;
+                dev_null_fd_ = fcntl(fd, F_DUPFD_CLOEXEC, RedirectionPlan::MAX_FD);
+                close(fd);
             }
-            saved_fds[fd] = saved_fd;
+        }
+        return dev_null_fd_;
+    }
 
-            // 应用重定向
-            switch (redir.type)
-            {
-            case RedirType::REDIR_INPUT:
-                // 输入重定向
-                {
-                    int new_fd = open(filename.c_str(), O_RDONLY);
-                    if (new_fd == -1)
-                    {
-                        std::cerr << "dash: " << filename << ": " << strerror(errno) << std::endl;
-                        restoreRedirections(saved_fds);
-                        return false;
-                    }
-                    dup2(new_fd, fd);
-                    close(new_fd);
-                }
-                break;
+    void Executor::exec_in_child(const std::string &command, const std::vector<std::string> &args) {
+        std::string fullname = findCommand(command);
+        if (fullname.empty()) {
+            std::cerr << "dash: " << command << ": not found" << std::endl;
+            _exit(127);
+        }
 
-            case RedirType::REDIR_OUTPUT:
-                // 输出重定向
-                {
-                    int new_fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
-                    if (new_fd == -1)
-                    {
-                        std::cerr << "dash: " << filename << ": " << strerror(errno) << std::endl;
-                        restoreRedirections(saved_fds);
-                        return false;
-                    }
-                    dup2(new_fd, fd);
-                    close(new_fd);
-                }
-                break;
+        SpawnPlan plan;
+        plan.command = fullname;
+        plan.args = args;
+        plan.script_handler = [this](const SpawnPlan &script)
+        {
+            shell_->runScriptInChild(script.command, script.args);
+        };
 
-            case RedirType::REDIR_APPEND:
-                // 追加重定向
-                {
-                    int new_fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0666);
-                    if (new_fd == -1)
-                    {
-                        std::cerr << "dash: " << filename << ": " << strerror(errno) << std::endl;
-                        restoreRedirections(saved_fds);
-                        return false;
-                    }
-                    dup2(new_fd, fd);
-                    close(new_fd);
-                }
-                break;
+        std::cout.flush();
+        // 如果 execInPlace 返回，则表示执行失败
+        _exit(reportSpawnError(plan, execInPlace(plan)));
+    }
+
+    bool Executor::startZygote()
+    {
+        return zygote_backend_->start();
+    }
+
+    SpawnBackend *Executor::selectSpawnBackend(const SpawnPlan &plan)
+    {
+        // 子进程需要运行 shell 代码时，只有完整的 fork 是安全的
+        if (plan.needs_shell)
+        {
+            return fork_backend_.get();
+        }
 
-            case RedirType::REDIR_INPUT_DUP:
+        switch (getSpawnBackend())
+        {
+        case SpawnBackendType::FORK:
+            // 常驻内存过大时 fork 复制页表的开销太高，改用不复制页表的后端
+            if (!fork_monitor_->exceeds(shell_->getOptions()->getForkThreshold()))
             {
-                // 输入复制重定向 <&
-                int target_fd;
-                if (filename == "-")
-                {
-                    // 关闭文件描述符
-                    close(fd);
-                }
-                else
-                {
-                    // 复制文件描述符
-                    target_fd = std::stoi(filename);
-                    dup2(target_fd, fd);
-                }
-                break;
+                return fork_backend_.get();
             }
-
-            case RedirType::REDIR_OUTPUT_DUP:
+            fork_monitor_->recordAvoided();
+            break;
+        case SpawnBackendType::VFORK:
+            return vfork_backend_.get();
+        case SpawnBackendType::POSIX_SPAWN:
+            return posix_spawn_backend_.get();
+        case SpawnBackendType::ZYGOTE:
+            return zygote_backend_.get();
+        case SpawnBackendType::AUTO:
+            // 辅助进程在当前进程可用时，由它创建子进程
+            if (zygote_backend_->isUsable())
             {
-                // 输出复制重定向 >&
-                int target_fd;
-                if (filename == "-")
-                {
-                    // 关闭文件描述符
-                    close(fd);
-                }
-                else
-                {
-                    // 复制文件描述符
-                    target_fd = std::stoi(filename);
-                    dup2(target_fd, fd);
-                }
-                break;
+                return zygote_backend_.get();
             }
+            break;
+        }
 
-            case RedirType::REDIR_HEREDOC:
+        // posix_spawn 无法区分是打开文件失败还是 exec 失败，
+        // 有打开文件的操作时使用 vfork 后端以便准确报告错误
+        for (const auto &action : plan.actions)
+        {
+            if (action.kind == FileAction::OPEN)
             {
-                // Here 文档 <<
-                // 暂时简单实现，后续完善
-                break;
-            }
+                return vfork_backend_.get();
             }
         }
+        return posix_spawn_backend_.get();
+    }
 
-        return true;
+    void Executor::setSpawnBackend(SpawnBackendType type)
+    {
+        shell_->getOptions()->setSpawnBackend(type);
     }
 
-    void Executor::restoreRedirections(std::unordered_map<int, int> &saved_fds)
+    SpawnBackendType Executor::getSpawnBackend() const
     {
-        for (const auto &pair : saved_fds)
+        return shell_->getOptions()->getSpawnBackend();
+    }
+
+    SpawnResult Executor::spawnWith(SpawnBackend *backend, const SpawnPlan &plan)
+    {
+        if (backend != fork_backend_.get())
         {
-            dup2(pair.second, pair.first);
-            close(pair.second);
+            return backend->spawn(plan);
         }
 
-        saved_fds.clear();
+        sampleBeforeFork();
+        auto start_time = std::chrono::steady_clock::now();
+        SpawnResult result = backend->spawn(plan);
+        recordFork(std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::steady_clock::now() - start_time)
+                       .count());
+        return result;
     }
 
-    void Executor::exec_in_child(const std::string &command, const std::vector<std::string> &args) {
-        std::vector<char *> c_args;
-        c_args.reserve(args.size() + 1);
-        for (const auto &arg : args) {
-            c_args.push_back(const_cast<char *>(arg.c_str()));
+    pid_t Executor::forkProcess()
+    {
+        sampleBeforeFork();
+        auto start_time = std::chrono::steady_clock::now();
+        pid_t pid = fork();
+        if (pid != 0)
+        {
+            recordFork(std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::steady_clock::now() - start_time)
+                           .count());
         }
-        c_args.push_back(nullptr);
+        return pid;
+    }
 
-        execvp(command.c_str(), c_args.data());
-        // 如果 execvp 返回，则表示执行失败
-        std::cerr << "Failed to execute command: " << command << std::endl;
-        exit(1);
+    void Executor::sampleBeforeFork()
+    {
+        if (shell_->getOptions()->getForkStats() && !fork_monitor_->hasSample())
+        {
+            fork_monitor_->sample();
+        }
     }
 
-    int Executor::executeExternalCommand(const std::string &command, const std::vector<std::string> &args,
-                                         const std::vector<Redirection> &redirections, bool background)
+    void Executor::recordFork(long elapsed_us)
     {
-        // 获取Shell实例和后台任务适配器
-        Shell* shell = getShell();
-        if (background && shell) {
-            // 使用后台任务适配器来执行后台任务
-            std::vector<std::string> bg_args = args;
-            bg_args.insert(bg_args.begin(), command); // 添加命令名作为第一个参数
-            return shell->executeBackground(command, bg_args);
+        fork_monitor_->recordFork(elapsed_us);
+        if (!shell_->getOptions()->getForkStats())
+        {
+            return;
         }
 
-        // 创建子进程
-        pid_t pid = fork();
+        const MemoryUsage &usage = fork_monitor_->getLastSample();
+        std::cerr << "dash: fork #" << fork_monitor_->getForkCount() << ": rss=" << usage.rss_kb
+                  << " kB pte=" << usage.pte_kb << " kB, " << elapsed_us << " us (max "
+                  << fork_monitor_->getMaxTime() << " us, avg "
+                  << fork_monitor_->getTotalTime() / static_cast<long>(fork_monitor_->getForkCount())
+                  << " us, " << fork_monitor_->getAvoidedCount() << " avoided)" << std::endl;
+    }
 
-        if (pid == -1)
+    SpawnResult Executor::retrySpawn(const std::string &command, SpawnPlan &plan, SpawnResult result)
+    {
+        if (result.pid == -1 && result.failed_action == -1 && result.error == ENOENT &&
+            command.find('/') == std::string::npos)
         {
-            throw ShellException(ExceptionType::SYSTEM, "Failed to fork process");
+            // 缓存的路径已失效（命令被移动或删除），重新查找一次
+            command_table_->remove(command);
+            std::string fullname = findCommand(command, false);
+            if (!fullname.empty())
+            {
+                plan.command = fullname;
+                result = spawnWith(selectSpawnBackend(plan), plan);
+            }
         }
-        else if (pid == 0)
+        if (result.pid == -1 && result.failed_action == -1 && result.error == ENOEXEC)
         {
-            // 子进程
-            // 设置重定向
-            std::unordered_map<int, int> saved_fds;
-            bool redirect_success = applyRedirections(redirections, saved_fds);
+            // 不能在子进程中运行 shell 代码的后端只会报告 ENOEXEC，改用 fork 解释脚本。
+            // 子进程会继续使用输出缓冲区，先清空以免重复输出
+            std::cout.flush();
+            std::cerr.flush();
+            result = spawnWith(fork_backend_.get(), plan);
+        }
+        return result;
+    }
 
-            if (!redirect_success)
+    int Executor::reportSpawnError(const SpawnPlan &plan, const SpawnResult &result) const
+    {
+        if (result.failed_action >= 0 && result.failed_action < static_cast<int>(plan.actions.size()))
+        {
+            const FileAction &action = plan.actions[result.failed_action];
+            if (action.kind == FileAction::OPEN)
             {
-                exit(1);
+                std::cerr << "dash: " << action.path << ": " << strerror(result.error) << std::endl;
+            }
+            else
+            {
+                std::cerr << "dash: " << action.source_fd << ": " << strerror(result.error) << std::endl;
             }
+            return 1;
+        }
 
-            exec_in_child(command, args);
+        const std::string &name = plan.args.empty() ? plan.command : plan.args[0];
+        if (result.error == ENOENT)
+        {
+            std::cerr << "dash: " << name << ": not found" << std::endl;
+            return 127;
         }
 
-        // 父进程
-        int status;
-        waitpid(pid, &status, 0);
+        std::cerr << "dash: " << name << ": " << strerror(result.error) << std::endl;
+        return 126;
+    }
 
-        return WEXITSTATUS(status);
+    int Executor::waitForChild(pid_t pid, struct rusage *usage) const
+    {
+        int status = 0;
+        while (wait4(pid, &status, 0, usage) == -1)
+        {
+            if (errno != EINTR)
+            {
+                return 1;
+            }
+        }
+
+        if (WIFEXITED(status))
+        {
+            return WEXITSTATUS(status);
+        }
+        if (WIFSIGNALED(status))
+        {
+            return 128 + WTERMSIG(status);
+        }
+        return 1;
+    }
+
+    int Executor::executeExternalCommand(const std::string &command, const std::vector<std::string> &args,
+                                         const RedirectionPlan &redirections, int flags,
+                                         const std::vector<int> &inherited_fds)
+    {
+        // 通过命令哈希表定位命令，找不到时无需创建子进程
+        std::string fullname = findCommand(command);
+        if (fullname.empty())
+        {
+            std::cerr << "dash: " << command << ": not found" << std::endl;
+            return 127;
+        }
+
+        SpawnPlan plan;
+        plan.command = fullname;
+        plan.args = args;
+        // 在父进程中展开重定向文件名、准备 Here 文档，子进程只执行系统调用
+        // 进程替换的管道带 close-on-exec，复制到自身以传给命令
+        for (int fd : inherited_fds)
+        {
+            plan.actions.emplace_back(FileAction::DUP2, fd, fd);
+        }
+        std::vector<int> opened_fds;
+        std::vector<pid_t> relays;
+        if (!redirections.buildFileActions(getRedirectionContext(relays), plan.actions, opened_fds))
+        {
+            RedirectionPlan::waitRelays(relays);
+            return 1;
+        }
+        plan.script_handler = [this](const SpawnPlan &script)
+        {
+            // 没有 #! 的脚本：由已经 fork 出的子进程直接解释，不再 exec 一个 shell
+            shell_->runScriptInChild(script.command, script.args);
+        };
+
+        if ((flags & EXEC_TAIL) && relays.empty())
+        {
+            // 之后没有需要 shell 做的事情：直接在当前进程 exec，省去 fork 和 wait。
+            // 有多目标输出中继时还要等中继写完，不走这里。
+            // 辅助进程是本进程的子进程，先回收，避免留给 exec 后的程序
+            zygote_backend_->stop();
+            std::cout.flush();
+            std::cerr.flush();
+            int status = reportSpawnError(plan, execInPlace(plan));
+            closeFds(opened_fds);
+            return status;
+        }
+
+        SpawnResult result = retrySpawn(command, plan, spawnWith(selectSpawnBackend(plan), plan));
+        closeFds(opened_fds);
+        int status = result.pid == -1 ? reportSpawnError(plan, result) : waitForChild(result.pid);
+        RedirectionPlan::waitRelays(relays);
+        return status;
+    }
+
+    int Executor::replaceShell(const std::vector<std::string> &args)
+    {
+        std::string fullname = findCommand(args[0]);
+        if (fullname.empty())
+        {
+            std::cerr << "dash: exec: " << args[0] << ": not found" << std::endl;
+            return 127;
+        }
+
+        SpawnPlan plan;
+        plan.command = fullname;
+        plan.args = args;
+        plan.script_handler = [this](const SpawnPlan &script)
+        {
+            shell_->runScriptInChild(script.command, script.args);
+        };
+
+        zygote_backend_->stop();
+        std::cout.flush();
+        std::cerr.flush();
+        return reportSpawnError(plan, execInPlace(plan));
+    }
+
+    std::string Executor::findCommand(const std::string &command, bool count_hit)
+    {
+        if (command.find('/') != std::string::npos)
+        {
+            return command;
+        }
+
+        VariableManager *vars = shell_->getVariableManager();
+        return command_table_->lookup(command, vars->get("PATH"), vars->getPathGeneration(), count_hit).path;
     }
 
     bool Executor::isBuiltin(const std::string &command) const
@@ -713,6 +1977,11 @@ namespace dash
         auto jobs_cmd = std::make_shared<JobsCommand>(shell_);
         auto fg_cmd = std::make_shared<FgCommand>(shell_);
         auto bg_cmd = std::make_shared<BgCommand>(shell_);
+        auto hash_cmd = std::make_shared<HashCommand>(shell_);
+        auto set_cmd = std::make_shared<SetCommand>(shell_);
+        auto cat_cmd = std::make_shared<CatCommand>(shell_);
+        auto read_cmd = std::make_shared<ReadCommand>(shell_);
+        auto exec_cmd = std::make_shared<ExecCommand>(shell_);
 
         // 保存内置命令对象
         builtin_commands_.push_back(cd_cmd);
@@ -722,6 +1991,11 @@ namespace dash
         builtin_commands_.push_back(jobs_cmd);
         builtin_commands_.push_back(fg_cmd);
         builtin_commands_.push_back(bg_cmd);
+        builtin_commands_.push_back(hash_cmd);
+        builtin_commands_.push_back(set_cmd);
+        builtin_commands_.push_back(cat_cmd);
+        builtin_commands_.push_back(read_cmd);
+        builtin_commands_.push_back(exec_cmd);
 
         // 注册内置命令
         builtins_[cd_cmd->getName()] = [cd_cmd](const std::vector<std::string> &args) -> int
@@ -759,6 +2033,31 @@ namespace dash
             return bg_cmd->execute(args);
         };
 
+        builtins_[hash_cmd->getName()] = [hash_cmd](const std::vector<std::string> &args) -> int
+        {
+            return hash_cmd->execute(args);
+        };
+
+        builtins_[set_cmd->getName()] = [set_cmd](const std::vector<std::string> &args) -> int
+        {
+            return set_cmd->execute(args);
+        };
+
+        builtins_[cat_cmd->getName()] = [cat_cmd](const std::vector<std::string> &args) -> int
+        {
+            return cat_cmd->execute(args);
+        };
+
+        builtins_[read_cmd->getName()] = [read_cmd](const std::vector<std::string> &args) -> int
+        {
+            return read_cmd->execute(args);
+        };
+
+        builtins_[exec_cmd->getName()] = [exec_cmd](const std::vector<std::string> &args) -> int
+        {
+            return exec_cmd->execute(args);
+        };
+
         // TODO: 添加更多内置命令
     }
 
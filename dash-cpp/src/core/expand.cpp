@@ -6,7 +6,6 @@
 #include "../../include/core/expand.h"
 #include "../../include/core/shell.h"
 #include "../../include/variable/variable_manager.h"
-#include "../../include/core/arithmetic.h"
 #include <glob.h>
 #include <pwd.h>
 #include <unistd.h>
@@ -65,6 +64,132 @@ ExpandResult Expand::expandWord(const std::string& word) {
     return result;
 }
 
+void Expand::expandSegments(const std::string& word, const std::vector<WordSegment>& segments,
+                            std::vector<std::string>& fields) {
+    VariableManager* vars = shell_.getVariableManager();
+    std::string ifs = vars->exists("IFS") ? vars->get("IFS") : " \t\n";
+
+    // 有不加引号的元字符或展开时才需要拼出匹配路径名用的模式
+    bool may_glob = false;
+    for (const auto& segment : segments) {
+        if (segment.kind == WordSegment::GLOB ||
+            ((segment.kind == WordSegment::PARAM || segment.kind == WordSegment::COMMAND) && !segment.quoted)) {
+            may_glob = true;
+            break;
+        }
+    }
+
+    std::string text;       // 当前字段
+    std::string pattern;    // 当前字段的路径名模式，引号中的元字符已转义
+    bool started = false;   // 当前字段已经存在：有字符，或者有引号
+    bool wildcard = false;  // 当前字段中有不加引号的 * 或 ?
+    bool bracket = false;   // 当前字段中有不加引号的 [
+    int delimiter = 0;      // 分词时所在的分隔符：0 不在分隔符中，1 只有空白，2 已有非空白字符
+
+    auto finish = [&]() {
+        glob_t matches = {};
+        if ((wildcard || (bracket && text.find(']') != std::string::npos)) &&
+            glob(pattern.c_str(), 0, nullptr, &matches) == 0) {
+            for (size_t i = 0; i < matches.gl_pathc; ++i) {
+                fields.push_back(matches.gl_pathv[i]);
+            }
+        } else {
+            fields.push_back(std::move(text));
+        }
+        globfree(&matches);
+        text.clear();
+        pattern.clear();
+        started = wildcard = bracket = false;
+    };
+
+    // 引号中的字符和不再分词的展开结果
+    auto appendQuoted = [&](std::string_view part) {
+        text += part;
+        if (may_glob) {
+            for (char c : part) {
+                if (c == '*' || c == '?' || c == '[' || c == '\\') {
+                    pattern += '\\';
+                }
+                pattern += c;
+            }
+        }
+        started = true;
+        delimiter = 0;
+    };
+
+    // 不加引号的展开结果：按 IFS 分词，其中的元字符参与路径名匹配
+    auto appendSplit = [&](const std::string& value) {
+        for (char c : value) {
+            if (ifs.find(c) == std::string::npos) {
+                text += c;
+                pattern += c;
+                wildcard = wildcard || c == '*' || c == '?';
+                bracket = bracket || c == '[';
+                started = true;
+                delimiter = 0;
+            } else if (c == ' ' || c == '\t' || c == '\n') {
+                if (started) {
+                    finish();
+                    delimiter = 1;
+                }
+            } else if (started) {
+                finish();
+                delimiter = 2;
+            } else if (delimiter == 1) {
+                // 与前面的空白是同一个分隔符
+                delimiter = 2;
+            } else {
+                // 连续的非空白分隔符之间是空字段
+                fields.emplace_back();
+                delimiter = 2;
+            }
+        }
+    };
+
+    std::string_view source(word);
+    for (const auto& segment : segments) {
+        std::string_view part = source.substr(segment.offset, segment.length);
+        switch (segment.kind) {
+        case WordSegment::LITERAL:
+        case WordSegment::SINGLE_QUOTED:
+        case WordSegment::DOUBLE_QUOTED:
+        case WordSegment::ARITH:
+            // 算术展开还没有实现，保留原文
+            appendQuoted(part);
+            break;
+        case WordSegment::GLOB:
+            text += part;
+            pattern += part;
+            for (char c : part) {
+                if (c == '[') {
+                    bracket = true;
+                } else {
+                    wildcard = true;
+                }
+            }
+            started = true;
+            delimiter = 0;
+            break;
+        case WordSegment::TILDE:
+            appendQuoted(expandTilde(std::string(part)));
+            break;
+        case WordSegment::PARAM:
+        case WordSegment::COMMAND: {
+            std::string value = vars->expand(std::string(part));
+            if (segment.quoted) {
+                appendQuoted(value);
+            } else {
+                appendSplit(value);
+            }
+            break;
+        }
+        }
+    }
+    if (started) {
+        finish();
+    }
+}
+
 std::vector<std::string> Expand::expandPathname(const std::string& pattern) {
     std::vector<std::string> result;
     
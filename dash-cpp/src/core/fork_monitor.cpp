@@ -0,0 +1,117 @@
+/**
+ * @file fork_monitor.cpp
+ * @brief fork 开销监控实现
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include "core/fork_monitor.h"
+
+namespace dash
+{
+
+    namespace
+    {
+        /**
+         * @brief 在 /proc/self/status 的内容中查找一个以 kB 为单位的字段
+         *
+         * @param text 文件内容
+         * @param field 字段名（含冒号）
+         * @return long 字段值，找不到时为 -1
+         */
+        long findField(const char *text, const char *field)
+        {
+            size_t length = strlen(field);
+            for (const char *line = text; line && *line;)
+            {
+                if (strncmp(line, field, length) == 0)
+                {
+                    return strtol(line + length, nullptr, 10);
+                }
+                line = strchr(line, '\n');
+                if (line)
+                {
+                    ++line;
+                }
+            }
+            return -1;
+        }
+    }
+
+    ForkMonitor::ForkMonitor()
+        : peak_rss_kb_(0),
+          peak_pte_kb_(0),
+          forks_(0),
+          avoided_(0),
+          total_us_(0),
+          max_us_(0),
+          sampled_(false)
+    {
+    }
+
+    MemoryUsage ForkMonitor::readMemoryUsage()
+    {
+        MemoryUsage usage;
+
+        // 每次 fork 前都会调用：直接用系统调用读取，不经过 iostream
+        int fd = open("/proc/self/status", O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            return usage;
+        }
+
+        char buffer[4096];
+        size_t total = 0;
+        ssize_t n;
+        while (total < sizeof(buffer) - 1 &&
+               (n = read(fd, buffer + total, sizeof(buffer) - 1 - total)) > 0)
+        {
+            total += n;
+        }
+        close(fd);
+        buffer[total] = '\0';
+
+        usage.rss_kb = findField(buffer, "VmRSS:");
+        usage.pte_kb = findField(buffer, "VmPTE:");
+        return usage;
+    }
+
+    const MemoryUsage &ForkMonitor::sample()
+    {
+        last_ = readMemoryUsage();
+        sampled_ = true;
+        if (last_.rss_kb > peak_rss_kb_)
+        {
+            peak_rss_kb_ = last_.rss_kb;
+        }
+        if (last_.pte_kb > peak_pte_kb_)
+        {
+            peak_pte_kb_ = last_.pte_kb;
+        }
+        return last_;
+    }
+
+    bool ForkMonitor::exceeds(size_t threshold_kb)
+    {
+        if (threshold_kb == 0)
+        {
+            return false;
+        }
+        const MemoryUsage &usage = sample();
+        return usage.rss_kb >= 0 && static_cast<size_t>(usage.rss_kb) >= threshold_kb;
+    }
+
+    void ForkMonitor::recordFork(long elapsed_us)
+    {
+        ++forks_;
+        sampled_ = false;
+        total_us_ += elapsed_us;
+        if (elapsed_us > max_us_)
+        {
+            max_us_ = elapsed_us;
+        }
+    }
+
+} // namespace dash
@@ -7,9 +7,14 @@
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
 #include "core/input.h"
 #include "core/shell.h"
+#include "core/redirection.h"
 #include "utils/error.h"
+#include "variable/variable_manager.h"
 
 namespace dash
 {
@@ -17,36 +22,67 @@ namespace dash
     // FileInputSource 实现
 
     FileInputSource::FileInputSource(const std::string &filename)
-        : filename_(filename)
+        : fd_(-1), pos_(0), eof_(false), filename_(filename)
     {
-        file_.open(filename);
-        if (!file_.is_open())
+        int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
         {
             throw ShellException(ExceptionType::IO, "Cannot open file: " + filename);
         }
+        fd_ = fcntl(fd, F_DUPFD_CLOEXEC, RedirectionPlan::MAX_FD);
+        if (fd_ == -1)
+        {
+            fd_ = fd;
+        }
+        else
+        {
+            close(fd);
+        }
     }
 
     FileInputSource::~FileInputSource()
     {
-        if (file_.is_open())
-        {
-            file_.close();
-        }
+        close(fd_);
     }
 
     std::string FileInputSource::readLine()
     {
-        std::string line;
-        if (std::getline(file_, line))
+        while (true)
         {
-            return line;
+            size_t end = buffer_.find('\n', pos_);
+            if (end != std::string::npos)
+            {
+                std::string line = buffer_.substr(pos_, end - pos_);
+                pos_ = end + 1;
+                return line;
+            }
+            if (eof_)
+            {
+                // 最后一行没有换行符
+                std::string line = buffer_.substr(pos_);
+                buffer_.clear();
+                pos_ = 0;
+                return line;
+            }
+
+            buffer_.erase(0, pos_);
+            pos_ = 0;
+            char chunk[4096];
+            ssize_t n = read(fd_, chunk, sizeof(chunk));
+            if (n > 0)
+            {
+                buffer_.append(chunk, static_cast<size_t>(n));
+            }
+            else if (n == 0 || errno != EINTR)
+            {
+                eof_ = true;
+            }
         }
-        return "";
     }
 
     bool FileInputSource::isEOF() const
     {
-        return file_.eof() || !file_.good();
+        return eof_ && pos_ >= buffer_.size();
     }
 
     std::string FileInputSource::getName() const
@@ -177,6 +213,16 @@ namespace dash
         return input_stack_.top()->readLine();
     }
 
+    bool InputHandler::readContinuationLine(std::string &line)
+    {
+        if (shell_->isInteractive() && getCurrentSourceName() == "stdin")
+        {
+            std::cout << shell_->getVariableManager()->get("PS2") << std::flush;
+        }
+        line = readLine(false);
+        return !line.empty() || !isEOF();
+    }
+
     bool InputHandler::pushFile(const std::string &filename, int flags)
     {
         try
@@ -237,6 +283,14 @@ namespace dash
         return true;
     }
 
+    void InputHandler::reset()
+    {
+        while (!input_stack_.empty())
+        {
+            input_stack_.pop();
+        }
+    }
+
     bool InputHandler::isEOF() const
     {
         return input_stack_.empty() || input_stack_.top()->isEOF();
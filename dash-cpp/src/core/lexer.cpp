@@ -6,20 +6,234 @@
 #include <iostream>
 #include <sstream>
 #include <cctype>
+#include <algorithm>
+#include <cstring>
 #include "core/lexer.h"
+#include "core/char_class.h"
 #include "core/shell.h"
+#include "core/options.h"
+#include "core/redirection.h"
 #include "utils/error.h"
 
 namespace dash
 {
 
+    namespace
+    {
+        /**
+         * @brief 正在解析的单词的值
+         *
+         * 与输入原文相同时只记录结束位置，值就是输入缓冲区中的一段；遇到不属于值的
+         * 字符（引号）时才把已有的部分复制出来，之后逐个追加字符。
+         */
+        class WordText
+        {
+        private:
+            const std::string &input_;
+            size_t start_;
+            size_t end_;
+            std::string text_;
+            bool owned_;
+
+        public:
+            WordText(const std::string &input, size_t start)
+                : input_(input), start_(start), end_(start), owned_(false)
+            {
+            }
+
+            /**
+             * @brief 追加当前位置的字符，调用后词法分析器前进一个字符
+             */
+            void append(char c)
+            {
+                if (owned_)
+                {
+                    text_ += c;
+                }
+                else
+                {
+                    ++end_;
+                }
+            }
+
+            /**
+             * @brief 追加从当前位置开始的一段输入，调用后词法分析器前进到这一段之后
+             */
+            void append(std::string_view chunk)
+            {
+                if (owned_)
+                {
+                    text_ += chunk;
+                }
+                else
+                {
+                    end_ += chunk.size();
+                }
+            }
+
+            /**
+             * @brief 当前位置的字符不属于值：此后的值与原文不再连续，改为自己保存
+             */
+            void skip()
+            {
+                if (!owned_)
+                {
+                    text_.assign(input_, start_, end_ - start_);
+                    owned_ = true;
+                }
+            }
+
+            bool empty() const { return owned_ ? text_.empty() : end_ == start_; }
+            size_t size() const { return owned_ ? text_.size() : end_ - start_; }
+            bool owned() const { return owned_; }
+            std::string_view view() const { return owned_ ? std::string_view(text_) : std::string_view(input_).substr(start_, end_ - start_); }
+            std::string take() { return std::move(text_); }
+        };
+
+        /**
+         * @brief 正在解析的单词的分段
+         *
+         * 只记录当前一段的类型和起点，类型改变时才把上一段放入列表。单词中没有展开、
+         * 通配符和转义时展开不会改变它的值，不交出分段。
+         */
+        class SegmentList
+        {
+        private:
+            std::vector<WordSegment> segments_;
+            WordSegment current_;
+            bool literal_; // 到目前为止的值就是展开结果
+
+            void close(size_t end)
+            {
+                current_.length = end - current_.offset;
+                // 空的引号也要保留：它让展开为空的单词仍然是一个参数
+                if (current_.length > 0 || current_.kind == WordSegment::SINGLE_QUOTED ||
+                    current_.kind == WordSegment::DOUBLE_QUOTED)
+                {
+                    segments_.push_back(current_);
+                }
+            }
+
+        public:
+            SegmentList()
+                : current_{WordSegment::LITERAL, false, 0, 0}, literal_(true)
+            {
+            }
+
+            /**
+             * @brief 值中从 offset 开始的字符属于 kind 类型的一段
+             *
+             * 与当前一段类型相同时接在它后面；展开和通配符总是单独成段。
+             */
+            void mark(WordSegment::Kind kind, bool quoted, size_t offset)
+            {
+                bool expansion = kind >= WordSegment::PARAM;
+                if (!expansion && kind == current_.kind && quoted == current_.quoted)
+                {
+                    return;
+                }
+                close(offset);
+                current_ = {kind, quoted, offset, 0};
+                literal_ = literal_ && !expansion;
+            }
+
+            /**
+             * @brief 值中 offset 处的反斜杠不属于任何一段
+             */
+            void skip(size_t offset)
+            {
+                close(offset);
+                current_.offset = offset + 1;
+                literal_ = false;
+            }
+
+            /**
+             * @brief 单词结束，交出分段
+             *
+             * @param size 值的长度
+             * @return std::vector<WordSegment> 分段列表，纯字面量时为空
+             */
+            std::vector<WordSegment> take(size_t size)
+            {
+                if (literal_)
+                {
+                    return {};
+                }
+                close(size);
+                return std::move(segments_);
+            }
+        };
+
+        /**
+         * @brief 查找从 pos 处的 $ 开始的参数展开的结尾
+         *
+         * @param input 输入
+         * @param pos $ 的位置
+         * @return size_t 参数展开之后的位置，$ 后面不是参数时为 pos + 1
+         */
+        size_t paramEnd(const std::string &input, size_t pos)
+        {
+            size_t end = pos + 1;
+            char c = end < input.size() ? input[end] : '\0';
+            if (c == '{')
+            {
+                size_t close = input.find('}', end);
+                return close == std::string::npos ? end : close + 1;
+            }
+            if (std::isalpha(static_cast<unsigned char>(c)) || c == '_')
+            {
+                while (end < input.size() && (std::isalnum(static_cast<unsigned char>(input[end])) || input[end] == '_'))
+                {
+                    ++end;
+                }
+                return end;
+            }
+            if (std::isdigit(static_cast<unsigned char>(c)) || (c != '\0' && std::strchr("?$!#@*-", c)))
+            {
+                return end + 1;
+            }
+            return end;
+        }
+    }
+
     // Token 实现
 
-    Token::Token(TokenType type, const std::string &value, int line_number, int column)
-        : type_(type), value_(value), line_number_(line_number), column_(column)
+    Token::Token()
+        : type_(TokenType::END_OF_INPUT), owned_(false), line_number_(0), column_(0), quoted_(false)
+    {
+    }
+
+    Token::Token(TokenType type, std::string_view value, int line_number, int column)
+        : type_(type), view_(value), owned_(false), line_number_(line_number), column_(column), quoted_(false)
     {
     }
 
+    void Token::setText(std::string text)
+    {
+        text_ = std::move(text);
+        view_ = std::string_view();
+        owned_ = true;
+    }
+
+    void Token::materialize()
+    {
+        if (!owned_)
+        {
+            setText(std::string(view_));
+        }
+    }
+
+    void Token::rebase(std::string_view from, std::string_view to)
+    {
+        // 换行符等指向字面量的值不在 from 中，保持不变
+        std::less_equal<const char *> before;
+        if (!owned_ && !view_.empty() && before(from.data(), view_.data()) &&
+            before(view_.data() + view_.size(), from.data() + from.size()))
+        {
+            view_ = to.substr(static_cast<size_t>(view_.data() - from.data()), view_.size());
+        }
+    }
+
     std::string Token::toString() const
     {
         std::string type_str;
@@ -38,6 +252,9 @@ namespace dash
         case TokenType::IO_NUMBER:
             type_str = "IO_NUMBER";
             break;
+        case TokenType::PROCESS_SUBST:
+            type_str = "PROCESS_SUBST";
+            break;
         case TokenType::NEWLINE:
             type_str = "NEWLINE";
             break;
@@ -47,28 +264,50 @@ namespace dash
         }
 
         std::ostringstream oss;
-        oss << "[" << type_str << " '" << value_ << "' at " << line_number_ << ":" << column_ << "]";
+        oss << "[" << type_str << " '" << getValue() << "' at " << line_number_ << ":" << column_ << "]";
         return oss.str();
     }
 
     // Lexer 实现
 
     Lexer::Lexer(Shell *shell)
-        : shell_(shell), position_(0), line_number_(1), column_(1), eof_seen_(false)
+        : shell_(shell), position_(0), line_number_(1), column_(1), lookahead_head_(0), lookahead_count_(0),
+          eof_seen_(false), stream_(nullptr), stream_pos_(0), stream_end_(0)
     {
     }
 
-    void Lexer::setInput(const std::string &input)
+    void Lexer::setInput(std::string_view input, std::function<bool(std::string &)> line_reader)
     {
+        // 前瞻缓冲区中的词法单元可能指向旧的输入，先清空
+        lookahead_head_ = 0;
+        lookahead_count_ = 0;
+
         input_ = input;
         position_ = 0;
         line_number_ = 1;
         column_ = 1;
         eof_seen_ = false;
+        pending_heredocs_.clear();
+        line_reader_ = std::move(line_reader);
+        stream_ = nullptr;
+
+        if (shell_)
+        {
+            CharClass::setMethod(shell_->getOptions()->getScanMethod());
+        }
+    }
 
-        // 清空词法单元队列
-        std::queue<std::unique_ptr<Token>> empty;
-        token_queue_.swap(empty);
+    void Lexer::setTokens(TokenStream *stream, size_t begin, size_t end)
+    {
+        setInput(std::string_view());
+        stream_ = stream;
+        stream_pos_ = begin;
+        stream_end_ = end;
+    }
+
+    void Lexer::rebase(Token &token, std::string_view source) const
+    {
+        token.rebase(input_, source);
     }
 
     char Lexer::currentChar() const
@@ -106,9 +345,37 @@ namespace dash
         return input_[position_ + 1];
     }
 
+    void Lexer::advanceTo(size_t end)
+    {
+        end = std::min(end, input_.size());
+        const char *begin = input_.data() + position_;
+        const char *stop = input_.data() + end;
+        const char *line_start = nullptr;
+        while (const char *newline = static_cast<const char *>(memchr(begin, '\n', static_cast<size_t>(stop - begin))))
+        {
+            line_number_++;
+            line_start = newline + 1;
+            begin = line_start;
+        }
+        if (line_start)
+        {
+            column_ = static_cast<int>(stop - line_start) + 1;
+        }
+        else
+        {
+            column_ += static_cast<int>(end - position_);
+        }
+        position_ = end;
+    }
+
+    std::string_view Lexer::slice(size_t start) const
+    {
+        return std::string_view(input_).substr(start, position_ - start);
+    }
+
     void Lexer::skipWhitespace()
     {
-        while (std::isspace(currentChar()) && currentChar() != '\n')
+        while (CharClass::is(currentChar(), CharClass::BLANK))
         {
             advance();
         }
@@ -116,36 +383,79 @@ namespace dash
 
     bool Lexer::isWordChar(char c) const
     {
-        // 单词字符包括字母、数字、下划线和一些特殊字符
-        return std::isalnum(c) || c == '_' || c == '/' || c == '.' || c == '-' || c == '+' || c == '@' || c == '$' || c == '*' || c == '?' || c == '(' || c == ')' || c == '`';
+        // 除空白和操作符外的字符都属于单词（$(cmd) 中的括号由 parseWord 单独处理）
+        return !CharClass::is(c, CharClass::NUL | CharClass::BLANK | CharClass::NEWLINE | CharClass::OPERATOR);
     }
 
     bool Lexer::isOperatorChar(char c) const
     {
         // 操作符字符
-        return c == '|' || c == '&' || c == ';' || c == '<' || c == '>' || c == '(' || c == ')' || c == '{' || c == '}';
+        return CharClass::is(c, CharClass::OPERATOR);
     }
 
-    std::unique_ptr<Token> Lexer::parseWord()
+    Token Lexer::parseWord()
     {
         int start_column = column_;
-        std::string value;
+        WordText value(input_, position_);
+        SegmentList segments;
         bool is_assignment = false;
         bool in_quotes = false;
         char quote_char = '\0';
         bool in_command_subst = false;
         int paren_count = 0;
+        bool quoted = false;
+
+        // 当前位置的普通字符属于哪一种段
+        auto text_kind = [&]()
+        {
+            return !in_quotes ? WordSegment::LITERAL
+                   : quote_char == '\'' ? WordSegment::SINGLE_QUOTED
+                                        : WordSegment::DOUBLE_QUOTED;
+        };
+
+        // 单词开头的 ~ 或 ~user，后面是 / 或单词结束时才是波浪线展开
+        if (currentChar() == '~')
+        {
+            size_t end = position_ + 1;
+            while (end < input_.size() && (std::isalnum(static_cast<unsigned char>(input_[end])) ||
+                                           input_[end] == '_' || input_[end] == '-' || input_[end] == '.'))
+            {
+                ++end;
+            }
+            char next = end < input_.size() ? input_[end] : '\0';
+            if (next == '/' || !isWordChar(next))
+            {
+                segments.mark(WordSegment::TILDE, false, 0);
+                value.append(std::string_view(input_).substr(position_, end - position_));
+                advanceTo(end);
+            }
+        }
 
         while (true)
         {
+            // 不需要单独处理的字符一次全部取出
+            if (!in_command_subst)
+            {
+                size_t stop = CharClass::find(input_, position_,
+                                              in_quotes ? CharClass::QUOTED_STOP : CharClass::WORD_STOP);
+                if (stop > position_)
+                {
+                    segments.mark(text_kind(), in_quotes, value.size());
+                    value.append(std::string_view(input_).substr(position_, stop - position_));
+                    advanceTo(stop);
+                }
+            }
+
             char c = currentChar();
 
-            // 处理命令替换 $(command)
-            if (c == '$' && peekChar() == '(')
+            // 处理命令替换 $(command) 和算术展开 $((expr))，单引号中不展开
+            if (!in_command_subst && c == '$' && peekChar() == '(' && quote_char != '\'')
             {
-                value += c;
+                bool arith = position_ + 2 < input_.size() && input_[position_ + 2] == '(';
+                segments.mark(arith ? WordSegment::ARITH : WordSegment::COMMAND, in_quotes, value.size());
+                value.append(c);
                 advance();
-                value += c;
+                value.append(currentChar());
                 advance();
                 in_command_subst = true;
                 paren_count = 1;
@@ -155,6 +465,10 @@ namespace dash
             // 处理命令替换中的括号
             if (in_command_subst)
             {
+                if (c == '\0' && continueLine())
+                {
+                    continue;
+                }
                 if (c == '(')
                 {
                     paren_count++;
@@ -168,7 +482,7 @@ namespace dash
                     }
                 }
                 
-                value += c;
+                value.append(c);
                 advance();
                 
                 if (paren_count == 0)
@@ -185,22 +499,44 @@ namespace dash
                 }
             }
             
+            // 处理参数展开 $name、${name}、$1、$? 等
+            if (c == '$' && quote_char != '\'')
+            {
+                size_t end = paramEnd(input_, position_);
+                if (end > position_ + 1)
+                {
+                    segments.mark(WordSegment::PARAM, in_quotes, value.size());
+                    value.append(std::string_view(input_).substr(position_, end - position_));
+                    advanceTo(end);
+                    continue;
+                }
+            }
+
             // 处理反引号命令替换 `command`
-            if (c == '`')
+            if (c == '`' && quote_char != '\'')
             {
-                value += c;
+                segments.mark(WordSegment::COMMAND, in_quotes, value.size());
+                value.append(c);
                 advance();
                 
-                // 查找匹配的反引号
-                while (currentChar() != '\0' && currentChar() != '`')
+                // 查找匹配的反引号，这一行没有时读入下一行接着找
+                size_t end;
+                while ((end = input_.find('`', position_)) == std::string::npos)
                 {
-                    value += currentChar();
-                    advance();
+                    value.append(std::string_view(input_).substr(position_));
+                    advanceTo(input_.size());
+                    if (!continueLine())
+                    {
+                        end = input_.size();
+                        break;
+                    }
                 }
+                value.append(std::string_view(input_).substr(position_, end - position_));
+                advanceTo(end);
                 
                 if (currentChar() == '`')
                 {
-                    value += currentChar();
+                    value.append(currentChar());
                     advance();
                 }
                 else
@@ -217,8 +553,11 @@ namespace dash
                 if (!in_quotes)
                 {
                     in_quotes = true;
+                    quoted = true;
                     quote_char = c;
+                    segments.mark(text_kind(), true, value.size());
                     // 不将引号添加到值中
+                    value.skip();
                     advance();
                 }
                 else if (c == quote_char)
@@ -226,11 +565,13 @@ namespace dash
                     in_quotes = false;
                     quote_char = '\0';
                     // 不将引号添加到值中
+                    value.skip();
                     advance();
                 }
                 else
                 {
-                    value += c;
+                    segments.mark(text_kind(), true, value.size());
+                    value.append(c);
                     advance();
                 }
                 continue;
@@ -241,9 +582,52 @@ namespace dash
             {
                 if (c == '\0')
                 {
+                    if (continueLine())
+                    {
+                        continue;
+                    }
                     throw ShellException(ExceptionType::SYNTAX, "Unterminated quote");
                 }
-                value += c;
+
+                // 双引号中的反斜杠只转义 $ ` " \ 和换行符
+                if (c == '\\' && quote_char == '"')
+                {
+                    if (position_ + 1 == input_.size())
+                    {
+                        continueLine();
+                    }
+                    char next = peekChar();
+                    if (next == '\n')
+                    {
+                        value.skip();
+                        advance();
+                        value.skip();
+                        advance();
+                        continue;
+                    }
+                    if (next == '$' || next == '`' || next == '"' || next == '\\')
+                    {
+                        segments.skip(value.size());
+                        value.append(c);
+                        advance();
+                        value.append(next);
+                        advance();
+                        continue;
+                    }
+                }
+
+                segments.mark(text_kind(), true, value.size());
+                value.append(c);
+                advance();
+                continue;
+            }
+
+            // 行末的反斜杠：与换行符一起去掉，单词在下一行继续
+            if (c == '\\' && position_ + 1 == input_.size() && continueLine())
+            {
+                value.skip();
+                advance();
+                value.skip();
                 advance();
                 continue;
             }
@@ -251,11 +635,14 @@ namespace dash
             // 处理转义字符
             if (c == '\\')
             {
-                value += c;
+                quoted = true;
+                segments.mark(WordSegment::LITERAL, false, value.size());
+                segments.skip(value.size());
+                value.append(c);
                 advance();
                 if (currentChar() != '\0')
                 {
-                    value += currentChar();
+                    value.append(currentChar());
                     advance();
                 }
                 continue;
@@ -265,7 +652,8 @@ namespace dash
             if (c == '=' && !value.empty() && !is_assignment)
             {
                 is_assignment = true;
-                value += c;
+                segments.mark(WordSegment::LITERAL, false, value.size());
+                value.append(c);
                 advance();
                 continue;
             }
@@ -276,114 +664,168 @@ namespace dash
                 break;
             }
 
-            value += c;
+            segments.mark(CharClass::is(c, CharClass::GLOB) ? WordSegment::GLOB : WordSegment::LITERAL, false,
+                          value.size());
+            value.append(c);
             advance();
         }
 
         // 创建相应类型的词法单元
+        TokenType type = TokenType::WORD;
         if (is_assignment)
         {
-            return std::make_unique<Token>(TokenType::ASSIGNMENT, value, line_number_, start_column);
+            type = TokenType::ASSIGNMENT;
         }
         else
         {
             // 检查是否是 IO 编号
-            bool is_io_number = true;
-            for (char c : value)
+            std::string_view text = value.view();
+            bool is_io_number = !text.empty() && (currentChar() == '>' || currentChar() == '<');
+            for (char c : text)
             {
-                if (!std::isdigit(c))
+                if (!std::isdigit(static_cast<unsigned char>(c)))
                 {
                     is_io_number = false;
                     break;
                 }
             }
-
-            if (is_io_number && !value.empty() && (currentChar() == '>' || currentChar() == '<'))
-            {
-                return std::make_unique<Token>(TokenType::IO_NUMBER, value, line_number_, start_column);
-            }
-            else
+            if (is_io_number)
             {
-                return std::make_unique<Token>(TokenType::WORD, value, line_number_, start_column);
+                type = TokenType::IO_NUMBER;
             }
         }
+
+        Token token(type, value.view(), line_number_, start_column);
+        token.setSegments(segments.take(value.size()));
+        if (value.owned())
+        {
+            token.setText(value.take());
+        }
+        token.setQuoted(type == TokenType::WORD && quoted);
+        return token;
     }
 
-    std::unique_ptr<Token> Lexer::parseOperator()
+    Token Lexer::parseOperator()
     {
         int start_column = column_;
-        std::string value;
+        size_t start = position_;
 
-        // 处理多字符操作符
-        if (currentChar() == '&' && peekChar() == '&')
-        {
-            value = "&&";
-            advance();
-            advance();
-        }
-        else if (currentChar() == '|' && peekChar() == '|')
-        {
-            value = "||";
-            advance();
-            advance();
-        }
-        else if (currentChar() == '>' && peekChar() == '>')
-        {
-            value = ">>";
-            advance();
-            advance();
-        }
-        else if (currentChar() == '<' && peekChar() == '<')
-        {
-            value = "<<";
-            advance();
-            advance();
-        }
-        else if (currentChar() == '<' && peekChar() == '&')
-        {
-            value = "<&";
-            advance();
-            advance();
-        }
-        else if (currentChar() == '>' && peekChar() == '&')
+        char c = currentChar();
+        char next = peekChar();
+        advance();
+
+        // 处理多字符操作符 &&、||、>>、<<、<<-、<&、>&
+        if ((next == c && (c == '&' || c == '|' || c == '>' || c == '<')) ||
+            (next == '&' && (c == '<' || c == '>')))
         {
-            value = ">&";
-            advance();
             advance();
+            if (c == '<' && next == '<' && currentChar() == '-')
+            {
+                advance();
+            }
         }
-        else
+
+        return Token(TokenType::OPERATOR, slice(start), line_number_, start_column);
+    }
+
+    Token Lexer::parseProcessSubstitution()
+    {
+        int start_column = column_;
+        std::string value(1, currentChar());
+        advance(); // 跳过 < 或 >
+        advance(); // 跳过 (
+
+        // 找到匹配的右括号，引号中的括号不计
+        int depth = 1;
+        char quote_char = '\0';
+        while (true)
         {
-            // 单字符操作符
-            value = currentChar();
+            char c = currentChar();
+            if (c == '\0')
+            {
+                if (continueLine())
+                {
+                    continue;
+                }
+                throw ShellException(ExceptionType::SYNTAX, "Unterminated process substitution");
+            }
+
+            if (quote_char != '\0')
+            {
+                if (c == quote_char)
+                {
+                    quote_char = '\0';
+                }
+            }
+            else if (c == '\'' || c == '"')
+            {
+                quote_char = c;
+            }
+            else if (c == '\\')
+            {
+                value += c;
+                advance();
+                c = currentChar();
+                if (c == '\0')
+                {
+                    continue;
+                }
+            }
+            else if (c == '(')
+            {
+                depth++;
+            }
+            else if (c == ')' && --depth == 0)
+            {
+                advance();
+                break;
+            }
+
+            value += c;
             advance();
         }
 
-        return std::make_unique<Token>(TokenType::OPERATOR, value, line_number_, start_column);
+        // 值去掉了括号，与原文不连续，由词法单元自己保存
+        Token token(TokenType::PROCESS_SUBST, std::string_view(), line_number_, start_column);
+        token.setText(std::move(value));
+        return token;
     }
 
     void Lexer::parseComment()
     {
         // 跳过注释（从 # 到行尾）
-        while (currentChar() != '\0' && currentChar() != '\n')
+        size_t end = input_.find('\n', position_);
+        advanceTo(end == std::string::npos ? input_.size() : end);
+    }
+
+    Token Lexer::nextToken()
+    {
+        // 前瞻缓冲区中有词法单元时返回第一个
+        if (lookahead_count_ > 0)
         {
-            advance();
+            Token token = std::move(lookahead_[lookahead_head_]);
+            lookahead_head_ = (lookahead_head_ + 1) & (LOOKAHEAD - 1);
+            --lookahead_count_;
+            return token;
         }
+        return scanToken();
     }
 
-    std::unique_ptr<Token> Lexer::nextToken()
+    Token Lexer::scanToken()
     {
-        // 如果队列中有词法单元，则返回队列中的第一个
-        if (!token_queue_.empty())
+        if (stream_)
         {
-            std::unique_ptr<Token> token = std::move(token_queue_.front());
-            token_queue_.pop();
-            return token;
+            if (stream_pos_ < stream_end_)
+            {
+                return std::move(stream_->tokens[stream_pos_++]);
+            }
+            return Token(TokenType::END_OF_INPUT, std::string_view(), line_number_, column_);
         }
 
         // 如果已经看到 EOF，则返回 END_OF_INPUT 词法单元
         if (eof_seen_)
         {
-            return std::make_unique<Token>(TokenType::END_OF_INPUT, "", line_number_, column_);
+            return Token(TokenType::END_OF_INPUT, std::string_view(), line_number_, column_);
         }
 
         // 跳过空白字符
@@ -394,8 +836,14 @@ namespace dash
         // 检查输入结束
         if (c == '\0')
         {
+            if (!pending_heredocs_.empty())
+            {
+                // 命令行之后没有换行符：正文在后面的输入中
+                readHereDocs();
+                return scanToken();
+            }
             eof_seen_ = true;
-            return std::make_unique<Token>(TokenType::END_OF_INPUT, "", line_number_, column_);
+            return Token(TokenType::END_OF_INPUT, std::string_view(), line_number_, column_);
         }
 
         // 处理换行符
@@ -403,14 +851,34 @@ namespace dash
         {
             int start_column = column_;
             advance();
-            return std::make_unique<Token>(TokenType::NEWLINE, "\n", line_number_ - 1, start_column);
+            int line_number = line_number_ - 1;
+            if (!pending_heredocs_.empty())
+            {
+                readHereDocs();
+            }
+            // 读取 Here 文档正文会追加输入，值不指向输入缓冲区
+            return Token(TokenType::NEWLINE, "\n", line_number, start_column);
+        }
+
+        // 单词之间行末的反斜杠：续行，与换行符一起跳过
+        if (c == '\\' && position_ + 1 == input_.size() && continueLine())
+        {
+            advance();
+            advance();
+            return scanToken();
         }
 
         // 处理注释
         if (c == '#')
         {
             parseComment();
-            return nextToken(); // 递归调用以获取下一个有效词法单元
+            return scanToken(); // 递归调用以获取下一个有效词法单元
+        }
+
+        // 处理进程替换 <(cmd)、>(cmd)
+        if ((c == '<' || c == '>') && peekChar() == '(')
+        {
+            return parseProcessSubstitution();
         }
 
         // 处理操作符
@@ -423,28 +891,102 @@ namespace dash
         return parseWord();
     }
 
-    const Token *Lexer::peekToken()
+    void Lexer::addHereDoc(std::shared_ptr<HereDoc> heredoc)
+    {
+        if (stream_)
+        {
+            // 正文已经在分析时读好
+            if (stream_->next_heredoc < stream_->heredoc_bodies.size())
+            {
+                heredoc->body = std::move(stream_->heredoc_bodies[stream_->next_heredoc++]);
+            }
+            return;
+        }
+        pending_heredocs_.push_back(std::move(heredoc));
+    }
+
+    bool Lexer::readMoreInput(bool continuation)
     {
-        if (token_queue_.empty())
+        std::string line;
+        if (!line_reader_ || !line_reader_(line))
+        {
+            return false;
+        }
+        for (size_t i = 0; i < lookahead_count_; ++i)
+        {
+            lookahead_[(lookahead_head_ + i) & (LOOKAHEAD - 1)].materialize();
+        }
+        if (continuation)
+        {
+            input_ += '\n';
+            input_ += line;
+        }
+        else
         {
-            token_queue_.push(nextToken());
+            input_ += line;
+            input_ += '\n';
         }
+        return true;
+    }
 
-        return token_queue_.front().get();
+    bool Lexer::continueLine()
+    {
+        // 当前位置在输入末尾，或者是行末的反斜杠；输入中间的 '\0' 不算
+        return position_ + 1 >= input_.size() && readMoreInput(true);
     }
 
-    void Lexer::ungetToken(std::unique_ptr<Token> token)
+    void Lexer::readHereDocs()
     {
-        std::queue<std::unique_ptr<Token>> new_queue;
-        new_queue.push(std::move(token));
+        for (auto &heredoc : pending_heredocs_)
+        {
+            while (position_ < input_.size() || readMoreInput())
+            {
+                size_t end = input_.find('\n', position_);
+                if (end == std::string::npos)
+                {
+                    end = input_.size();
+                }
+                std::string line = input_.substr(position_, end - position_);
+                position_ = std::min(end + 1, input_.size());
+                line_number_++;
+                column_ = 1;
 
-        while (!token_queue_.empty())
+                if (heredoc->strip_tabs)
+                {
+                    line.erase(0, line.find_first_not_of('\t'));
+                }
+                if (line == heredoc->delimiter)
+                {
+                    break;
+                }
+                heredoc->body += line;
+                heredoc->body += '\n';
+            }
+            // 输入结束时还没有遇到定界符：已经读到的内容就是正文
+        }
+        pending_heredocs_.clear();
+    }
+
+    const Token *Lexer::peekToken()
+    {
+        if (lookahead_count_ == 0)
         {
-            new_queue.push(std::move(token_queue_.front()));
-            token_queue_.pop();
+            lookahead_[lookahead_head_] = scanToken();
+            lookahead_count_ = 1;
         }
 
-        token_queue_.swap(new_queue);
+        return &lookahead_[lookahead_head_];
+    }
+
+    void Lexer::ungetToken(Token token)
+    {
+        if (lookahead_count_ == LOOKAHEAD)
+        {
+            throw ShellException(ExceptionType::INTERNAL, "Token lookahead buffer is full");
+        }
+        lookahead_head_ = (lookahead_head_ + LOOKAHEAD - 1) & (LOOKAHEAD - 1);
+        lookahead_[lookahead_head_] = std::move(token);
+        ++lookahead_count_;
     }
 
 } // namespace dash
\ No newline at end of file
@@ -22,8 +22,12 @@ CommandNode::CommandNode()
 {
 }
 
-void CommandNode::addArg(const std::string& arg)
+void CommandNode::addArg(const std::string& arg, const std::vector<WordSegment>& segments)
 {
+    if (!segments.empty())
+    {
+        expansions_.push_back({args_.size(), segments});
+    }
     args_.push_back(arg);
 }
 
@@ -32,8 +36,15 @@ void CommandNode::addAssignment(const std::string& assignment)
     assignments_.push_back(assignment);
 }
 
+void CommandNode::addProcessSubstitution(const std::string& text, bool output, std::unique_ptr<Node> command)
+{
+    process_substitutions_.push_back({args_.size(), output, std::move(command)});
+    args_.push_back(text);
+}
+
 void CommandNode::addRedirection(const Redirection& redir)
 {
+    redirection_plan_.add(redir);
     redirections_.push_back(redir);
 }
 
@@ -90,20 +101,24 @@ void CommandNode::print(int indent) const
 }
 
 // PipeNode 实现
-PipeNode::PipeNode(std::unique_ptr<Node> left, std::unique_ptr<Node> right, bool background)
-    : Node(NodeType::PIPE), left_(std::move(left)), right_(std::move(right)), background_(background)
+PipeNode::PipeNode(bool background)
+    : Node(NodeType::PIPE), background_(background)
+{
+}
+
+void PipeNode::addCommand(std::unique_ptr<Node> command)
 {
+    commands_.push_back(std::move(command));
 }
 
 void PipeNode::print(int indent) const
 {
     std::cout << std::setw(indent) << "" << "PipeNode:" << (background_ ? " (background)" : "") << std::endl;
     
-    std::cout << std::setw(indent + 2) << "" << "Left:" << std::endl;
-    left_->print(indent + 4);
-    
-    std::cout << std::setw(indent + 2) << "" << "Right:" << std::endl;
-    right_->print(indent + 4);
+    for (size_t i = 0; i < commands_.size(); ++i) {
+        std::cout << std::setw(indent + 2) << "" << "Stage " << i + 1 << ":" << std::endl;
+        commands_[i]->print(indent + 4);
+    }
 }
 
 // ListNode 实现
@@ -230,6 +245,7 @@ SubshellNode::SubshellNode(std::unique_ptr<Node> commands)
 
 void SubshellNode::addRedirection(const Redirection& redir)
 {
+    redirection_plan_.add(redir);
     redirections_.push_back(redir);
 }
 
@@ -0,0 +1,196 @@
+/**
+ * @file options.cpp
+ * @brief Shell 选项（set -o）实现
+ */
+
+#include <cctype>
+#include <limits>
+#include "core/options.h"
+
+namespace dash
+{
+
+    namespace
+    {
+        // 与 SpawnBackendType 的顺序一致
+        const char *const spawn_backend_names[] = {"auto", "fork", "vfork", "posix_spawn", "zygote", nullptr};
+
+        // 与 ScanMethod 的顺序一致
+        const char *const scan_method_names[] = {"auto", "scalar", "sse2", "avx2", nullptr};
+    }
+
+    const ShellOptions::Entry ShellOptions::entries_[] = {
+        {"forkstats", Kind::FLAG, &ShellOptions::fork_stats_, nullptr, nullptr, nullptr},
+        {"forkthreshold", Kind::SIZE, nullptr, &ShellOptions::fork_threshold_kb_, nullptr, nullptr},
+        {"iouring", Kind::FLAG, &ShellOptions::io_uring_, nullptr, nullptr, nullptr},
+        {"multios", Kind::FLAG, &ShellOptions::multios_, nullptr, nullptr, nullptr},
+        {"noexec", Kind::FLAG, &ShellOptions::no_exec_, nullptr, nullptr, nullptr},
+        {"pipefail", Kind::FLAG, &ShellOptions::pipefail_, nullptr, nullptr, nullptr},
+        {"pipesize", Kind::SIZE_AUTO, nullptr, &ShellOptions::pipe_size_kb_, nullptr, nullptr},
+        {"scan", Kind::CHOICE, nullptr, nullptr, &ShellOptions::scan_method_, scan_method_names},
+        {"spawn", Kind::CHOICE, nullptr, nullptr, &ShellOptions::spawn_backend_, spawn_backend_names},
+    };
+
+    ShellOptions::ShellOptions()
+        : fork_stats_(false),
+          fork_threshold_kb_(64 * 1024),
+          spawn_backend_(static_cast<int>(SpawnBackendType::AUTO)),
+          scan_method_(static_cast<int>(ScanMethod::AUTO)),
+          pipefail_(false),
+          multios_(false),
+          io_uring_(false),
+          no_exec_(false),
+          pipe_size_kb_(0)
+    {
+    }
+
+    const ShellOptions::Entry *ShellOptions::find(const std::string &name)
+    {
+        for (const auto &entry : entries_)
+        {
+            if (name == entry.name)
+            {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    bool ShellOptions::setFlag(const std::string &name, bool value)
+    {
+        const Entry *entry = find(name);
+        if (!entry || entry->kind != Kind::FLAG)
+        {
+            return false;
+        }
+        this->*(entry->flag) = value;
+        return true;
+    }
+
+    bool ShellOptions::setValue(const std::string &name, const std::string &value)
+    {
+        const Entry *entry = find(name);
+        if (!entry || entry->kind == Kind::FLAG)
+        {
+            return false;
+        }
+        if (entry->kind == Kind::CHOICE)
+        {
+            for (int i = 0; entry->choices[i]; ++i)
+            {
+                if (value == entry->choices[i])
+                {
+                    this->*(entry->choice) = i;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        if (entry->kind == Kind::SIZE_AUTO && value == "auto")
+        {
+            this->*(entry->size) = SIZE_AUTO;
+            return true;
+        }
+
+        size_t kb;
+        if (!parseSize(value, kb) || (entry->kind == Kind::SIZE_AUTO && kb == SIZE_AUTO))
+        {
+            return false;
+        }
+        this->*(entry->size) = kb;
+        return true;
+    }
+
+    void ShellOptions::print(std::ostream &out) const
+    {
+        for (const auto &entry : entries_)
+        {
+            std::string name = entry.name;
+            name.resize(16, ' ');
+            out << name;
+            if (entry.kind == Kind::FLAG)
+            {
+                out << (this->*(entry.flag) ? "on" : "off") << std::endl;
+            }
+            else
+            {
+                out << formatValue(entry) << std::endl;
+            }
+        }
+    }
+
+    void ShellOptions::printCommands(std::ostream &out) const
+    {
+        for (const auto &entry : entries_)
+        {
+            if (entry.kind == Kind::FLAG)
+            {
+                out << "set " << (this->*(entry.flag) ? "-o " : "+o ") << entry.name << std::endl;
+            }
+            else
+            {
+                out << "set -o " << entry.name << "=" << formatValue(entry) << std::endl;
+            }
+        }
+    }
+
+    std::string ShellOptions::formatValue(const Entry &entry) const
+    {
+        if (entry.kind == Kind::CHOICE)
+        {
+            return entry.choices[this->*(entry.choice)];
+        }
+        if (entry.kind == Kind::SIZE_AUTO && this->*(entry.size) == SIZE_AUTO)
+        {
+            return "auto";
+        }
+        return std::to_string(this->*(entry.size));
+    }
+
+    bool ShellOptions::parseSize(const std::string &text, size_t &kb)
+    {
+        size_t i = 0;
+        size_t value = 0;
+        while (i < text.size() && std::isdigit(static_cast<unsigned char>(text[i])))
+        {
+            size_t digit = text[i] - '0';
+            if (value > (std::numeric_limits<size_t>::max() - digit) / 10)
+            {
+                return false;
+            }
+            value = value * 10 + digit;
+            ++i;
+        }
+        if (i == 0)
+        {
+            return false;
+        }
+
+        size_t scale = 1;
+        if (i < text.size())
+        {
+            switch (std::tolower(static_cast<unsigned char>(text[i])))
+            {
+            case 'k':
+                break;
+            case 'm':
+                scale = 1024;
+                break;
+            case 'g':
+                scale = 1024 * 1024;
+                break;
+            default:
+                return false;
+            }
+            ++i;
+        }
+        if (i != text.size() || value > std::numeric_limits<size_t>::max() / scale)
+        {
+            return false;
+        }
+        kb = value * scale;
+        return true;
+    }
+
+} // namespace dash
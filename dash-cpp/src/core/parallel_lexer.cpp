@@ -0,0 +1,307 @@
+/**
+ * @file parallel_lexer.cpp
+ * @brief 大脚本的并行词法分析实现
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "core/parallel_lexer.h"
+#include "core/redirection.h"
+#include "utils/thread_pool.h"
+
+namespace dash
+{
+
+    namespace
+    {
+        /**
+         * @brief 取出从 pos 开始的一行，pos 前进到下一行的行首
+         *
+         * @param text 文本
+         * @param pos 行首，返回时为下一行的行首
+         * @return std::string_view 不含换行符的一行
+         */
+        std::string_view nextLine(std::string_view text, size_t &pos)
+        {
+            size_t end = text.find('\n', pos);
+            if (end == std::string_view::npos)
+            {
+                end = text.size();
+            }
+            std::string_view line = text.substr(pos, end - pos);
+            pos = std::min(end + 1, text.size());
+            return line;
+        }
+
+        /**
+         * @brief 分析一行命令，与解析器一样在 << 或 <<- 之后的单词处登记 Here 文档
+         *
+         * @param lexer 词法分析器，已经设置好这一行的输入
+         * @param source 从这一行的行首开始的原文，词法单元的值改为指向其中
+         * @param tokens 输出参数，这一行的词法单元，为空时不保存
+         * @param heredocs 输出参数，这一行登记的 Here 文档
+         */
+        void lexCommand(Lexer &lexer, std::string_view source, std::vector<Token> *tokens,
+                        std::vector<std::shared_ptr<HereDoc>> &heredocs)
+        {
+            bool after_heredoc = false;
+            bool strip_tabs = false;
+            while (true)
+            {
+                Token token = lexer.nextToken();
+                if (token.getType() == TokenType::END_OF_INPUT)
+                {
+                    break;
+                }
+                // 读取正文会向输入追加内容，先让值指向原文
+                lexer.rebase(token, source);
+
+                if (after_heredoc && token.getType() == TokenType::WORD)
+                {
+                    auto heredoc = std::make_shared<HereDoc>(HereDoc::delimiterOf(token.getValue()),
+                                                             !token.isQuoted(), strip_tabs);
+                    lexer.addHereDoc(heredoc);
+                    heredocs.push_back(std::move(heredoc));
+                }
+                after_heredoc = token.getType() == TokenType::OPERATOR &&
+                                (token.getValue() == "<<" || token.getValue() == "<<-");
+                strip_tabs = token.getValue() == "<<-";
+
+                if (tokens)
+                {
+                    tokens->push_back(std::move(token));
+                }
+            }
+        }
+    }
+
+    ParallelLexer::ParallelLexer(std::string_view text, size_t threads)
+        : text_(text), threads_(std::max<size_t>(threads, 1)), position_(0), scan_pos_(0),
+          alias_pos_(text.find("alias")), sequential_(false), chunk_count_(0), next_chunk_(0)
+    {
+    }
+
+    size_t ParallelLexer::findSplit(size_t target)
+    {
+        const size_t size = text_.size();
+        const char *data = text_.data();
+        target = std::min(target, size);
+        while (scan_pos_ < target && scan_pos_ < size)
+        {
+            // 不早于 target 的第一个行首
+            const void *newline = target < size ? memchr(data + target - 1, '\n', size - (target - 1)) : nullptr;
+            size_t split = newline ? static_cast<const char *>(newline) - data + 1 : size;
+
+            // 这之前没有 << 时中间的行都不会开始 Here 文档
+            size_t pos = scan_pos_;
+            while (true)
+            {
+                const void *found = memchr(data + pos, '<', split - pos);
+                if (!found)
+                {
+                    scan_pos_ = split;
+                    return split;
+                }
+                pos = static_cast<const char *>(found) - data;
+                if (pos + 1 < size && data[pos + 1] == '<')
+                {
+                    break;
+                }
+                ++pos;
+            }
+
+            // 分析含有 << 的一行，跳过它的 Here 文档正文
+            size_t line_start = pos;
+            while (line_start > scan_pos_ && data[line_start - 1] != '\n')
+            {
+                --line_start;
+            }
+            size_t next = line_start;
+            std::string_view line = nextLine(text_, next);
+            scan_pos_ = skipHereDocs(next, line);
+        }
+        return std::min(scan_pos_, size);
+    }
+
+    size_t ParallelLexer::skipHereDocs(size_t pos, std::string_view line) const
+    {
+        std::vector<std::shared_ptr<HereDoc>> heredocs;
+        try
+        {
+            Lexer lexer(nullptr);
+            lexer.setInput(line);
+            lexCommand(lexer, line, nullptr, heredocs);
+        }
+        catch (const std::exception &)
+        {
+            // 这一行本身有错误，逐行执行到这里时脚本就结束了，边界放在哪里都可以
+            return pos;
+        }
+
+        // 一块之内没有找到定界符时不跳过：<< 可能在上面几行开始的引号中，正文真的
+        // 这么长时由第二遍读过边界
+        size_t start = pos;
+        for (const auto &heredoc : heredocs)
+        {
+            bool found = false;
+            while (!found && pos < text_.size() && pos - start <= CHUNK_SIZE)
+            {
+                std::string_view body_line = nextLine(text_, pos);
+                if (heredoc->strip_tabs)
+                {
+                    size_t tabs = body_line.find_first_not_of('\t');
+                    body_line.remove_prefix(tabs == std::string_view::npos ? body_line.size() : tabs);
+                }
+                found = body_line == heredoc->delimiter;
+            }
+            if (!found)
+            {
+                return start;
+            }
+        }
+        return pos;
+    }
+
+    void ParallelLexer::tokenizeChunk(Chunk &chunk) const
+    {
+        TokenStream &result = chunk.result;
+        result.tokens.clear();
+        result.commands.clear();
+        result.heredoc_bodies.clear();
+        chunk.stop = chunk.begin;
+        chunk.failed = false;
+
+        // 命令没有写完时（Here 文档的正文、跨行的引号）与逐行读取一样读入后面的行，
+        // 可以读过块的边界
+        size_t pos = chunk.begin;
+        auto line_reader = [this, &pos](std::string &next)
+        {
+            if (pos >= text_.size())
+            {
+                return false;
+            }
+            next = std::string(nextLine(text_, pos));
+            return true;
+        };
+
+        Lexer lexer(nullptr);
+        std::vector<std::shared_ptr<HereDoc>> heredocs;
+        while (pos < chunk.end)
+        {
+            size_t line_start = pos;
+            std::string_view line = nextLine(text_, pos);
+            if (line.empty())
+            {
+                // 逐行执行时跳过空行
+                chunk.stop = pos;
+                continue;
+            }
+
+            size_t mark = result.tokens.size();
+            try
+            {
+                lexer.setInput(line, line_reader);
+                lexCommand(lexer, text_.substr(line_start), &result.tokens, heredocs);
+            }
+            catch (const std::exception &)
+            {
+                result.tokens.resize(mark);
+                chunk.failed = true;
+                return;
+            }
+
+            result.commands.push_back(result.tokens.size());
+            for (auto &heredoc : heredocs)
+            {
+                result.heredoc_bodies.push_back(std::move(heredoc->body));
+            }
+            heredocs.clear();
+            chunk.stop = pos;
+        }
+    }
+
+    bool ParallelLexer::tokenizeNext()
+    {
+        chunk_count_ = 0;
+        next_chunk_ = 0;
+        size_t begin = position_;
+        while (!sequential_ && chunk_count_ < threads_ && begin < text_.size())
+        {
+            size_t end = findSplit(begin + CHUNK_SIZE);
+            if (end > alias_pos_)
+            {
+                sequential_ = true;
+                break;
+            }
+            if (chunk_count_ == chunks_.size())
+            {
+                chunks_.emplace_back();
+            }
+            Chunk &chunk = chunks_[chunk_count_++];
+            chunk.begin = begin;
+            chunk.end = end;
+            begin = end;
+        }
+        position_ = begin;
+        if (chunk_count_ == 0)
+        {
+            return false;
+        }
+
+        // 线程只在分析期间存在，执行命令时 fork 不会遇到其他线程
+        ThreadPool pool(chunk_count_ - 1);
+        std::vector<std::function<void()>> tasks;
+        for (size_t i = 0; i < chunk_count_; ++i)
+        {
+            Chunk &chunk = chunks_[i];
+            tasks.push_back([this, &chunk]()
+                            { tokenizeChunk(chunk); });
+        }
+        pool.runAll(tasks);
+        return true;
+    }
+
+    bool ParallelLexer::next(TokenStream &stream, std::string_view &rest)
+    {
+        stream.tokens.clear();
+        stream.commands.clear();
+        stream.heredoc_bodies.clear();
+        stream.next_heredoc = 0;
+        rest = std::string_view();
+
+        if (next_chunk_ == chunk_count_ && !tokenizeNext())
+        {
+            if (position_ >= text_.size())
+            {
+                return false;
+            }
+            rest = text_.substr(position_);
+            position_ = text_.size();
+            return true;
+        }
+
+        Chunk &chunk = chunks_[next_chunk_++];
+        std::swap(stream.tokens, chunk.result.tokens);
+        std::swap(stream.commands, chunk.result.commands);
+        std::swap(stream.heredoc_bodies, chunk.result.heredoc_bodies);
+        if (chunk.failed)
+        {
+            // 这一组后面的块作废，从出错的一行起逐行处理
+            position_ = chunk.stop;
+            sequential_ = true;
+            next_chunk_ = chunk_count_;
+        }
+        else if (chunk.stop != chunk.end)
+        {
+            // 最后一行命令跨过了边界，后面的块从命令中间开始分析，作废后从命令结束处重新分块
+            position_ = chunk.stop;
+            scan_pos_ = std::max(scan_pos_, position_);
+            next_chunk_ = chunk_count_;
+        }
+        return true;
+    }
+
+} // namespace dash
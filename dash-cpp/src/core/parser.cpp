@@ -4,11 +4,13 @@
  */
 
 #include <iostream>
+#include <set>
 #include <unordered_set>
 #include "core/parser.h"
 #include "core/shell.h"
 #include "core/node.h"
 #include "core/input.h"
+#include "core/redirection.h"
 #include "utils/error.h"
 
 namespace dash
@@ -19,6 +21,10 @@ namespace dash
         "if", "then", "else", "elif", "fi", "case", "esac", "for", "while",
         "until", "do", "done", "in", "{", "}", "!", "[[", "]]"};
 
+    // 结束命令列表的保留字
+    static const std::set<std::string, std::less<>> list_terminators = {
+        "then", "else", "elif", "fi", "do", "done", "esac", "}"};
+
     Parser::Parser(Shell *shell)
         : shell_(shell), lexer_(std::make_unique<Lexer>(shell))
     {
@@ -28,9 +34,14 @@ namespace dash
     {
     }
 
-    void Parser::setInput(const std::string &input)
+    void Parser::setInput(const std::string &input, std::function<bool(std::string &)> line_reader)
+    {
+        lexer_->setInput(input, std::move(line_reader));
+    }
+
+    void Parser::setTokens(TokenStream *stream, size_t begin, size_t end)
     {
-        lexer_->setInput(input);
+        lexer_->setTokens(stream, begin, end);
     }
 
     std::unique_ptr<Node> Parser::parseCommand(bool interactive)
@@ -48,8 +59,10 @@ namespace dash
                     return nullptr; // EOF
                 }
 
-                // 设置词法分析器的输入
-                lexer_->setInput(line);
+                // 设置词法分析器的输入，Here 文档的正文从后续的输入行中读取
+                InputHandler *input = shell_->getInput();
+                lexer_->setInput(line, [input](std::string &next)
+                                 { return input->readContinuationLine(next); });
             }
 
             // 解析命令列表
@@ -57,10 +70,10 @@ namespace dash
             std::unique_ptr<Node> node = parseList();
 
             // 检查是否有多余的词法单元
-            std::unique_ptr<Token> token = lexer_->nextToken();
-            if (token->getType() != TokenType::END_OF_INPUT)
+            Token token = lexer_->nextToken();
+            if (token.getType() != TokenType::END_OF_INPUT)
             {
-                throw ShellException(ExceptionType::SYNTAX, "Syntax error: unexpected token '" + token->getValue() + "'");
+                throw ShellException(ExceptionType::SYNTAX, "Syntax error: unexpected token '" + std::string(token.getValue()) + "'");
             }
 
             return node;
@@ -102,6 +115,10 @@ namespace dash
             {
                 lexer_->nextToken(); // 消耗分号
                 skipNewlines();
+                if (atListEnd())
+                {
+                    break;
+                }
 
                 // 解析下一个命令
                 command = parsePipeline();
@@ -110,11 +127,26 @@ namespace dash
                     list->addCommand(std::move(command), ";");
                 }
             }
+            // 换行符与分号一样分隔命令（-c 的多行命令、Here 文档之后的命令）
+            else if (token->getType() == TokenType::NEWLINE)
+            {
+                skipNewlines();
+                if (atListEnd())
+                {
+                    break;
+                }
+
+                command = parsePipeline();
+                if (command)
+                {
+                    list->addCommand(std::move(command), ";");
+                }
+            }
             // 如果是 && 或 ||，继续解析
             else if (token->getType() == TokenType::OPERATOR &&
                      (token->getValue() == "&&" || token->getValue() == "||"))
             {
-                std::string op = token->getValue();
+                std::string op(token->getValue());
                 lexer_->nextToken(); // 消耗操作符
                 skipNewlines();
 
@@ -161,21 +193,27 @@ namespace dash
         // 查看下一个词法单元
         const Token *token = lexer_->peekToken();
 
-        // 如果是管道符，继续解析
+        // 如果是管道符，循环解析后面的各个阶段，长管道也不会递归
         if (token->getType() == TokenType::OPERATOR && token->getValue() == "|")
         {
-            lexer_->nextToken(); // 消耗管道符
-            skipNewlines();
+            auto pipe = std::make_unique<PipeNode>(background);
+            pipe->addCommand(std::move(command));
 
-            // 解析右侧命令
-            auto right = parsePipeline();
-            if (!right)
+            while (token->getType() == TokenType::OPERATOR && token->getValue() == "|")
             {
-                throw ShellException(ExceptionType::SYNTAX, "Syntax error: expected command after '|'");
+                lexer_->nextToken(); // 消耗管道符
+                skipNewlines();
+
+                auto stage = parseSimpleCommand();
+                if (!stage)
+                {
+                    throw ShellException(ExceptionType::SYNTAX, "Syntax error: expected command after '|'");
+                }
+                pipe->addCommand(std::move(stage));
+                token = lexer_->peekToken();
             }
 
-            // 创建管道节点
-            return std::make_unique<PipeNode>(std::move(command), std::move(right), background);
+            command = std::move(pipe);
         }
 
         // 检查是否是后台运行
@@ -218,7 +256,7 @@ namespace dash
         // 检查是否是保留字
         if (token->getType() == TokenType::WORD)
         {
-            std::string word = token->getValue();
+            std::string_view word = token->getValue();
 
             // 处理特殊命令结构
             if (word == "if")
@@ -241,10 +279,12 @@ namespace dash
             {
                 return parseCase();
             }
-            else if (word == "(")
-            {
-                return parseSubshell();
-            }
+        }
+
+        // 子 shell
+        if (token->getType() == TokenType::OPERATOR && token->getValue() == "(")
+        {
+            return parseSubshell();
         }
 
         // 创建命令节点
@@ -258,6 +298,29 @@ namespace dash
             // 查看下一个词法单元
             token = lexer_->peekToken();
 
+            // 进程替换：括号内的命令单独解析，参数位置先放原文
+            if (token->getType() == TokenType::PROCESS_SUBST)
+            {
+                std::string text(token->getValue());
+                Parser inner(shell_);
+                inner.setInput(text.substr(1));
+                auto substituted = inner.parseCommand(false);
+                if (!substituted)
+                {
+                    throw ShellException(ExceptionType::SYNTAX, "Syntax error: empty process substitution");
+                }
+                command->addProcessSubstitution(text[0] + std::string("(") + text.substr(1) + ")",
+                                                text[0] == '>', std::move(substituted));
+                lexer_->nextToken(); // 消耗进程替换词法单元
+                first_arg = false;
+
+                while (parseRedirection(command.get()))
+                {
+                    // 继续解析重定向
+                }
+                continue;
+            }
+
             // 如果是 EOF 或不是单词，结束解析
             if (token->getType() == TokenType::END_OF_INPUT ||
                 (token->getType() != TokenType::WORD && token->getType() != TokenType::ASSIGNMENT))
@@ -265,22 +328,16 @@ namespace dash
                 break;
             }
 
-            // 处理变量赋值
-            if (token->getType() == TokenType::ASSIGNMENT)
+            // 处理变量赋值：只有命令名前面的 name=value 是赋值，之后的是普通参数
+            if (token->getType() == TokenType::ASSIGNMENT && first_arg)
             {
-                if (!first_arg)
-                {
-                    // 变量赋值只能出现在命令前面
-                    break;
-                }
-
-                command->addAssignment(token->getValue());
+                command->addAssignment(std::string(token->getValue()));
                 lexer_->nextToken(); // 消耗赋值词法单元
                 continue;
             }
 
             // 处理普通参数
-            command->addArg(token->getValue());
+            command->addArg(std::string(token->getValue()), token->getSegments());
             lexer_->nextToken(); // 消耗单词词法单元
             first_arg = false;
 
@@ -316,7 +373,7 @@ namespace dash
         int fd = -1;
         if (token->getType() == TokenType::IO_NUMBER)
         {
-            fd = std::stoi(token->getValue());
+            fd = std::stoi(std::string(token->getValue()));
             lexer_->nextToken(); // 消耗 IO 编号
             token = lexer_->peekToken();
         }
@@ -333,7 +390,7 @@ namespace dash
         }
 
         // 获取重定向类型
-        std::string op = token->getValue();
+        std::string op(token->getValue());
         RedirType type;
 
         if (op == "<")
@@ -361,7 +418,7 @@ namespace dash
             type = RedirType::REDIR_OUTPUT_DUP;
             fd = (fd == -1) ? 1 : fd;
         }
-        else if (op == "<<")
+        else if (op == "<<" || op == "<<-")
         {
             type = RedirType::REDIR_HEREDOC;
             fd = (fd == -1) ? 0 : fd;
@@ -380,11 +437,18 @@ namespace dash
             throw ShellException(ExceptionType::SYNTAX, "Syntax error: expected word after redirection operator");
         }
 
-        std::string filename = token->getValue();
+        std::string filename(token->getValue());
+        bool quoted = token->isQuoted();
         lexer_->nextToken(); // 消耗文件名
 
         // 创建重定向
         Redirection redir(type, fd, filename);
+        if (type == RedirType::REDIR_HEREDOC)
+        {
+            // 定界符中有引号或反斜杠时正文原样使用，不展开；正文在下一个换行符之后读取
+            redir.heredoc = std::make_shared<HereDoc>(HereDoc::delimiterOf(filename), !quoted, op == "<<-");
+            lexer_->addHereDoc(redir.heredoc);
+        }
 
         // 添加重定向到节点
         if (node->getType() == NodeType::COMMAND)
@@ -403,10 +467,10 @@ namespace dash
         return true;
     }
 
-    std::unique_ptr<Token> Parser::expectToken(TokenType type, const std::string &error_message)
+    Token Parser::expectToken(TokenType type, const std::string &error_message)
     {
-        std::unique_ptr<Token> token = lexer_->nextToken();
-        if (token->getType() != type)
+        Token token = lexer_->nextToken();
+        if (token.getType() != type)
         {
             throw ShellException(ExceptionType::SYNTAX, error_message);
         }
@@ -431,6 +495,14 @@ namespace dash
         return reserved_words.find(word) != reserved_words.end();
     }
 
+    bool Parser::atListEnd()
+    {
+        const Token *token = lexer_->peekToken();
+        return token->getType() == TokenType::END_OF_INPUT ||
+               (token->getType() == TokenType::OPERATOR && token->getValue() != "(") ||
+               (token->getType() == TokenType::WORD && list_terminators.count(token->getValue()));
+    }
+
     bool Parser::isRedirectionOperator(const Token *token) const
     {
         if (token->getType() != TokenType::OPERATOR)
@@ -438,8 +510,8 @@ namespace dash
             return false;
         }
 
-        const std::string &op = token->getValue();
-        return op == "<" || op == ">" || op == ">>" || op == "<&" || op == ">&" || op == "<<";
+        std::string_view op = token->getValue();
+        return op == "<" || op == ">" || op == ">>" || op == "<&" || op == ">&" || op == "<<" || op == "<<-";
     }
 
     // 以下是复杂控制结构的解析函数，暂时只提供基本实现
@@ -458,7 +530,7 @@ namespace dash
 
         // 期望 then 关键字
         auto token = expectToken(TokenType::WORD, "Syntax error: expected 'then' after condition");
-        if (token->getValue() != "then")
+        if (token.getValue() != "then")
         {
             throw ShellException(ExceptionType::SYNTAX, "Syntax error: expected 'then' after condition");
         }
@@ -488,7 +560,7 @@ namespace dash
 
         // 期望 fi 关键字
         token = expectToken(TokenType::WORD, "Syntax error: expected 'fi' to end if statement");
-        if (token->getValue() != "fi")
+        if (token.getValue() != "fi")
         {
             throw ShellException(ExceptionType::SYNTAX, "Syntax error: expected 'fi' to end if statement");
         }
@@ -506,11 +578,11 @@ namespace dash
 
         // 获取循环变量
         auto token = expectToken(TokenType::WORD, "Syntax error: expected variable name after 'for'");
-        std::string var = token->getValue();
+        std::string var(token.getValue());
 
         // 期望 in 关键字
         token = expectToken(TokenType::WORD, "Syntax error: expected 'in' after variable name");
-        if (token->getValue() != "in")
+        if (token.getValue() != "in")
         {
             throw ShellException(ExceptionType::SYNTAX, "Syntax error: expected 'in' after variable name");
         }
@@ -522,7 +594,7 @@ namespace dash
             const Token* peek_token = lexer_->peekToken();
             if (peek_token->getType() == TokenType::WORD && peek_token->getValue() != "do")
             {
-                words.push_back(peek_token->getValue());
+                words.emplace_back(peek_token->getValue());
                 lexer_->nextToken(); // 消耗单词
             }
             else
@@ -531,9 +603,17 @@ namespace dash
             }
         }
 
+        // 单词列表以分号或换行符结束
+        const Token *separator = lexer_->peekToken();
+        if (separator->getType() == TokenType::OPERATOR && separator->getValue() == ";")
+        {
+            lexer_->nextToken();
+        }
+        skipNewlines();
+
         // 期望 do 关键字
         token = expectToken(TokenType::WORD, "Syntax error: expected 'do' after word list");
-        if (token->getValue() != "do")
+        if (token.getValue() != "do")
         {
             throw ShellException(ExceptionType::SYNTAX, "Syntax error: expected 'do' after word list");
         }
@@ -547,7 +627,7 @@ namespace dash
 
         // 期望 done 关键字
         token = expectToken(TokenType::WORD, "Syntax error: expected 'done' to end for loop");
-        if (token->getValue() != "done")
+        if (token.getValue() != "done")
         {
             throw ShellException(ExceptionType::SYNTAX, "Syntax error: expected 'done' to end for loop");
         }
@@ -570,7 +650,7 @@ namespace dash
 
         // 期望 do 关键字
         auto token = expectToken(TokenType::WORD, "Syntax error: expected 'do' after condition");
-        if (token->getValue() != "do")
+        if (token.getValue() != "do")
         {
             throw ShellException(ExceptionType::SYNTAX, "Syntax error: expected 'do' after condition");
         }
@@ -584,7 +664,7 @@ namespace dash
 
         // 期望 done 关键字
         token = expectToken(TokenType::WORD, "Syntax error: expected 'done' to end while/until loop");
-        if (token->getValue() != "done")
+        if (token.getValue() != "done")
         {
             throw ShellException(ExceptionType::SYNTAX, "Syntax error: expected 'done' to end while/until loop");
         }
@@ -602,11 +682,11 @@ namespace dash
 
         // 获取匹配词
         auto token = expectToken(TokenType::WORD, "Syntax error: expected word after 'case'");
-        std::string word = token->getValue();
+        std::string word(token.getValue());
 
         // 期望 in 关键字
         token = expectToken(TokenType::WORD, "Syntax error: expected 'in' after word");
-        if (token->getValue() != "in")
+        if (token.getValue() != "in")
         {
             throw ShellException(ExceptionType::SYNTAX, "Syntax error: expected 'in' after word");
         }
@@ -637,7 +717,7 @@ namespace dash
                     throw ShellException(ExceptionType::SYNTAX, "Syntax error: expected pattern in case item");
                 }
 
-                patterns.push_back(peek_token->getValue());
+                patterns.emplace_back(peek_token->getValue());
                 lexer_->nextToken(); // 消耗模式
 
                 // 检查是否有更多模式
@@ -695,7 +775,7 @@ namespace dash
 
         // 期望 ) 操作符
         auto token = expectToken(TokenType::OPERATOR, "Syntax error: expected ')' to end subshell");
-        if (token->getValue() != ")")
+        if (token.getValue() != ")")
         {
             throw ShellException(ExceptionType::SYNTAX, "Syntax error: expected ')' to end subshell");
         }
@@ -0,0 +1,915 @@
+/**
+ * @file redirection.cpp
+ * @brief 编译后的重定向计划实现
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include "core/redirection.h"
+#include "utils/error.h"
+#include "utils/io_ring.h"
+#include "variable/variable_manager.h"
+
+namespace dash
+{
+
+    namespace
+    {
+        /**
+         * @brief 解析复制重定向的目标
+         *
+         * @param word 文本，单个数字或 -
+         * @param target 输出参数，目标描述符，- 为 -1
+         * @return bool 是否有效
+         */
+        bool parseTarget(const std::string &word, int &target)
+        {
+            if (word == "-")
+            {
+                target = -1;
+                return true;
+            }
+            if (word.size() == 1 && word[0] >= '0' && word[0] <= '9')
+            {
+                target = word[0] - '0';
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief 展开 Here 文档的正文
+         *
+         * 与双引号中一样，反斜杠只转义 $ ` \ 和换行符：被转义的字符原样保留，反斜杠加换行符
+         * 一起去掉，其余部分交给 VariableManager::expand。命令替换中的反斜杠留给执行它的 shell。
+         *
+         * @param body 正文
+         * @param vars 变量管理器
+         * @return std::string 展开后的正文
+         */
+        std::string expandHereDoc(const std::string &body, const VariableManager &vars)
+        {
+            if (body.find('\\') == std::string::npos)
+            {
+                return vars.expand(body);
+            }
+
+            std::string result;
+            std::string pending; // 还没有展开的一段
+            int depth = 0;       // $( 的嵌套层数
+            bool in_backquote = false;
+            for (size_t i = 0; i < body.size(); ++i)
+            {
+                char c = body[i];
+                char next = i + 1 < body.size() ? body[i + 1] : '\0';
+                if (c == '\\' && depth == 0 && !in_backquote &&
+                    (next == '$' || next == '`' || next == '\\' || next == '\n'))
+                {
+                    result += vars.expand(pending);
+                    pending.clear();
+                    if (next != '\n')
+                    {
+                        result += next;
+                    }
+                    ++i;
+                    continue;
+                }
+
+                if (c == '$' && next == '(' && !in_backquote)
+                {
+                    ++depth;
+                    pending += c;
+                    pending += next;
+                    ++i;
+                    continue;
+                }
+                if (depth > 0 && c == '(')
+                {
+                    ++depth;
+                }
+                else if (depth > 0 && c == ')')
+                {
+                    --depth;
+                }
+                else if (depth == 0 && c == '`')
+                {
+                    in_backquote = !in_backquote;
+                }
+                pending += c;
+            }
+            result += vars.expand(pending);
+            return result;
+        }
+
+        /**
+         * @brief 判断文本是否不需要展开
+         *
+         * @param word 文本
+         * @return bool 不含 $ 和 ` 时返回 true
+         */
+        bool isLiteral(const std::string &word)
+        {
+            return word.find_first_of("$`") == std::string::npos;
+        }
+
+        /**
+         * @brief 把数据全部写入描述符
+         *
+         * @param fd 描述符
+         * @param data 数据
+         * @param size 字节数
+         * @return bool 是否成功
+         */
+        bool writeAll(int fd, const char *data, size_t size)
+        {
+            size_t written = 0;
+            while (written < size)
+            {
+                ssize_t n = write(fd, data + written, size - written);
+                if (n == -1)
+                {
+                    if (errno == EINTR)
+                    {
+                        continue;
+                    }
+                    return false;
+                }
+                written += static_cast<size_t>(n);
+            }
+            return true;
+        }
+
+        /**
+         * @brief 是否是写文件的重定向
+         */
+        bool isOutput(RedirType type)
+        {
+            return type == RedirType::REDIR_OUTPUT || type == RedirType::REDIR_APPEND;
+        }
+
+        /**
+         * @brief 中继向一个输出写数据的方式
+         */
+        enum class RelayMode
+        {
+            SPLICE, // splice(2)，数据不经过用户空间
+            COPY,   // 输出不支持 splice（例如 O_APPEND 的文件）：read/write
+            DEAD    // 写入出错，之后的数据丢弃
+        };
+
+        // 中继进程 read/write 时使用的缓冲区；fork 之后不再分配内存
+        char relay_buffer[64 * 1024];
+
+        /**
+         * @brief 把管道开头的 len 字节移到输出
+         *
+         * 输出出错后仍然读走数据，其他输出不受影响。
+         *
+         * @param source 管道读端
+         * @param output 输出描述符
+         * @param len 字节数，管道中至少有这么多数据
+         * @param mode 写入方式，splice 不可用时改为 COPY，出错时改为 DEAD
+         */
+        void relayChunk(int source, int output, size_t len, RelayMode &mode)
+        {
+            while (len > 0)
+            {
+                if (mode == RelayMode::SPLICE)
+                {
+                    ssize_t n = splice(source, nullptr, output, nullptr, len, SPLICE_F_MOVE);
+                    if (n > 0)
+                    {
+                        len -= static_cast<size_t>(n);
+                    }
+                    else if (n == 0 || errno == EINVAL)
+                    {
+                        mode = RelayMode::COPY;
+                    }
+                    else if (errno != EINTR)
+                    {
+                        mode = RelayMode::DEAD;
+                    }
+                    continue;
+                }
+
+                ssize_t n = read(source, relay_buffer, std::min(len, sizeof(relay_buffer)));
+                if (n == -1 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n <= 0)
+                {
+                    return;
+                }
+                if (mode == RelayMode::COPY && !writeAll(output, relay_buffer, static_cast<size_t>(n)))
+                {
+                    mode = RelayMode::DEAD;
+                }
+                len -= static_cast<size_t>(n);
+            }
+        }
+
+        /**
+         * @brief 多目标输出中继进程的主循环
+         *
+         * 每一轮用 tee(2) 把输入管道中的数据复制到前 N-1 个输出的中转管道（不消耗输入），
+         * 再把输入 splice 到最后一个输出，中转管道 splice 到各自的输出。数据始终留在内核的
+         * 管道缓冲区中。没有中转管道或内核不支持 tee 时退回到 read/write。
+         *
+         * @param input 输入管道读端
+         * @param outputs 输出描述符
+         * @param scratch 中转管道，依次为每个输出（最后一个除外）的读端和写端；为空表示不用 tee
+         * @param modes 每个输出的写入方式
+         */
+        [[noreturn]] void runRelay(int input, const std::vector<int> &outputs, const std::vector<int> &scratch,
+                                   std::vector<RelayMode> &modes)
+        {
+            // 命令被中断时中继仍要把已经写入管道的数据转发完，输入关闭后自己退出
+            signal(SIGINT, SIG_IGN);
+            signal(SIGQUIT, SIG_IGN);
+            signal(SIGTSTP, SIG_IGN);
+            signal(SIGPIPE, SIG_IGN);
+
+            size_t last = outputs.size() - 1;
+            bool use_tee = scratch.size() == 2 * last;
+
+            // 每轮的数据量不超过任何一个管道的容量，tee 到空的中转管道时总能一次写完
+            long chunk = fcntl(input, F_GETPIPE_SZ);
+            for (size_t i = 0; use_tee && i < last; ++i)
+            {
+                chunk = std::min<long>(chunk, fcntl(scratch[2 * i + 1], F_GETPIPE_SZ));
+            }
+            use_tee = use_tee && chunk > 0;
+
+            while (use_tee)
+            {
+                ssize_t n = tee(input, scratch[1], static_cast<size_t>(chunk), 0);
+                if (n == -1 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n <= 0)
+                {
+                    // 输入结束，或者不支持 tee：剩下的数据由下面的循环复制
+                    break;
+                }
+
+                size_t len = static_cast<size_t>(n);
+                for (size_t i = 1; i < last; ++i)
+                {
+                    while (tee(input, scratch[2 * i + 1], len, 0) == -1 && errno == EINTR)
+                    {
+                    }
+                }
+                relayChunk(input, outputs[last], len, modes[last]);
+                for (size_t i = 0; i < last; ++i)
+                {
+                    relayChunk(scratch[2 * i], outputs[i], len, modes[i]);
+                }
+            }
+
+            while (true)
+            {
+                ssize_t n = read(input, relay_buffer, sizeof(relay_buffer));
+                if (n == -1 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (n <= 0)
+                {
+                    break;
+                }
+                for (size_t i = 0; i < outputs.size(); ++i)
+                {
+                    if (modes[i] != RelayMode::DEAD &&
+                        !writeAll(outputs[i], relay_buffer, static_cast<size_t>(n)))
+                    {
+                        modes[i] = RelayMode::DEAD;
+                    }
+                }
+            }
+            _exit(0);
+        }
+
+        /**
+         * @brief 关闭除指定描述符以外的所有描述符
+         *
+         * 中继进程不能持有命令的管道写端或其他管道，否则读者等不到 EOF。
+         *
+         * @param keep 保留的描述符，已排序且不重复
+         */
+        void closeOtherFds(const std::vector<int> &keep)
+        {
+#ifdef SYS_close_range
+            unsigned int next = 0;
+            for (int fd : keep)
+            {
+                if (static_cast<unsigned int>(fd) > next)
+                {
+                    syscall(SYS_close_range, next, static_cast<unsigned int>(fd) - 1, 0);
+                }
+                next = static_cast<unsigned int>(fd) + 1;
+            }
+            syscall(SYS_close_range, next, ~0U, 0);
+#else
+            (void)keep;
+#endif
+        }
+    }
+
+    std::string HereDoc::delimiterOf(std::string_view word)
+    {
+        std::string delimiter;
+        for (size_t i = 0; i < word.size(); ++i)
+        {
+            if (word[i] == '\\' && i + 1 < word.size())
+            {
+                ++i;
+            }
+            delimiter += word[i];
+        }
+        return delimiter;
+    }
+
+    bool RedirectionPlan::SavedFds::save(int fd)
+    {
+        if (saved_[fd] != UNSAVED)
+        {
+            return true;
+        }
+
+        // 副本放在 MAX_FD 以上，不会和之后的重定向冲突，exec 时自动关闭
+        int copy = fcntl(fd, F_DUPFD_CLOEXEC, MAX_FD);
+        if (copy == -1)
+        {
+            if (errno != EBADF)
+            {
+                return false;
+            }
+            copy = CLOSED;
+        }
+        saved_[fd] = copy;
+        return true;
+    }
+
+    void RedirectionPlan::SavedFds::restore()
+    {
+        for (int fd = 0; fd < MAX_FD; ++fd)
+        {
+            if (saved_[fd] == CLOSED)
+            {
+                close(fd);
+            }
+            else if (saved_[fd] != UNSAVED)
+            {
+                dup2(saved_[fd], fd);
+                close(saved_[fd]);
+            }
+            saved_[fd] = UNSAVED;
+        }
+    }
+
+    void RedirectionPlan::add(const Redirection &redir)
+    {
+        if (redir.fd < 0 || redir.fd >= MAX_FD)
+        {
+            throw ShellException(ExceptionType::SYNTAX, "Syntax error: Bad fd number");
+        }
+
+        Step step{redir.type, redir.fd, redir.filename, isLiteral(redir.filename), 0, -1, nullptr, {}, steps_.size()};
+        switch (redir.type)
+        {
+        case RedirType::REDIR_INPUT:
+            step.flags = O_RDONLY;
+            break;
+
+        case RedirType::REDIR_OUTPUT:
+            step.flags = O_WRONLY | O_CREAT | O_TRUNC;
+            break;
+
+        case RedirType::REDIR_APPEND:
+            step.flags = O_WRONLY | O_CREAT | O_APPEND;
+            break;
+
+        case RedirType::REDIR_INPUT_DUP:
+        case RedirType::REDIR_OUTPUT_DUP:
+            if (step.literal && !parseTarget(step.word, step.target_fd))
+            {
+                throw ShellException(ExceptionType::SYNTAX, "Syntax error: Bad fd number");
+            }
+            break;
+
+        case RedirType::REDIR_HEREDOC:
+            step.heredoc = redir.heredoc;
+            break;
+        }
+
+        if (isOutput(step.type))
+        {
+            // 上一个涉及同一描述符的步骤也是输出重定向时，并入它所在的多目标输出组；
+            // 中间有复制这个描述符的步骤（>a 2>&1 >b）时不合并
+            for (size_t i = steps_.size(); i-- > 0;)
+            {
+                const Step &prev = steps_[i];
+                bool reads_fd = (prev.type == RedirType::REDIR_INPUT_DUP || prev.type == RedirType::REDIR_OUTPUT_DUP) &&
+                                (!prev.literal || prev.target_fd == step.fd);
+                if (prev.fd != step.fd && !reads_fd)
+                {
+                    continue;
+                }
+                if (prev.fd == step.fd && isOutput(prev.type))
+                {
+                    step.head = prev.head;
+                    steps_[step.head].outputs.push_back(steps_.size());
+                }
+                break;
+            }
+        }
+
+        steps_.push_back(std::move(step));
+    }
+
+    std::string RedirectionPlan::resolveWord(const Step &step, const VariableManager &vars)
+    {
+        return step.literal ? step.word : vars.expand(step.word);
+    }
+
+    bool RedirectionPlan::resolveTarget(const Step &step, const VariableManager &vars, int &target)
+    {
+        return parseTarget(resolveWord(step, vars), target);
+    }
+
+    int RedirectionPlan::openHereDoc(const Step &step, const RedirectionContext &context)
+    {
+        std::string body;
+        if (step.heredoc)
+        {
+            body = step.heredoc->expand ? expandHereDoc(step.heredoc->body, *context.vars) : step.heredoc->body;
+        }
+
+        int fds[2];
+        if (pipe2(fds, O_CLOEXEC) == -1)
+        {
+            return -1;
+        }
+        int capacity = fcntl(fds[1], F_GETPIPE_SZ);
+        if (capacity != -1 && body.size() <= static_cast<size_t>(capacity))
+        {
+            // 正文一次就能写进管道，写完关闭写端，读者直接读到 EOF
+            int error = IoRing::writeFully(fds[1], body.data(), body.size(), context.io_uring);
+            close(fds[1]);
+            if (error != 0)
+            {
+                close(fds[0]);
+                errno = error;
+                return -1;
+            }
+            return fds[0];
+        }
+        close(fds[0]);
+        close(fds[1]);
+
+        // 正文太大，写入管道会阻塞：放进匿名内存文件
+        int fd = memfd_create("dash-heredoc", MFD_CLOEXEC);
+        if (fd == -1)
+        {
+            return -1;
+        }
+        int error = IoRing::writeFully(fd, body.data(), body.size(), context.io_uring);
+        if (error == 0 && lseek(fd, 0, SEEK_SET) == -1)
+        {
+            error = errno;
+        }
+        if (error != 0)
+        {
+            close(fd);
+            errno = error;
+            return -1;
+        }
+        return fd;
+    }
+
+    bool RedirectionPlan::apply(const RedirectionContext &context, Mode mode, SavedFds *saved) const
+    {
+        const VariableManager &vars = *context.vars;
+        for (const auto &step : steps_)
+        {
+            if (mode == Mode::RESTORE && !saved->save(step.fd))
+            {
+                std::cerr << "dash: " << step.fd << ": " << strerror(errno) << std::endl;
+                saved->restore();
+                return false;
+            }
+
+            int source_fd = -1;  // 复制到 step.fd 的描述符
+            bool owned = false;  // source_fd 用完后是否由这里关闭
+            switch (step.type)
+            {
+            case RedirType::REDIR_INPUT:
+            case RedirType::REDIR_OUTPUT:
+            case RedirType::REDIR_APPEND:
+            {
+                if (context.relays && !step.outputs.empty())
+                {
+                    source_fd = startRelay(step, context);
+                    if (source_fd == -1)
+                    {
+                        if (mode == Mode::RESTORE)
+                        {
+                            saved->restore();
+                        }
+                        return false;
+                    }
+                    owned = true;
+                    break;
+                }
+                if (context.relays && step.head != static_cast<size_t>(&step - steps_.data()))
+                {
+                    // 已经由组的第一个步骤接到中继
+                    continue;
+                }
+
+                std::string filename;
+                source_fd = openFile(step, context, filename, owned);
+                if (source_fd == -1)
+                {
+                    std::cerr << "dash: " << filename << ": " << strerror(errno) << std::endl;
+                    if (mode == Mode::RESTORE)
+                    {
+                        saved->restore();
+                    }
+                    return false;
+                }
+                break;
+            }
+
+            case RedirType::REDIR_INPUT_DUP:
+            case RedirType::REDIR_OUTPUT_DUP:
+            {
+                int target = step.target_fd;
+                if (!step.literal && !resolveTarget(step, vars, target))
+                {
+                    std::cerr << "dash: " << resolveWord(step, vars) << ": Bad fd number" << std::endl;
+                    if (mode == Mode::RESTORE)
+                    {
+                        saved->restore();
+                    }
+                    return false;
+                }
+
+                if (target == -1)
+                {
+                    close(step.fd);
+                }
+                else if (target != step.fd && dup2(target, step.fd) == -1)
+                {
+                    std::cerr << "dash: " << target << ": " << strerror(errno) << std::endl;
+                    if (mode == Mode::RESTORE)
+                    {
+                        saved->restore();
+                    }
+                    return false;
+                }
+                continue;
+            }
+
+            case RedirType::REDIR_HEREDOC:
+                source_fd = openHereDoc(step, context);
+                if (source_fd == -1)
+                {
+                    std::cerr << "dash: here-document: " << strerror(errno) << std::endl;
+                    if (mode == Mode::RESTORE)
+                    {
+                        saved->restore();
+                    }
+                    return false;
+                }
+                owned = true;
+                break;
+            }
+
+            if (source_fd == step.fd)
+            {
+                // 原描述符是关闭的，新打开的正好分到了同一个号：去掉 O_CLOEXEC
+                fcntl(step.fd, F_SETFD, 0);
+            }
+            else
+            {
+                dup2(source_fd, step.fd);
+                if (owned)
+                {
+                    close(source_fd);
+                }
+            }
+        }
+
+        return true;
+    }
+
+    bool RedirectionPlan::buildFileActions(const RedirectionContext &context, std::vector<FileAction> &actions,
+                                           std::vector<int> &opened_fds) const
+    {
+        const VariableManager &vars = *context.vars;
+        actions.reserve(actions.size() + steps_.size());
+
+        for (const auto &step : steps_)
+        {
+            switch (step.type)
+            {
+            case RedirType::REDIR_INPUT:
+            case RedirType::REDIR_OUTPUT:
+            case RedirType::REDIR_APPEND:
+            {
+                if (context.relays && !step.outputs.empty())
+                {
+                    // 多目标输出：在调用进程中打开所有文件并启动中继，子进程只接管道写端
+                    int relay_fd = startRelay(step, context);
+                    if (relay_fd == -1)
+                    {
+                        for (int opened : opened_fds)
+                        {
+                            close(opened);
+                        }
+                        opened_fds.clear();
+                        return false;
+                    }
+                    opened_fds.push_back(relay_fd);
+                    actions.emplace_back(FileAction::DUP2, step.fd, relay_fd);
+                    break;
+                }
+                if (context.relays && step.head != static_cast<size_t>(&step - steps_.data()))
+                {
+                    break;
+                }
+
+                std::string filename = resolveWord(step, vars);
+                if (context.dev_null_fd >= 0 && filename == "/dev/null")
+                {
+                    actions.emplace_back(FileAction::DUP2, step.fd, context.dev_null_fd);
+                }
+                else if (context.cache && (step.flags & O_WRONLY))
+                {
+                    // 在父进程中打开（或取出缓存的描述符），子进程只需复制
+                    bool cached = false;
+                    int fd = context.cache->open(filename, step.flags, cached);
+                    if (fd == -1)
+                    {
+                        std::cerr << "dash: " << filename << ": " << strerror(errno) << std::endl;
+                        for (int opened : opened_fds)
+                        {
+                            close(opened);
+                        }
+                        opened_fds.clear();
+                        return false;
+                    }
+                    if (!cached)
+                    {
+                        opened_fds.push_back(fd);
+                    }
+                    actions.emplace_back(FileAction::DUP2, step.fd, fd);
+                }
+                else
+                {
+                    actions.emplace_back(FileAction::OPEN, step.fd, -1, filename, step.flags, 0666);
+                }
+                break;
+            }
+
+            case RedirType::REDIR_INPUT_DUP:
+            case RedirType::REDIR_OUTPUT_DUP:
+            {
+                int target = step.target_fd;
+                if (!step.literal && !resolveTarget(step, vars, target))
+                {
+                    // 无效的目标描述符，交给 dup2 报告 EBADF
+                    actions.emplace_back(FileAction::DUP2, step.fd, -1);
+                }
+                else if (target == -1)
+                {
+                    actions.emplace_back(FileAction::CLOSE, step.fd);
+                }
+                else
+                {
+                    actions.emplace_back(FileAction::DUP2, step.fd, target);
+                }
+                break;
+            }
+
+            case RedirType::REDIR_HEREDOC:
+            {
+                // 在父进程中准备好正文，子进程只需复制描述符
+                int doc_fd = openHereDoc(step, context);
+                if (doc_fd == -1)
+                {
+                    std::cerr << "dash: here-document: " << strerror(errno) << std::endl;
+                    for (int opened : opened_fds)
+                    {
+                        close(opened);
+                    }
+                    opened_fds.clear();
+                    return false;
+                }
+                opened_fds.push_back(doc_fd);
+                actions.emplace_back(FileAction::DUP2, step.fd, doc_fd);
+                break;
+            }
+            }
+        }
+
+        return true;
+    }
+
+    int RedirectionPlan::openFile(const Step &step, const RedirectionContext &context, std::string &filename,
+                                  bool &owned)
+    {
+        filename = resolveWord(step, *context.vars);
+        owned = false;
+        if (context.dev_null_fd >= 0 && filename == "/dev/null")
+        {
+            // >/dev/null 2>&1 很常见，复制缓存的描述符，不再打开文件
+            return context.dev_null_fd;
+        }
+
+        if (context.cache && (step.flags & O_WRONLY))
+        {
+            bool cached = false;
+            int fd = context.cache->open(filename, step.flags, cached);
+            owned = fd != -1 && !cached;
+            return fd;
+        }
+
+        int fd = ::open(filename.c_str(), step.flags | O_CLOEXEC, 0666);
+        owned = fd != -1;
+        return fd;
+    }
+
+    int RedirectionPlan::startRelay(const Step &step, const RedirectionContext &context) const
+    {
+        std::vector<int> outputs;  // 按重定向顺序排列的输出
+        std::vector<int> owned_fds; // 父进程在启动中继后关闭的描述符
+        auto closeOwned = [&owned_fds]()
+        {
+            for (int fd : owned_fds)
+            {
+                close(fd);
+            }
+        };
+
+        outputs.reserve(step.outputs.size() + 1);
+        for (size_t i = 0; i <= step.outputs.size(); ++i)
+        {
+            const Step &member = i == 0 ? step : steps_[step.outputs[i - 1]];
+            std::string filename;
+            bool owned = false;
+            int fd = openFile(member, context, filename, owned);
+            if (fd == -1)
+            {
+                std::cerr << "dash: " << filename << ": " << strerror(errno) << std::endl;
+                closeOwned();
+                return -1;
+            }
+            outputs.push_back(fd);
+            if (owned)
+            {
+                owned_fds.push_back(fd);
+            }
+        }
+
+        int input[2];
+        if (pipe2(input, O_CLOEXEC) == -1)
+        {
+            std::cerr << "dash: pipe: " << strerror(errno) << std::endl;
+            closeOwned();
+            return -1;
+        }
+        owned_fds.push_back(input[0]);
+
+        // 中转管道建不出来时中继退回到 read/write，不算失败
+        std::vector<int> scratch;
+        for (size_t i = 1; i < outputs.size(); ++i)
+        {
+            int fds[2];
+            if (pipe2(fds, O_CLOEXEC) == -1)
+            {
+                for (int fd : scratch)
+                {
+                    close(fd);
+                }
+                scratch.clear();
+                break;
+            }
+            scratch.push_back(fds[0]);
+            scratch.push_back(fds[1]);
+        }
+        owned_fds.insert(owned_fds.end(), scratch.begin(), scratch.end());
+
+        // fork 之后子进程只做系统调用，需要的内存都在这里准备好
+        std::vector<int> keep = outputs;
+        keep.insert(keep.end(), scratch.begin(), scratch.end());
+        keep.push_back(input[0]);
+        keep.push_back(STDERR_FILENO);
+        std::sort(keep.begin(), keep.end());
+        keep.erase(std::unique(keep.begin(), keep.end()), keep.end());
+        std::vector<RelayMode> modes(outputs.size(), RelayMode::SPLICE);
+
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            closeOtherFds(keep);
+            runRelay(input[0], outputs, scratch, modes);
+        }
+        int saved_errno = errno;
+        closeOwned();
+        if (pid == -1)
+        {
+            std::cerr << "dash: fork: " << strerror(saved_errno) << std::endl;
+            close(input[1]);
+            return -1;
+        }
+
+        context.relays->push_back(pid);
+        return input[1];
+    }
+
+    void RedirectionPlan::waitRelays(std::vector<pid_t> &relays)
+    {
+        for (pid_t pid : relays)
+        {
+            while (waitpid(pid, nullptr, 0) == -1 && errno == EINTR)
+            {
+            }
+        }
+        relays.clear();
+    }
+
+    int RedirectionCache::open(const std::string &path, int flags, bool &cached)
+    {
+        // 只有追加写共享偏移量才与重新打开等价；> 每次都要新的打开文件描述，
+        // 否则截断会影响仍在运行的上一次写入者
+        if (!(flags & O_APPEND))
+        {
+            cached = false;
+            return ::open(path.c_str(), flags | O_CLOEXEC, 0666);
+        }
+
+        struct stat st;
+        bool exists = stat(path.c_str(), &st) == 0;
+        for (auto it = entries_.begin(); it != entries_.end(); ++it)
+        {
+            if (it->flags != flags || it->path != path)
+            {
+                continue;
+            }
+            if (exists && st.st_dev == it->dev && st.st_ino == it->ino)
+            {
+                cached = true;
+                return it->fd;
+            }
+            // 文件被删除或替换，或者 cd 后相对路径指向了别的文件
+            close(it->fd);
+            entries_.erase(it);
+            break;
+        }
+
+        cached = false;
+        int fd = ::open(path.c_str(), flags | O_CLOEXEC, 0666);
+        if (fd == -1 || entries_.size() >= MAX_ENTRIES)
+        {
+            return fd;
+        }
+
+        // 只缓存普通文件：终端、管道和设备每次打开可能有副作用
+        if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode))
+        {
+            return fd;
+        }
+        int high = fcntl(fd, F_DUPFD_CLOEXEC, RedirectionPlan::MAX_FD);
+        if (high == -1)
+        {
+            return fd;
+        }
+        close(fd);
+        entries_.push_back({path, flags, high, st.st_dev, st.st_ino});
+        cached = true;
+        return high;
+    }
+
+    void RedirectionCache::clear()
+    {
+        for (const auto &entry : entries_)
+        {
+            close(entry.fd);
+        }
+        entries_.clear();
+    }
+
+} // namespace dash
@@ -0,0 +1,707 @@
+/**
+ * @file server.cpp
+ * @brief Shell 服务模式实现
+ */
+
+#include <iostream>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "core/server.h"
+#include "core/shell.h"
+#include "core/parser.h"
+#include "core/executor.h"
+#include "core/node.h"
+#include "variable/variable_manager.h"
+#include "utils/error.h"
+#include "utils/fd_channel.h"
+
+extern char **environ;
+
+namespace dash
+{
+
+    namespace
+    {
+
+        /**
+         * @brief 可以在服务进程中直接执行的内置命令
+         *
+         * 只包含不读写 shell 状态、不依赖当前目录和环境的命令。
+         */
+        const char *const IN_PROCESS_BUILTINS[] = {"echo"};
+
+        /**
+         * @brief 收到 SIGTERM 时设置
+         */
+        volatile sig_atomic_t received_sigterm = 0;
+
+        void serverSigtermHandler(int)
+        {
+            received_sigterm = 1;
+        }
+
+        /**
+         * @brief 客户端等待期间收到的待转发信号
+         */
+        volatile sig_atomic_t pending_client_signal = 0;
+
+        void clientSignalHandler(int signo)
+        {
+            pending_client_signal = signo;
+        }
+
+        /**
+         * @brief 把等待状态转换为 shell 退出状态码
+         */
+        int exitStatusOf(int status)
+        {
+            if (WIFEXITED(status))
+            {
+                return WEXITSTATUS(status);
+            }
+            if (WIFSIGNALED(status))
+            {
+                return 128 + WTERMSIG(status);
+            }
+            return 1;
+        }
+
+        /**
+         * @brief 发送退出状态给客户端
+         */
+        void sendStatus(int conn, int status)
+        {
+            int32_t value = status;
+            sendFully(conn, &value, sizeof(value));
+        }
+
+        void closeAll(const std::vector<int> &fds)
+        {
+            for (int fd : fds)
+            {
+                close(fd);
+            }
+        }
+
+    } // namespace
+
+    ShellServer::ShellServer(Shell *shell, const std::string &socket_path)
+        : shell_(shell), socket_path_(socket_path), listen_fd_(-1)
+    {
+    }
+
+    ShellServer::~ShellServer()
+    {
+        for (const auto &pair : running_)
+        {
+            if (pair.second != -1)
+            {
+                close(pair.second);
+            }
+        }
+        for (const auto &pair : pending_)
+        {
+            close(pair.first);
+        }
+        if (listen_fd_ != -1)
+        {
+            close(listen_fd_);
+            unlink(socket_path_.c_str());
+        }
+    }
+
+    int ShellServer::run()
+    {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (socket_path_.size() >= sizeof(addr.sun_path))
+        {
+            std::cerr << "dash: --serve: " << socket_path_ << ": " << strerror(ENAMETOOLONG) << std::endl;
+            return 2;
+        }
+        strcpy(addr.sun_path, socket_path_.c_str());
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+        // 上一次运行留下的套接字文件；能连接上说明另一个服务还在使用这个路径，不能接管
+        struct stat st;
+        if (fd != -1 && lstat(socket_path_.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        {
+            if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == 0)
+            {
+                std::cerr << "dash: --serve: " << socket_path_ << ": " << strerror(EADDRINUSE) << std::endl;
+                close(fd);
+                return 2;
+            }
+            if (errno == ECONNREFUSED)
+            {
+                unlink(socket_path_.c_str());
+            }
+        }
+
+        // 套接字文件只允许所有者连接；绑定时临时收紧 umask，避免出现可被其他用户连接的窗口
+        bool bound = false;
+        if (fd != -1)
+        {
+            mode_t old_mask = umask(0177);
+            bound = bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == 0;
+            int saved_errno = errno;
+            umask(old_mask);
+            errno = saved_errno;
+        }
+        if (!bound || listen(fd, SOMAXCONN) == -1)
+        {
+            std::cerr << "dash: --serve: " << socket_path_ << ": " << strerror(errno) << std::endl;
+            if (fd != -1)
+            {
+                close(fd);
+            }
+            return 2;
+        }
+        listen_fd_ = fd;
+
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = serverSigtermHandler;
+        sigaction(SIGTERM, &sa, nullptr);
+
+        // 只在 ppoll 中接收这些信号，避免检查标志和进入等待之间丢失唤醒
+        sigset_t blocked, wait_mask;
+        sigemptyset(&blocked);
+        sigaddset(&blocked, SIGCHLD);
+        sigaddset(&blocked, SIGINT);
+        sigaddset(&blocked, SIGTERM);
+        sigprocmask(SIG_BLOCK, &blocked, &wait_mask);
+        sigdelset(&wait_mask, SIGCHLD);
+        sigdelset(&wait_mask, SIGINT);
+        sigdelset(&wait_mask, SIGTERM);
+
+        while (!received_sigterm && !Shell::received_sigint)
+        {
+            std::vector<struct pollfd> pfds;
+            std::vector<pid_t> owners;
+            pfds.push_back({listen_fd_, POLLIN, 0});
+            owners.push_back(-1);
+            for (const auto &pair : running_)
+            {
+                if (pair.second != -1)
+                {
+                    pfds.push_back({pair.second, POLLIN, 0});
+                    owners.push_back(pair.first);
+                }
+            }
+            size_t first_pending = pfds.size();
+            for (const auto &pair : pending_)
+            {
+                pfds.push_back({pair.first, POLLIN, 0});
+            }
+
+            int ready = ppoll(pfds.data(), pfds.size(), nullptr, &wait_mask);
+            Shell::received_sigchld = 0;
+            reapChildren();
+            if (ready <= 0)
+            {
+                continue;
+            }
+
+            for (size_t i = 1; i < first_pending; ++i)
+            {
+                if (pfds[i].revents != 0)
+                {
+                    handleClientInput(owners[i]);
+                }
+            }
+            for (size_t i = first_pending; i < pfds.size(); ++i)
+            {
+                if (pfds[i].revents != 0)
+                {
+                    receiveRequest(pfds[i].fd);
+                }
+            }
+            if (pfds[0].revents & POLLIN)
+            {
+                acceptClient();
+            }
+        }
+
+        sigprocmask(SIG_UNBLOCK, &blocked, nullptr);
+        return 0;
+    }
+
+    void ShellServer::acceptClient()
+    {
+        int conn = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (conn == -1)
+        {
+            return;
+        }
+
+        // 客户端的命令以服务进程的身份运行，只接受同一用户的连接
+        struct ucred cred;
+        socklen_t cred_len = sizeof(cred);
+        if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) == -1 || cred.uid != geteuid())
+        {
+            close(conn);
+            return;
+        }
+
+        // 请求一般已经随连接到达；没有到达的连接留在 pending_ 中由 poll 等待，
+        // 连接后不发送数据的客户端不会阻塞其他请求
+        pending_.try_emplace(conn);
+        receiveRequest(conn);
+    }
+
+    void ShellServer::receiveRequest(int conn)
+    {
+        auto it = pending_.find(conn);
+        if (it == pending_.end())
+        {
+            return;
+        }
+
+        MessageReceiver::Status status = it->second.receive(conn);
+        if (status == MessageReceiver::Status::PENDING)
+        {
+            return;
+        }
+
+        std::string body;
+        std::vector<int> fds;
+        if (status == MessageReceiver::Status::COMPLETE)
+        {
+            it->second.take(body, fds);
+        }
+        pending_.erase(it);
+        if (status == MessageReceiver::Status::FAILED)
+        {
+            close(conn);
+            return;
+        }
+        handleRequest(conn, body, fds);
+    }
+
+    void ShellServer::handleRequest(int conn, const std::string &body, const std::vector<int> &fds)
+    {
+        MessageReader reader(body);
+        std::string command = reader.getString();
+        std::vector<std::string> env = reader.getStrings();
+        std::vector<int> targets;
+        for (size_t i = 0; i < fds.size(); ++i)
+        {
+            targets.push_back(static_cast<int>(reader.getInt()));
+        }
+        if (!reader.ok())
+        {
+            closeAll(fds);
+            close(conn);
+            return;
+        }
+
+        // 只调用无状态内置命令的请求不需要 fork；解析失败的请求交给子进程报告错误
+        std::unique_ptr<Node> node;
+        try
+        {
+            shell_->getParser()->setInput(command);
+            node = shell_->getParser()->parseCommand(false);
+        }
+        catch (const ShellException &)
+        {
+            node.reset();
+        }
+
+        if (node && canRunInProcess(node.get(), fds, targets))
+        {
+            int status = runInProcess(node.get(), fds, targets);
+            closeAll(fds);
+            sendStatus(conn, status);
+            close(conn);
+            return;
+        }
+
+        pid_t pid = shell_->getExecutor()->forkProcess();
+        if (pid == 0)
+        {
+            close(conn);
+            runChild(command, env, fds, targets);
+        }
+
+        closeAll(fds);
+        if (pid == -1)
+        {
+            std::cerr << "dash: --serve: fork: " << strerror(errno) << std::endl;
+            sendStatus(conn, 2);
+            close(conn);
+            return;
+        }
+        running_[pid] = conn;
+    }
+
+    bool ShellServer::canRunInProcess(const Node *node, const std::vector<int> &fds,
+                                      const std::vector<int> &targets) const
+    {
+        if (node->getType() != NodeType::COMMAND)
+        {
+            return false;
+        }
+
+        const CommandNode *command = static_cast<const CommandNode *>(node);
+        const std::vector<std::string> &args = command->getArgs();
+        if (args.empty() || !command->getAssignments().empty() || !command->getRedirections().empty() ||
+            command->isBackground())
+        {
+            return false;
+        }
+
+        bool known = false;
+        for (const char *name : IN_PROCESS_BUILTINS)
+        {
+            if (args[0] == name)
+            {
+                known = true;
+                break;
+            }
+        }
+        if (!known)
+        {
+            return false;
+        }
+
+        // 需要展开的参数依赖客户端的环境，词法分析时已经标记出来
+        if (!command->getArgExpansions().empty())
+        {
+            return false;
+        }
+
+        // 输出到管道或套接字时可能阻塞整个服务，交给子进程
+        for (size_t i = 0; i < fds.size(); ++i)
+        {
+            if (targets[i] != STDOUT_FILENO && targets[i] != STDERR_FILENO)
+            {
+                continue;
+            }
+            struct stat st;
+            if (fstat(fds[i], &st) == -1 || S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int ShellServer::runInProcess(const Node *node, const std::vector<int> &fds, const std::vector<int> &targets)
+    {
+        std::cout.flush();
+        std::cerr.flush();
+
+        // 临时换上客户端的标准输入输出
+        int saved[3];
+        for (int fd = 0; fd < 3; ++fd)
+        {
+            saved[fd] = fcntl(fd, F_DUPFD_CLOEXEC, 10);
+            close(fd);
+        }
+        for (size_t i = 0; i < fds.size(); ++i)
+        {
+            if (targets[i] >= 0 && targets[i] < 3)
+            {
+                dup2(fds[i], targets[i]);
+            }
+        }
+
+        struct sigaction ignore, old_sigpipe;
+        memset(&ignore, 0, sizeof(ignore));
+        ignore.sa_handler = SIG_IGN;
+        sigaction(SIGPIPE, &ignore, &old_sigpipe);
+
+        int status = shell_->getExecutor()->execute(node);
+        std::cout.flush();
+        std::cerr.flush();
+        std::cout.clear();
+        std::cerr.clear();
+
+        sigaction(SIGPIPE, &old_sigpipe, nullptr);
+
+        for (int fd = 0; fd < 3; ++fd)
+        {
+            if (saved[fd] != -1)
+            {
+                dup2(saved[fd], fd);
+                close(saved[fd]);
+            }
+            else
+            {
+                close(fd);
+            }
+        }
+        return status;
+    }
+
+    void ShellServer::runChild(const std::string &command, const std::vector<std::string> &env,
+                               const std::vector<int> &fds, const std::vector<int> &targets)
+    {
+        close(listen_fd_);
+        for (const auto &pair : running_)
+        {
+            if (pair.second != -1)
+            {
+                close(pair.second);
+            }
+        }
+        // 其他客户端的连接和已收到的描述符，留着会让它们等不到 EOF
+        for (const auto &pair : pending_)
+        {
+            close(pair.first);
+        }
+        pending_.clear();
+
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = SIG_DFL;
+        sigaction(SIGTERM, &sa, nullptr);
+        sigset_t empty_mask;
+        sigemptyset(&empty_mask);
+        sigprocmask(SIG_SETMASK, &empty_mask, nullptr);
+
+        // 接收到的描述符都在 3 以上（服务进程的 0-2 一直打开），不会与目标位置冲突
+        bool present[3] = {false, false, false};
+        for (size_t i = 0; i < fds.size(); ++i)
+        {
+            if (targets[i] < 0)
+            {
+                if (fchdir(fds[i]) == -1)
+                {
+                    _exit(2);
+                }
+            }
+            else if (targets[i] < 3 && dup2(fds[i], targets[i]) != -1)
+            {
+                present[targets[i]] = true;
+            }
+            close(fds[i]);
+        }
+        for (int fd = 0; fd < 3; ++fd)
+        {
+            if (!present[fd])
+            {
+                close(fd);
+            }
+        }
+
+        shell_->getVariableManager()->importEnvironment(env);
+
+        int status;
+        try
+        {
+            status = shell_->executeString(command, Executor::EXEC_TAIL);
+        }
+        catch (const ShellException &e)
+        {
+            if (e.getType() == ExceptionType::EXIT)
+            {
+                status = shell_->getExitStatus();
+            }
+            else
+            {
+                std::cerr << e.getTypeString() << ": " << e.what() << std::endl;
+                status = 2;
+            }
+        }
+        std::cout.flush();
+        std::cerr.flush();
+        _exit(status);
+    }
+
+    void ShellServer::handleClientInput(pid_t pid)
+    {
+        auto it = running_.find(pid);
+        if (it == running_.end() || it->second == -1)
+        {
+            return;
+        }
+
+        int32_t signo;
+        if (readFully(it->second, &signo, sizeof(signo)))
+        {
+            if (signo > 0 && signo < NSIG)
+            {
+                kill(pid, signo);
+            }
+            return;
+        }
+
+        // 客户端已经退出，结束它的命令
+        kill(pid, SIGHUP);
+        close(it->second);
+        it->second = -1;
+    }
+
+    void ShellServer::reapChildren()
+    {
+        for (auto it = running_.begin(); it != running_.end();)
+        {
+            int status;
+            if (waitpid(it->first, &status, WNOHANG) <= 0)
+            {
+                ++it;
+                continue;
+            }
+            if (it->second != -1)
+            {
+                sendStatus(it->second, exitStatusOf(status));
+                close(it->second);
+            }
+            it = running_.erase(it);
+        }
+    }
+
+    bool getClientRequest(int argc, char *argv[], std::string &socket_path, std::string &command)
+    {
+        bool has_command = false;
+        bool has_socket = false;
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg == "-c" && i + 1 < argc && !has_command)
+            {
+                command = argv[++i];
+                has_command = true;
+            }
+            else if (arg == "--client" && i + 1 < argc && !has_socket)
+            {
+                socket_path = argv[++i];
+                has_socket = true;
+            }
+            else
+            {
+                // 其他选项和参数只有本地 shell 支持
+                return false;
+            }
+        }
+
+        if (!has_socket)
+        {
+            const char *server = getenv("DASH_SERVER");
+            if (server && *server)
+            {
+                socket_path = server;
+                has_socket = true;
+            }
+        }
+        return has_command && has_socket;
+    }
+
+    int runClient(const std::string &socket_path, const std::string &command)
+    {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(addr.sun_path))
+        {
+            return -1;
+        }
+        strcpy(addr.sun_path, socket_path.c_str());
+
+        int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (sock == -1)
+        {
+            return -1;
+        }
+        if (connect(sock, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) == -1)
+        {
+            close(sock);
+            return -1;
+        }
+
+        // 传递标准输入输出和当前目录
+        std::vector<int> fds;
+        std::vector<int> targets;
+        for (int fd = 0; fd < 3; ++fd)
+        {
+            if (fcntl(fd, F_GETFD) != -1)
+            {
+                fds.push_back(fd);
+                targets.push_back(fd);
+            }
+        }
+        int cwd_fd = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+        if (cwd_fd != -1)
+        {
+            fds.push_back(cwd_fd);
+            targets.push_back(-1);
+        }
+
+        MessageWriter writer;
+        writer.putString(command);
+        std::vector<std::string> env;
+        for (char **entry = environ; entry && *entry; ++entry)
+        {
+            env.push_back(*entry);
+        }
+        writer.putStrings(env);
+        for (int target : targets)
+        {
+            writer.putInt(target);
+        }
+
+        bool sent = sendMessage(sock, writer.data(), fds);
+        if (cwd_fd != -1)
+        {
+            close(cwd_fd);
+        }
+        if (!sent)
+        {
+            close(sock);
+            return -1;
+        }
+
+        // 等待期间把终端信号转发给执行命令的进程
+        struct sigaction sa;
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = clientSignalHandler;
+        sigaction(SIGINT, &sa, nullptr);
+        sigaction(SIGQUIT, &sa, nullptr);
+        sigaction(SIGTERM, &sa, nullptr);
+        sigaction(SIGHUP, &sa, nullptr);
+
+        int32_t status = 0;
+        size_t received = 0;
+        while (received < sizeof(status))
+        {
+            ssize_t n = read(sock, reinterpret_cast<char *>(&status) + received, sizeof(status) - received);
+            if (n > 0)
+            {
+                received += static_cast<size_t>(n);
+            }
+            else if (n == -1 && errno == EINTR)
+            {
+                int32_t signo = pending_client_signal;
+                pending_client_signal = 0;
+                if (signo != 0)
+                {
+                    sendFully(sock, &signo, sizeof(signo));
+                }
+            }
+            else
+            {
+                std::cerr << "dash: --client: " << socket_path << ": connection closed" << std::endl;
+                close(sock);
+                return 2;
+            }
+        }
+
+        close(sock);
+        return status;
+    }
+
+} // namespace dash
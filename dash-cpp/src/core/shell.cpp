@@ -6,14 +6,23 @@
 #include <iostream>
 #include <unistd.h>
 #include <signal.h>
+#include <cstdlib>
 #include <cstring>
 #include <cerrno> // 需要包含 errno
 #include <sys/wait.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
 #include <vector>
 #include "core/shell.h"
 #include "core/input.h"
 #include "core/parser.h"
 #include "core/executor.h"
+#include "core/server.h"
+#include "core/options.h"
+#include "core/parallel_lexer.h"
 #include "variable/variable_manager.h"
 #include "job/job_control.h"
 #include "job/bg_job_adapter.h" // 添加适配器头文件
@@ -52,13 +61,16 @@ namespace dash
     }
 
     Shell::Shell()
-        : variable_manager_(std::make_unique<VariableManager>(this)),
+        : options_(std::make_unique<ShellOptions>()),
+          variable_manager_(std::make_unique<VariableManager>(this)),
           parser_(std::make_unique<Parser>(this)),
           executor_(std::make_unique<Executor>(this)),
           job_control_(std::make_unique<JobControl>(this)),
           interactive_(false),
           exit_requested_(false),
-          exit_status_(0)
+          exit_status_(0),
+          use_zygote_(false),
+          lex_threads_(0)
     {
         // 创建输入处理器
         input_ = std::make_unique<InputHandler>(this);
@@ -112,12 +124,24 @@ namespace dash
             return 1;
         }
 
+        // 在读入任何脚本之前启动辅助进程，此时 fork 的代价最小
+        if (use_zygote_ && !executor_->startZygote())
+        {
+            std::cerr << "dash: --zygote: " << strerror(errno) << std::endl;
+        }
+
         // 检查是否是交互式模式
         interactive_ = isatty(STDIN_FILENO) && script_file_.empty() && command_string_.empty();
 
         // 设置环境变量
         setupEnvironment();
 
+        if (!serve_socket_.empty())
+        {
+            ShellServer server(this, serve_socket_);
+            return server.run();
+        }
+
         // 主循环
         if (!script_file_.empty() || !command_string_.empty())
         {
@@ -155,6 +179,36 @@ namespace dash
                     return false;
                 }
             }
+            else if (arg == "--zygote")
+            {
+                use_zygote_ = true;
+            }
+            else if (arg == "--lex-threads")
+            {
+                char *end = nullptr;
+                long threads = i + 1 < argc ? strtol(argv[i + 1], &end, 10) : -1;
+                if (threads < 0 || end == argv[i + 1] || *end != '\0')
+                {
+                    std::cerr << "dash: --lex-threads: option requires a number" << std::endl;
+                    return false;
+                }
+                lex_threads_ = static_cast<size_t>(threads);
+                ++i;
+            }
+            else if (arg == "--serve" || arg == "--client")
+            {
+                if (i + 1 >= argc)
+                {
+                    std::cerr << "dash: " << arg << ": option requires an argument" << std::endl;
+                    return false;
+                }
+                // 无法连接服务时 --client 退回到本地执行
+                if (arg == "--serve")
+                {
+                    serve_socket_ = argv[i + 1];
+                }
+                ++i;
+            }
             else if (arg[0] == '-')
             {
                 std::cerr << "dash: " << arg << ": invalid option" << std::endl;
@@ -256,16 +310,15 @@ namespace dash
                 // 3. 执行命令
                 // 在执行期间阻塞SIGCHLD，防止在操作作业列表时出现竞态条件
                 sigprocmask(SIG_BLOCK, &block_mask, &orig_mask);
-                if (command->getType() == NodeType::PIPE) {
-                    execute_pipeline(static_cast<const PipeNode*>(command.get()));
-                } else {
-                    executor_->execute(command.get());
-                }
+                executor_->execute(command.get());
                 sigprocmask(SIG_SETMASK, &orig_mask, nullptr);
             }
             catch (const ShellException &e)
             {
-                std::cerr << e.getTypeString() << ": " << e.what() << std::endl;
+                if (e.getType() != ExceptionType::EXIT)
+                {
+                    std::cerr << e.getTypeString() << ": " << e.what() << std::endl;
+                }
                 // 确保在异常情况下恢复信号掩码
                 sigprocmask(SIG_SETMASK, &orig_mask, nullptr);
             }
@@ -287,47 +340,30 @@ namespace dash
         {
             if (!script_file_.empty())
             {
-                input_->pushFile(script_file_, InputHandler::IF_NONE);
                 for (size_t i = 0; i < script_args_.size(); ++i)
                 {
                     variable_manager_->set(std::to_string(i), script_args_[i]);
                 }
-                variable_manager_->set("#", std::to_string(script_args_.size()));
+                variable_manager_->set("#", std::to_string(script_args_.size() - 1));
 
-                while (!exit_requested_ && !input_->isEOF())
+                if (!runTokenizedScript())
                 {
-                    std::string line = input_->readLine(false);
-                    if (!line.empty())
-                    {
-                        parser_->setInput(line);
-                        std::unique_ptr<Node> command = parser_->parseCommand(false);
-                        if (command)
-                        {
-                            if (command->getType() == NodeType::PIPE) {
-                                execute_pipeline(static_cast<const PipeNode*>(command.get()));
-                            } else {
-                                executor_->execute(command.get());
-                            }
-                        }
-                    }
+                    input_->pushFile(script_file_, InputHandler::IF_NONE);
+                    runLines();
                 }
             }
             else if (!command_string_.empty())
             {
-                parser_->setInput(command_string_);
-                std::unique_ptr<Node> command = parser_->parseCommand(false);
-                if (command)
-                {
-                    if (command->getType() == NodeType::PIPE) {
-                        execute_pipeline(static_cast<const PipeNode*>(command.get()));
-                    } else {
-                        executor_->execute(command.get());
-                    }
-                }
+                // 执行完命令字符串 shell 就退出，最后一条外部命令直接 exec
+                exit_status_ = executeString(command_string_, Executor::EXEC_TAIL);
             }
         }
         catch (const ShellException &e)
         {
+            if (e.getType() == ExceptionType::EXIT)
+            {
+                return exit_status_;
+            }
             std::cerr << e.getTypeString() << ": " << e.what() << std::endl;
             return 1;
         }
@@ -339,220 +375,206 @@ namespace dash
         return exit_status_;
     }
 
-    void Shell::displayPrompt()
+    void Shell::runLines()
     {
-        // 显示提示符 (无变化)
-        std::string ps1 = variable_manager_->get("PS1");
-        if (ps1.empty())
+        while (!exit_requested_ && !input_->isEOF())
         {
-            ps1 = "$ ";
+            std::string line = input_->readLine(false);
+            if (!line.empty())
+            {
+                int status = executeString(line, Executor::EXEC_NONE, true);
+                if (!exit_requested_)
+                {
+                    exit_status_ = status;
+                }
+            }
         }
-        std::cout << ps1 << std::flush;
     }
 
-    void Shell::exit(int status)
+    bool Shell::runTokenizedScript()
     {
-        exit_requested_ = true;
-        exit_status_ = status;
-    }
+        size_t threads = lex_threads_;
+        if (threads == 0)
+        {
+            threads = std::thread::hardware_concurrency();
+        }
+        if (threads < 2)
+        {
+            return false;
+        }
 
-    void collect_pipe_commands(const Node* node, std::vector<const Node*>& commands) {
-        if (node->getType() == NodeType::PIPE) {
-            const auto* pipe_node = static_cast<const PipeNode*>(node);
-            collect_pipe_commands(pipe_node->getLeft(), commands);
-            collect_pipe_commands(pipe_node->getRight(), commands);
-        } else {
-            commands.push_back(node);
+        int fd = open(script_file_.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1)
+        {
+            // 由逐行读取报告错误
+            return false;
         }
-    }
+        struct stat st;
+        void *map = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && static_cast<size_t>(st.st_size) >= ParallelLexer::MIN_SIZE)
+        {
+            map = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        close(fd);
+        if (map == MAP_FAILED)
+        {
+            return false;
+        }
+        size_t size = static_cast<size_t>(st.st_size);
 
-    int Shell::execute_pipeline(const PipeNode *node) {
-        int status = 0;
-        std::vector<const Node*> commands;
-        collect_pipe_commands(node, commands);
-
-        // 检查最后一个命令是否以 & 结尾，表示后台运行
-        bool background = false;
-        const auto *last_command = dynamic_cast<const CommandNode *>(commands.back());
-        if (last_command && !last_command->getArgs().empty()) {
-            const std::string &last_arg = last_command->getArgs().back();
-            if (last_arg == "&") {
-                background = true;
-                // 创建没有 & 的新参数数组
-                std::vector<std::string> new_args = last_command->getArgs();
-                new_args.pop_back(); // 移除 &
-                
-                // 如果是后台任务，使用后台任务控制系统
-                if (bg_job_adapter_->initialize()) {
-                    // 准备命令字符串
-                    std::string cmd_str;
-                    for (size_t i = 0; i < commands.size(); ++i) {
-                        const auto *cmd = dynamic_cast<const CommandNode *>(commands[i]);
-                        if (cmd) {
-                            if (i > 0) cmd_str += " | ";
-                            for (size_t j = 0; j < cmd->getArgs().size(); ++j) {
-                                if (j > 0) cmd_str += " ";
-                                // 跳过最后一个命令的 & 参数
-                                if (!(i == commands.size() - 1 && j == cmd->getArgs().size() - 1 && cmd->getArgs()[j] == "&")) {
-                                    cmd_str += cmd->getArgs()[j];
-                                }
-                            }
-                        }
-                    }
-                    
-                    // 创建作业
-                    struct job *jp = bg_job_adapter_->createJob(cmd_str, commands.size());
-                    if (!jp) {
-                        std::cerr << "无法创建后台作业\n";
-                        return 1;
-                    }
-                    
-                    // 创建管道
-                    int in_fd = 0;
-                    std::vector<pid_t> pids;
-                    
-                    for (size_t i = 0; i < commands.size(); ++i) {
-                        int pipe_fds[2];
-                        if (i < commands.size() - 1) {
-                            if (pipe(pipe_fds) < 0) {
-                                perror("pipe");
-                                return -1;
-                            }
-                        }
-                        
-                        // 获取命令参数
-                        const auto *command_node = dynamic_cast<const CommandNode *>(commands[i]);
-                        if (!command_node) {
-                            continue;
-                        }
-                        
-                        // 准备参数数组
-                        std::vector<std::string> cmd_args = command_node->getArgs();
-                        // 移除最后一个命令的 & 参数
-                        if (i == commands.size() - 1 && background && 
-                            !cmd_args.empty() && cmd_args.back() == "&") {
-                            cmd_args.pop_back();
-                        }
-                        
-                        // 转换为C风格参数数组
-                        std::vector<char*> argv;
-                        for (const auto &arg : cmd_args) {
-                            argv.push_back(const_cast<char*>(arg.c_str()));
-                        }
-                        argv.push_back(nullptr);
-                        
-                        // 使用适配器创建后台任务
-                        pid_t pid = forkparent_bg(jp, i == 0 ? FORK_BG : FORK_NOJOB);
-                        
-                        if (pid < 0) {
-                            perror("fork");
-                            return -1;
-                        } else if (pid == 0) { // 子进程
-                            // 设置管道
-                            forkchild_bg(jp, i == 0 ? FORK_BG : FORK_NOJOB);
-                            
-                            if (i > 0) {
-                                dup2(in_fd, 0);
-                                close(in_fd);
-                            }
-                            if (i < commands.size() - 1) {
-                                close(pipe_fds[0]);
-                                dup2(pipe_fds[1], 1);
-                                close(pipe_fds[1]);
-                            }
-                            
-                            // 执行命令
-                            execvp(argv[0], argv.data());
-                            perror(argv[0]);
-                            _exit(127);
-                        }
-                        
-                        // 父进程处理管道
-                        if (i > 0) {
-                            close(in_fd);
-                        }
-                        if (i < commands.size() - 1) {
-                            in_fd = pipe_fds[0];
-                            close(pipe_fds[1]);
-                        }
+        try
+        {
+            ParallelLexer lexer(std::string_view(static_cast<const char *>(map), size), threads);
+            TokenStream stream;
+            std::string_view rest;
+            input_->reset();
+            while (!exit_requested_ && lexer.next(stream, rest))
+            {
+                if (!rest.empty())
+                {
+                    input_->pushString(std::string(rest), script_file_);
+                    runLines();
+                    continue;
+                }
+
+                size_t begin = 0;
+                for (size_t i = 0; i < stream.commands.size() && !exit_requested_; ++i)
+                {
+                    parser_->setTokens(&stream, begin, stream.commands[i]);
+                    begin = stream.commands[i];
+                    std::unique_ptr<Node> command = parser_->parseCommand(false);
+                    int status = executeParsed(command.get(), Executor::EXEC_NONE);
+                    if (!exit_requested_)
+                    {
+                        exit_status_ = status;
                     }
-                    
-                    return 0;
                 }
             }
         }
-        
-        // 如果不是后台任务或初始化失败，使用原有方式执行
-        int in_fd = 0;
-        std::vector<pid_t> pids;
-
-        for (size_t i = 0; i < commands.size(); ++i) {
-            int pipe_fds[2];
-            if (i < commands.size() - 1) {
-                if (pipe(pipe_fds) < 0) {
-                    perror("pipe");
-                    return -1;
-                }
-            }
-
-            pid_t pid = fork();
-            if (pid < 0) {
-                perror("fork");
-                return -1;
-            }
+        catch (...)
+        {
+            munmap(map, size);
+            throw;
+        }
+        munmap(map, size);
+        return true;
+    }
 
-            if (pid == 0) { // Child
-                if (i > 0) {
-                    dup2(in_fd, 0);
-                    close(in_fd);
-                }
-                if (i < commands.size() - 1) {
-                    close(pipe_fds[0]);
-                    dup2(pipe_fds[1], 1);
-                    close(pipe_fds[1]);
-                }
+    void Shell::displayPrompt()
+    {
+        // 显示提示符 (无变化)
+        std::string ps1 = variable_manager_->get("PS1");
+        if (ps1.empty())
+        {
+            ps1 = "$ ";
+        }
+        std::cout << ps1 << std::flush;
+    }
 
-                const auto *command_node = dynamic_cast<const CommandNode *>(commands[i]);
-                if (command_node) {
-                    std::vector<std::string> cmd_args = command_node->getArgs();
-                    // 移除最后一个命令的 & 参数
-                    if (i == commands.size() - 1 && background && 
-                        !cmd_args.empty() && cmd_args.back() == "&") {
-                        cmd_args.pop_back();
+    namespace
+    {
+        /**
+         * @brief 关闭所有带 close-on-exec 标志的描述符
+         */
+        void closeExecFds()
+        {
+            DIR *dir = opendir("/proc/self/fd");
+            if (!dir)
+            {
+                return;
+            }
+            std::vector<int> fds;
+            while (struct dirent *entry = readdir(dir))
+            {
+                int fd = atoi(entry->d_name);
+                if (fd > STDERR_FILENO && fd != dirfd(dir))
+                {
+                    int flags = fcntl(fd, F_GETFD);
+                    if (flags != -1 && (flags & FD_CLOEXEC))
+                    {
+                        fds.push_back(fd);
                     }
-                    executor_->exec_in_child(cmd_args[0], cmd_args);
-                } else {
-                    exit(EXIT_FAILURE);
                 }
             }
-
-            pids.push_back(pid);
-
-            if (i > 0) {
-                close(in_fd);
+            closedir(dir);
+            for (int fd : fds)
+            {
+                close(fd);
             }
-            if (i < commands.size() - 1) {
-                in_fd = pipe_fds[0];
-                close(pipe_fds[1]);
+        }
+    }
+
+    void Shell::runScriptInChild(const std::string &path, const std::vector<std::string> &args)
+    {
+        // 与父 shell 无关的状态全部丢弃，只保留导出的变量、命令哈希表和内置命令
+        input_->reset();
+        job_control_->reset();
+        variable_manager_->clearUnexported();
+        variable_manager_->set("$", std::to_string(getpid()), Variable::VAR_SPECIAL);
+        interactive_ = false;
+        exit_requested_ = false;
+        exit_status_ = 0;
+
+        // 非交互式 shell 不捕获 SIGINT 和 SIGQUIT（被忽略的保持忽略）
+        for (int sig : {SIGINT, SIGQUIT})
+        {
+            struct sigaction sa;
+            if (sigaction(sig, nullptr, &sa) == 0 && sa.sa_handler != SIG_IGN)
+            {
+                sa.sa_handler = SIG_DFL;
+                sigaction(sig, &sa, nullptr);
             }
         }
 
-        // 如果是后台任务，不等待子进程
-        if (background) {
-            std::cout << "[1] " << pids.back() << std::endl;
-            return 0;
+        script_file_ = path;
+        script_args_.assign(1, path);
+        if (!args.empty())
+        {
+            script_args_.insert(script_args_.end(), args.begin() + 1, args.end());
         }
+        command_string_.clear();
 
-        // 否则等待所有子进程完成
-        for (pid_t pid : pids) {
-            int child_status;
-            waitpid(pid, &child_status, 0);
-            if (WIFEXITED(child_status)) {
-                status = WEXITSTATUS(child_status);
-            }
+        // 与 exec 一样关闭带 close-on-exec 的描述符（例如管道中其他阶段的管道端），
+        // 否则其他阶段等不到 EOF
+        closeExecFds();
+        executor_->forgetDevNull();
+
+        int status = runScript();
+        std::cout.flush();
+        std::cerr.flush();
+        _exit(status);
+    }
+
+    void Shell::exit(int status)
+    {
+        exit_requested_ = true;
+        exit_status_ = status;
+    }
+
+    int Shell::executeString(const std::string &command_string, int flags, bool more_input)
+    {
+        if (more_input)
+        {
+            InputHandler *input = input_.get();
+            parser_->setInput(command_string, [input](std::string &next)
+                              { return input->readContinuationLine(next); });
+        }
+        else
+        {
+            parser_->setInput(command_string);
         }
+        std::unique_ptr<Node> command = parser_->parseCommand(false);
+        return executeParsed(command.get(), flags);
+    }
 
-        return status;
+    int Shell::executeParsed(const Node *command, int flags)
+    {
+        if (!command || (options_->getNoExec() && !interactive_))
+        {
+            // noexec：只检查语法
+            return 0;
+        }
+        return executor_->execute(command, flags);
     }
 
     // Getters (无变化)
@@ -561,54 +583,29 @@ namespace dash
     Parser *Shell::getParser() const { return parser_.get(); }
     Executor *Shell::getExecutor() const { return executor_.get(); }
     JobControl *Shell::getJobControl() const { return job_control_.get(); }
+    ShellOptions *Shell::getOptions() const { return options_.get(); }
     bool Shell::isInteractive() const { return interactive_; }
     int Shell::getExitStatus() const { return exit_status_; }
 
-    // createShell (无变化)
+    // createShell
     int createShell(int argc, char *argv[])
     {
+        // 客户端模式：命令交给常驻的服务进程执行，本进程不做任何初始化
+        std::string socket_path;
+        std::string command;
+        if (getClientRequest(argc, argv, socket_path, command))
+        {
+            int status = runClient(socket_path, command);
+            if (status >= 0)
+            {
+                return status;
+            }
+        }
+
         std::unique_ptr<Shell> shell = std::make_unique<Shell>();
         return shell->run(argc, argv);
     }
 
-    // 添加executeBackground方法的实现
-    int Shell::executeBackground(const std::string &command, std::vector<std::string> &args)
-    {
-        // 初始化后台任务控制适配器（如果需要）
-        if (!bg_job_adapter_->initialize()) {
-            std::cerr << "无法初始化后台任务控制\n";
-            return 1;
-        }
-        
-        // 创建参数数组
-        std::vector<char*> argv;
-        for (const auto &arg : args) {
-            argv.push_back(const_cast<char*>(arg.c_str()));
-        }
-        argv.push_back(nullptr);
-        
-        // 创建命令字符串
-        std::string cmd_str = command;
-        for (size_t i = 1; i < args.size(); ++i) {
-            cmd_str += " " + args[i];
-        }
-        
-        // 创建作业
-        struct job *jp = bg_job_adapter_->createJob(cmd_str, 1);
-        if (!jp) {
-            std::cerr << "无法创建后台作业\n";
-            return 1;
-        }
-        
-        // 在后台运行命令
-        int result = bg_job_adapter_->runInBackground(jp, command, argv.data());
-        if (result != 0) {
-            return 1;
-        }
-        
-        return 0;
-    }
-    
     // 添加getter方法实现
     BGJobAdapter *Shell::getBGJobAdapter() const
     {
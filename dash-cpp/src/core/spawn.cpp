@@ -0,0 +1,442 @@
+/**
+ * @file spawn.cpp
+ * @brief 外部命令创建后端实现
+ */
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <sched.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "core/spawn.h"
+
+extern char **environ;
+
+namespace dash
+{
+
+    namespace
+    {
+
+        /**
+         * @brief vfork 子进程使用的栈大小
+         */
+        constexpr size_t VFORK_STACK_SIZE = 64 * 1024;
+
+        /**
+         * @brief 父进程为子进程准备好的参数
+         *
+         * 子进程只读取这些数据并执行系统调用，不分配内存。
+         */
+        struct ChildContext
+        {
+            const SpawnPlan *plan;
+            char *const *argv;
+            char *const *envp;
+            const std::vector<std::string> *candidates;
+            int error;
+            int failed_action;
+        };
+
+        /**
+         * @brief 生成 exec 候选路径
+         *
+         * 与 execvp 相同：命令含 '/' 时直接使用，否则逐个尝试 PATH 中的目录。
+         */
+        std::vector<std::string> buildExecCandidates(const std::string &command)
+        {
+            std::vector<std::string> candidates;
+            if (command.find('/') != std::string::npos)
+            {
+                candidates.push_back(command);
+                return candidates;
+            }
+
+            const char *path = getenv("PATH");
+            std::string path_str = path ? path : "/usr/local/bin:/usr/bin:/bin";
+            size_t start = 0;
+            while (start <= path_str.size())
+            {
+                size_t end = path_str.find(':', start);
+                if (end == std::string::npos)
+                {
+                    end = path_str.size();
+                }
+                std::string dir = path_str.substr(start, end - start);
+                candidates.push_back((dir.empty() ? "." : dir) + "/" + command);
+                start = end + 1;
+            }
+            return candidates;
+        }
+
+        /**
+         * @brief 构建 C 风格参数数组
+         */
+        std::vector<char *> buildArgv(const std::vector<std::string> &args)
+        {
+            std::vector<char *> argv;
+            argv.reserve(args.size() + 1);
+            for (const auto &arg : args)
+            {
+                argv.push_back(const_cast<char *>(arg.c_str()));
+            }
+            argv.push_back(nullptr);
+            return argv;
+        }
+
+        /**
+         * @brief 依次尝试候选路径执行命令
+         *
+         * @return int 全部失败时的 errno
+         */
+        int execCandidates(const ChildContext *ctx)
+        {
+            bool seen_eacces = false;
+            int last_error = ENOENT;
+            for (const auto &candidate : *ctx->candidates)
+            {
+                execve(candidate.c_str(), ctx->argv, ctx->envp);
+                last_error = errno;
+                if (last_error == EACCES)
+                {
+                    seen_eacces = true;
+                }
+                else if (last_error != ENOENT && last_error != ENOTDIR && last_error != ELOOP &&
+                         last_error != ENAMETOOLONG)
+                {
+                    // 找到了文件但无法执行（如 ENOEXEC），停止搜索
+                    return last_error;
+                }
+            }
+            return seen_eacces ? EACCES : last_error;
+        }
+
+        /**
+         * @brief 子进程公共流程：信号、进程组、文件操作、exec
+         *
+         * 只调用异步信号安全的函数，可在 vfork 子进程中运行。
+         */
+        void childExec(ChildContext *ctx, bool reset_handlers)
+        {
+            if (reset_handlers)
+            {
+                // 与父进程共享内存时，必须先恢复默认处理函数再解除信号屏蔽
+                for (int sig = 1; sig < NSIG; ++sig)
+                {
+                    struct sigaction sa;
+                    if (sigaction(sig, nullptr, &sa) == 0 &&
+                        sa.sa_handler != SIG_DFL && sa.sa_handler != SIG_IGN)
+                    {
+                        sa.sa_handler = SIG_DFL;
+                        sa.sa_flags = 0;
+                        sigaction(sig, &sa, nullptr);
+                    }
+                }
+            }
+
+            if (ctx->plan->pgid >= 0)
+            {
+                setpgid(0, ctx->plan->pgid);
+            }
+
+            sigset_t empty_mask;
+            sigemptyset(&empty_mask);
+            sigprocmask(SIG_SETMASK, &empty_mask, nullptr);
+
+            int failed = runFileActions(ctx->plan->actions);
+            if (failed >= 0)
+            {
+                ctx->error = errno;
+                ctx->failed_action = failed;
+                return;
+            }
+
+            ctx->error = execCandidates(ctx);
+            ctx->failed_action = -1;
+        }
+
+        /**
+         * @brief clone 子进程入口
+         */
+        int vforkChildMain(void *arg)
+        {
+            ChildContext *ctx = static_cast<ChildContext *>(arg);
+            childExec(ctx, true);
+            _exit(127);
+        }
+
+        /**
+         * @brief 回收一个创建失败的子进程
+         */
+        void reapFailedChild(pid_t pid)
+        {
+            int status;
+            while (waitpid(pid, &status, 0) == -1 && errno == EINTR)
+            {
+            }
+        }
+
+    } // namespace
+
+    int runFileActions(const std::vector<FileAction> &actions)
+    {
+        for (size_t i = 0; i < actions.size(); ++i)
+        {
+            const FileAction &action = actions[i];
+            switch (action.kind)
+            {
+            case FileAction::OPEN:
+            {
+                int new_fd = open(action.path.c_str(), action.flags, action.mode);
+                if (new_fd == -1)
+                {
+                    return static_cast<int>(i);
+                }
+                if (new_fd != action.fd)
+                {
+                    if (dup2(new_fd, action.fd) == -1)
+                    {
+                        return static_cast<int>(i);
+                    }
+                    close(new_fd);
+                }
+                break;
+            }
+
+            case FileAction::DUP2:
+                if (action.source_fd == action.fd)
+                {
+                    // 同一描述符：只需清除 close-on-exec
+                    int fd_flags = fcntl(action.fd, F_GETFD);
+                    if (fd_flags == -1 || fcntl(action.fd, F_SETFD, fd_flags & ~FD_CLOEXEC) == -1)
+                    {
+                        return static_cast<int>(i);
+                    }
+                }
+                else if (dup2(action.source_fd, action.fd) == -1)
+                {
+                    return static_cast<int>(i);
+                }
+                break;
+
+            case FileAction::CLOSE:
+                close(action.fd);
+                break;
+            }
+        }
+        return -1;
+    }
+
+    SpawnResult execInPlace(const SpawnPlan &plan)
+    {
+        SpawnResult result;
+
+        std::vector<char *> argv = buildArgv(plan.args);
+        std::vector<std::string> candidates = buildExecCandidates(plan.command);
+        ChildContext ctx{&plan, argv.data(), environ, &candidates, 0, -1};
+
+        childExec(&ctx, false);
+        if (ctx.error == ENOEXEC && ctx.failed_action == -1 && plan.script_handler)
+        {
+            plan.script_handler(plan);
+        }
+        result.error = ctx.error;
+        result.failed_action = ctx.failed_action;
+        return result;
+    }
+
+    const char *spawnBackendName(SpawnBackendType type)
+    {
+        switch (type)
+        {
+        case SpawnBackendType::AUTO:
+            return "auto";
+        case SpawnBackendType::FORK:
+            return "fork";
+        case SpawnBackendType::VFORK:
+            return "vfork";
+        case SpawnBackendType::POSIX_SPAWN:
+            return "posix_spawn";
+        case SpawnBackendType::ZYGOTE:
+            return "zygote";
+        }
+        return "unknown";
+    }
+
+    // ForkSpawnBackend 实现
+
+    SpawnResult ForkSpawnBackend::spawn(const SpawnPlan &plan)
+    {
+        SpawnResult result;
+
+        std::vector<char *> argv = buildArgv(plan.args);
+        std::vector<std::string> candidates = buildExecCandidates(plan.command);
+        ChildContext ctx{&plan, argv.data(), environ, &candidates, 0, -1};
+
+        // close-on-exec 管道：exec 成功时父进程读到 EOF，失败时读到错误信息
+        int err_pipe[2];
+        if (pipe2(err_pipe, O_CLOEXEC) == -1)
+        {
+            result.error = errno;
+            return result;
+        }
+
+        pid_t pid = fork();
+        if (pid == -1)
+        {
+            result.error = errno;
+            close(err_pipe[0]);
+            close(err_pipe[1]);
+            return result;
+        }
+
+        if (pid == 0)
+        {
+            close(err_pipe[0]);
+            childExec(&ctx, false);
+            if (ctx.error == ENOEXEC && ctx.failed_action == -1 && plan.script_handler)
+            {
+                // 由本进程解释脚本；关闭管道让父进程认为启动成功
+                close(err_pipe[1]);
+                plan.script_handler(plan);
+            }
+            int report[2] = {ctx.error, ctx.failed_action};
+            ssize_t written = write(err_pipe[1], report, sizeof(report));
+            (void)written;
+            _exit(127);
+        }
+
+        close(err_pipe[1]);
+        int report[2];
+        ssize_t n;
+        do
+        {
+            n = read(err_pipe[0], report, sizeof(report));
+        } while (n == -1 && errno == EINTR);
+        close(err_pipe[0]);
+
+        if (n == static_cast<ssize_t>(sizeof(report)))
+        {
+            reapFailedChild(pid);
+            result.error = report[0];
+            result.failed_action = report[1];
+            return result;
+        }
+
+        result.pid = pid;
+        return result;
+    }
+
+    // VforkSpawnBackend 实现
+
+    SpawnResult VforkSpawnBackend::spawn(const SpawnPlan &plan)
+    {
+        SpawnResult result;
+
+        // 父进程挂起直到子进程 exec 或退出，因此每个线程一块栈即可
+        alignas(16) static thread_local char child_stack[VFORK_STACK_SIZE];
+
+        std::vector<char *> argv = buildArgv(plan.args);
+        std::vector<std::string> candidates = buildExecCandidates(plan.command);
+        ChildContext ctx{&plan, argv.data(), environ, &candidates, 0, -1};
+
+        // 子进程与父进程共享内存，在其恢复信号处理函数之前不能处理任何信号
+        sigset_t all_signals, old_mask;
+        sigfillset(&all_signals);
+        pthread_sigmask(SIG_BLOCK, &all_signals, &old_mask);
+
+        pid_t pid = clone(vforkChildMain, child_stack + VFORK_STACK_SIZE,
+                          CLONE_VM | CLONE_VFORK | SIGCHLD, &ctx);
+        int clone_errno = errno;
+
+        pthread_sigmask(SIG_SETMASK, &old_mask, nullptr);
+
+        if (pid == -1)
+        {
+            result.error = clone_errno;
+            return result;
+        }
+
+        // CLONE_VFORK 保证此时子进程已经 exec 成功或已退出
+        if (ctx.error != 0)
+        {
+            reapFailedChild(pid);
+            result.error = ctx.error;
+            result.failed_action = ctx.failed_action;
+            return result;
+        }
+
+        result.pid = pid;
+        return result;
+    }
+
+    // PosixSpawnBackend 实现
+
+    SpawnResult PosixSpawnBackend::spawn(const SpawnPlan &plan)
+    {
+        SpawnResult result;
+
+        posix_spawn_file_actions_t file_actions;
+        posix_spawn_file_actions_init(&file_actions);
+        for (const auto &action : plan.actions)
+        {
+            switch (action.kind)
+            {
+            case FileAction::OPEN:
+                posix_spawn_file_actions_addopen(&file_actions, action.fd, action.path.c_str(),
+                                                 action.flags, action.mode);
+                break;
+            case FileAction::DUP2:
+                posix_spawn_file_actions_adddup2(&file_actions, action.source_fd, action.fd);
+                break;
+            case FileAction::CLOSE:
+                posix_spawn_file_actions_addclose(&file_actions, action.fd);
+                break;
+            }
+        }
+
+        posix_spawnattr_t attr;
+        posix_spawnattr_init(&attr);
+        short flags = POSIX_SPAWN_SETSIGMASK;
+        sigset_t empty_mask;
+        sigemptyset(&empty_mask);
+        posix_spawnattr_setsigmask(&attr, &empty_mask);
+        if (plan.pgid >= 0)
+        {
+            flags |= POSIX_SPAWN_SETPGROUP;
+            posix_spawnattr_setpgroup(&attr, plan.pgid);
+        }
+        posix_spawnattr_setflags(&attr, flags);
+
+        std::vector<char *> argv = buildArgv(plan.args);
+        pid_t pid;
+        int rc;
+        if (plan.command.find('/') != std::string::npos)
+        {
+            rc = posix_spawn(&pid, plan.command.c_str(), &file_actions, &attr, argv.data(), environ);
+        }
+        else
+        {
+            rc = posix_spawnp(&pid, plan.command.c_str(), &file_actions, &attr, argv.data(), environ);
+        }
+
+        posix_spawnattr_destroy(&attr);
+        posix_spawn_file_actions_destroy(&file_actions);
+
+        if (rc != 0)
+        {
+            result.error = rc;
+            return result;
+        }
+
+        result.pid = pid;
+        return result;
+    }
+
+} // namespace dash
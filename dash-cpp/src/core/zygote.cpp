@@ -0,0 +1,528 @@
+/**
+ * @file zygote.cpp
+ * @brief Zygote 进程创建后端实现
+ */
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <csignal>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "core/zygote.h"
+#include "utils/fd_channel.h"
+
+extern char **environ;
+
+namespace dash
+{
+
+    namespace
+    {
+
+        /**
+         * @brief 辅助进程自身使用的描述符下限，避开子进程可能用到的描述符
+         */
+        constexpr int ZYGOTE_PRIVATE_FD_BASE = 200;
+
+        /**
+         * @brief 收到的描述符在子进程中暂存的位置下限
+         */
+        constexpr int ZYGOTE_PASSED_FD_BASE = 100;
+
+        /**
+         * @brief shell 中可以被子进程继承的描述符上限（0-9）
+         */
+        constexpr int ZYGOTE_MAX_INHERITED_FD = 10;
+
+        /**
+         * @brief 应答
+         */
+        struct Reply
+        {
+            int32_t pid;
+            int32_t error;
+            int32_t failed_action;
+        };
+
+        /**
+         * @brief 传递的描述符在子进程中的位置
+         */
+        struct PassedFd
+        {
+            int32_t target;  // 目标描述符，-1 表示当前目录
+            int32_t cloexec; // 在 shell 中是否带 close-on-exec
+        };
+
+        /**
+         * @brief 把描述符移动到 base 以上（带 close-on-exec）
+         */
+        int moveFdAbove(int fd, int base)
+        {
+            int new_fd = fcntl(fd, F_DUPFD_CLOEXEC, base);
+            if (new_fd != -1)
+            {
+                close(fd);
+            }
+            return new_fd;
+        }
+
+        /**
+         * @brief 辅助进程中新建的子进程：恢复 shell 的执行环境并 exec
+         */
+        [[noreturn]] void zygoteChildMain(int err_fd, SpawnPlan &plan, std::vector<std::string> &env,
+                                          uint64_t ignored_signals, const std::vector<int> &fds,
+                                          const std::vector<PassedFd> &passed)
+        {
+            int report[2] = {0, -1};
+
+            // 恢复 shell 的信号处置：被忽略的信号保持忽略，其余恢复默认
+            for (int sig = 1; sig < NSIG && sig <= 64; ++sig)
+            {
+                if (sig == SIGKILL || sig == SIGSTOP)
+                {
+                    continue;
+                }
+                struct sigaction sa;
+                memset(&sa, 0, sizeof(sa));
+                sa.sa_handler = (ignored_signals & (1ULL << (sig - 1))) ? SIG_IGN : SIG_DFL;
+                sigaction(sig, &sa, nullptr);
+            }
+
+            // 重建 shell 的 0-9 号描述符，shell 中未打开的描述符在这里也关闭
+            bool present[ZYGOTE_MAX_INHERITED_FD] = {false};
+            for (size_t i = 0; i < passed.size(); ++i)
+            {
+                int target = passed[i].target;
+                if (target < 0)
+                {
+                    if (fchdir(fds[i]) == -1)
+                    {
+                        report[0] = errno;
+                        goto fail;
+                    }
+                    continue;
+                }
+                if (dup2(fds[i], target) == -1)
+                {
+                    report[0] = errno;
+                    goto fail;
+                }
+                if (passed[i].cloexec)
+                {
+                    fcntl(target, F_SETFD, FD_CLOEXEC);
+                }
+                if (target < ZYGOTE_MAX_INHERITED_FD)
+                {
+                    present[target] = true;
+                }
+            }
+            for (int fd = 0; fd < ZYGOTE_MAX_INHERITED_FD; ++fd)
+            {
+                if (!present[fd])
+                {
+                    close(fd);
+                }
+            }
+
+            {
+                // PATH 搜索使用 shell 传来的环境
+                std::vector<char *> envp;
+                envp.reserve(env.size() + 1);
+                for (auto &entry : env)
+                {
+                    envp.push_back(&entry[0]);
+                }
+                envp.push_back(nullptr);
+                environ = envp.data();
+
+                SpawnResult result = execInPlace(plan);
+                report[0] = result.error;
+                report[1] = result.failed_action;
+            }
+
+        fail:
+            ssize_t written = write(err_fd, report, sizeof(report));
+            (void)written;
+            _exit(127);
+        }
+
+        /**
+         * @brief 处理一个请求
+         *
+         * @return bool false 表示连接已断开
+         */
+        bool zygoteServeOne(int sock)
+        {
+            std::string body;
+            std::vector<int> fds;
+            if (!recvMessage(sock, body, fds))
+            {
+                return false;
+            }
+
+            // 收到的描述符可能落在 0-9，先移走以免与目标位置冲突
+            for (auto &fd : fds)
+            {
+                fd = moveFdAbove(fd, ZYGOTE_PASSED_FD_BASE);
+            }
+
+            auto closeFds = [&fds]()
+            {
+                for (int fd : fds)
+                {
+                    if (fd != -1)
+                    {
+                        close(fd);
+                    }
+                }
+            };
+
+            MessageReader reader(body);
+            SpawnPlan plan;
+            plan.pgid = static_cast<pid_t>(reader.getInt());
+            uint64_t ignored_signals = static_cast<uint64_t>(reader.getInt());
+            plan.command = reader.getString();
+            plan.args = reader.getStrings();
+            std::vector<std::string> env = reader.getStrings();
+
+            int64_t action_count = reader.getInt();
+            for (int64_t i = 0; reader.ok() && i < action_count; ++i)
+            {
+                FileAction::Kind kind = static_cast<FileAction::Kind>(reader.getInt());
+                int fd = static_cast<int>(reader.getInt());
+                int source_fd = static_cast<int>(reader.getInt());
+                int flags = static_cast<int>(reader.getInt());
+                mode_t mode = static_cast<mode_t>(reader.getInt());
+                std::string path = reader.getString();
+                plan.actions.emplace_back(kind, fd, source_fd, path, flags, mode);
+            }
+
+            std::vector<PassedFd> passed;
+            for (size_t i = 0; reader.ok() && i < fds.size(); ++i)
+            {
+                PassedFd entry;
+                entry.target = static_cast<int32_t>(reader.getInt());
+                entry.cloexec = static_cast<int32_t>(reader.getInt());
+                passed.push_back(entry);
+            }
+
+            Reply reply{-1, 0, -1};
+            int err_pipe[2] = {-1, -1};
+
+            if (!reader.ok())
+            {
+                reply.error = EPROTO;
+            }
+            else if (pipe2(err_pipe, O_CLOEXEC) == -1)
+            {
+                reply.error = errno;
+            }
+            else
+            {
+                err_pipe[0] = moveFdAbove(err_pipe[0], ZYGOTE_PRIVATE_FD_BASE);
+                err_pipe[1] = moveFdAbove(err_pipe[1], ZYGOTE_PRIVATE_FD_BASE);
+
+                // CLONE_PARENT：新进程成为 shell 的子进程，由 shell 等待和回收
+                pid_t pid = static_cast<pid_t>(syscall(SYS_clone, CLONE_PARENT | SIGCHLD, 0, 0, 0, 0));
+                if (pid == 0)
+                {
+                    close(err_pipe[0]);
+                    close(sock);
+                    zygoteChildMain(err_pipe[1], plan, env, ignored_signals, fds, passed);
+                }
+
+                close(err_pipe[1]);
+                if (pid == -1)
+                {
+                    reply.error = errno;
+                }
+                else
+                {
+                    int report[2];
+                    ssize_t r;
+                    do
+                    {
+                        r = read(err_pipe[0], report, sizeof(report));
+                    } while (r == -1 && errno == EINTR);
+
+                    reply.pid = pid;
+                    if (r == static_cast<ssize_t>(sizeof(report)))
+                    {
+                        // 创建失败的进程同样由 shell 回收
+                        reply.error = report[0];
+                        reply.failed_action = report[1];
+                    }
+                }
+                close(err_pipe[0]);
+            }
+
+            closeFds();
+            return sendFully(sock, &reply, sizeof(reply));
+        }
+
+        /**
+         * @brief 辅助进程主循环
+         */
+        [[noreturn]] void zygoteMain(int sock, pid_t owner)
+        {
+            // shell 退出时辅助进程随之退出
+            prctl(PR_SET_PDEATHSIG, SIGKILL);
+            if (getppid() != owner)
+            {
+                _exit(0);
+            }
+
+            // 终端信号由 shell 处理，新进程的信号处置由请求决定
+            struct sigaction sa;
+            memset(&sa, 0, sizeof(sa));
+            sa.sa_handler = SIG_IGN;
+            sigaction(SIGINT, &sa, nullptr);
+            sigaction(SIGQUIT, &sa, nullptr);
+            sigaction(SIGTSTP, &sa, nullptr);
+            sigaction(SIGTTIN, &sa, nullptr);
+            sigaction(SIGTTOU, &sa, nullptr);
+            sa.sa_handler = SIG_DFL;
+            sigaction(SIGCHLD, &sa, nullptr);
+
+            sigset_t empty_mask;
+            sigemptyset(&empty_mask);
+            sigprocmask(SIG_SETMASK, &empty_mask, nullptr);
+
+            // 只保留与 shell 通信的套接字，其余描述符全部通过请求传递
+            sock = moveFdAbove(sock, ZYGOTE_PRIVATE_FD_BASE);
+            if (sock == -1)
+            {
+                _exit(1);
+            }
+            long max_fd = sysconf(_SC_OPEN_MAX);
+            if (max_fd < 0 || max_fd > 4096)
+            {
+                max_fd = 4096;
+            }
+            for (int fd = 0; fd < max_fd; ++fd)
+            {
+                if (fd != sock)
+                {
+                    close(fd);
+                }
+            }
+
+            while (zygoteServeOne(sock))
+            {
+            }
+            _exit(0);
+        }
+
+        /**
+         * @brief 获取 shell 中被忽略的信号集合
+         */
+        uint64_t ignoredSignalMask()
+        {
+            uint64_t mask = 0;
+            for (int sig = 1; sig < NSIG && sig <= 64; ++sig)
+            {
+                struct sigaction sa;
+                if (sigaction(sig, nullptr, &sa) == 0 && sa.sa_handler == SIG_IGN)
+                {
+                    mask |= 1ULL << (sig - 1);
+                }
+            }
+            return mask;
+        }
+
+    } // namespace
+
+    ZygoteSpawnBackend::ZygoteSpawnBackend(SpawnBackend *fallback)
+        : socket_fd_(-1), zygote_pid_(-1), owner_pid_(-1), fallback_(fallback)
+    {
+    }
+
+    ZygoteSpawnBackend::~ZygoteSpawnBackend()
+    {
+        stop();
+    }
+
+    void ZygoteSpawnBackend::stop()
+    {
+        if (socket_fd_ != -1)
+        {
+            close(socket_fd_);
+            socket_fd_ = -1;
+        }
+
+        // 只有创建辅助进程的 shell 才能回收它；关闭套接字后辅助进程自行退出
+        if (zygote_pid_ > 0 && owner_pid_ == getpid())
+        {
+            int status;
+            while (waitpid(zygote_pid_, &status, 0) == -1 && errno == EINTR)
+            {
+            }
+        }
+        zygote_pid_ = -1;
+    }
+
+    bool ZygoteSpawnBackend::start()
+    {
+        if (isUsable())
+        {
+            return true;
+        }
+        stop();
+
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) == -1)
+        {
+            return false;
+        }
+
+        pid_t owner = getpid();
+        pid_t pid = fork();
+        if (pid == -1)
+        {
+            close(sv[0]);
+            close(sv[1]);
+            return false;
+        }
+
+        if (pid == 0)
+        {
+            close(sv[0]);
+            zygoteMain(sv[1], owner);
+        }
+
+        close(sv[1]);
+        socket_fd_ = sv[0];
+        zygote_pid_ = pid;
+        owner_pid_ = owner;
+        return true;
+    }
+
+    bool ZygoteSpawnBackend::isUsable() const
+    {
+        return socket_fd_ != -1 && owner_pid_ == getpid();
+    }
+
+    SpawnResult ZygoteSpawnBackend::spawn(const SpawnPlan &plan)
+    {
+        // 子 shell 中或辅助进程已经退出时，使用后备后端
+        if (!isUsable() || plan.needs_shell)
+        {
+            return fallback_->spawn(plan);
+        }
+
+        // 收集要传递的描述符：当前目录、0-9 中会被继承的描述符、重定向引用的其他描述符
+        std::vector<int> fds;
+        std::vector<PassedFd> passed;
+
+        int cwd_fd = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+        if (cwd_fd == -1)
+        {
+            return fallback_->spawn(plan);
+        }
+        fds.push_back(cwd_fd);
+        passed.push_back(PassedFd{-1, 0});
+
+        auto addFd = [&fds, &passed](int fd, bool only_inherited)
+        {
+            for (const auto &entry : passed)
+            {
+                if (entry.target == fd)
+                {
+                    return;
+                }
+            }
+            int fd_flags = fcntl(fd, F_GETFD);
+            if (fd_flags == -1 || (only_inherited && (fd_flags & FD_CLOEXEC)))
+            {
+                return;
+            }
+            fds.push_back(fd);
+            passed.push_back(PassedFd{fd, (fd_flags & FD_CLOEXEC) ? 1 : 0});
+        };
+
+        for (int fd = 0; fd < ZYGOTE_MAX_INHERITED_FD; ++fd)
+        {
+            addFd(fd, true);
+        }
+        for (const auto &action : plan.actions)
+        {
+            if (action.kind == FileAction::DUP2 && action.source_fd >= 0)
+            {
+                addFd(action.source_fd, false);
+            }
+        }
+
+        if (fds.size() > FD_CHANNEL_MAX_FDS)
+        {
+            close(cwd_fd);
+            return fallback_->spawn(plan);
+        }
+
+        MessageWriter writer;
+        writer.putInt(plan.pgid);
+        writer.putInt(static_cast<int64_t>(ignoredSignalMask()));
+        writer.putString(plan.command);
+        writer.putStrings(plan.args);
+
+        std::vector<std::string> env;
+        for (char **entry = environ; entry && *entry; ++entry)
+        {
+            env.push_back(*entry);
+        }
+        writer.putStrings(env);
+
+        writer.putInt(static_cast<int64_t>(plan.actions.size()));
+        for (const auto &action : plan.actions)
+        {
+            writer.putInt(action.kind);
+            writer.putInt(action.fd);
+            writer.putInt(action.source_fd);
+            writer.putInt(action.flags);
+            writer.putInt(action.mode);
+            writer.putString(action.path);
+        }
+        for (const auto &entry : passed)
+        {
+            writer.putInt(entry.target);
+            writer.putInt(entry.cloexec);
+        }
+
+        Reply reply;
+        bool ok = sendMessage(socket_fd_, writer.data(), fds) &&
+                  readFully(socket_fd_, &reply, sizeof(reply));
+        close(cwd_fd);
+
+        if (!ok)
+        {
+            // 辅助进程已不可用，之后的命令都使用后备后端
+            stop();
+            return fallback_->spawn(plan);
+        }
+
+        SpawnResult result;
+        if (reply.error != 0)
+        {
+            if (reply.pid > 0)
+            {
+                int status;
+                while (waitpid(reply.pid, &status, 0) == -1 && errno == EINTR)
+                {
+                }
+            }
+            result.error = reply.error;
+            result.failed_action = reply.failed_action;
+            return result;
+        }
+
+        result.pid = reply.pid;
+        return result;
+    }
+
+} // namespace dash
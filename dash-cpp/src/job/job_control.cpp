@@ -11,8 +11,11 @@
 #include <termios.h>
 #include <fcntl.h>
 #include <mutex>
+#include <algorithm>
+#include <cerrno>
 #include "job/job_control.h"
 #include "core/shell.h"
+#include "core/redirection.h"
 #include "utils/error.h"
 
 namespace dash
@@ -281,8 +284,17 @@ namespace dash
 
     void JobControl::initialize()
     {
-        // 打开终端设备
-        terminal_fd_ = open("/dev/tty", O_RDWR);
+        // 打开终端设备，放到 0-9 以上并带 close-on-exec：exec 重定向 0-9 时不会覆盖它，命令也不会继承它
+        terminal_fd_ = open("/dev/tty", O_RDWR | O_CLOEXEC);
+        if (terminal_fd_ >= 0 && terminal_fd_ < RedirectionPlan::MAX_FD)
+        {
+            int high = fcntl(terminal_fd_, F_DUPFD_CLOEXEC, RedirectionPlan::MAX_FD);
+            if (high != -1)
+            {
+                close(terminal_fd_);
+                terminal_fd_ = high;
+            }
+        }
         if (terminal_fd_ < 0)
         {
             // 无法打开终端，禁用作业控制
@@ -430,7 +442,9 @@ namespace dash
                 // 如果找不到对应的进程，可能是被孤立的进程或其他程序的子进程
                 if (!process_found && pid > 0)
                 {
-                    // 这里可以记录日志，但不需要特殊处理
+                    // 不属于任何作业：可能是辅助子进程
+                    helper_pids_.erase(std::remove(helper_pids_.begin(), helper_pids_.end(), pid),
+                                       helper_pids_.end());
                 }
             }
             else
@@ -647,6 +661,44 @@ namespace dash
         }
     }
 
+    void JobControl::reset()
+    {
+        jobs_.clear();
+        helper_pids_.clear();
+        next_job_id_ = 1;
+        current_job_id_ = -1;
+        enabled_ = false;
+        if (terminal_fd_ >= 0)
+        {
+            close(terminal_fd_);
+            terminal_fd_ = -1;
+        }
+    }
+
+    void JobControl::addHelperProcess(pid_t pid)
+    {
+        helper_pids_.push_back(pid);
+    }
+
+    void JobControl::reapHelperProcesses()
+    {
+        auto it = helper_pids_.begin();
+        while (it != helper_pids_.end())
+        {
+            int status;
+            pid_t result = waitpid(*it, &status, WNOHANG);
+            if (result == 0 || (result == -1 && errno == EINTR))
+            {
+                ++it;
+            }
+            else
+            {
+                // 已回收，或者不是本进程的子进程（fork 出的子 shell 继承了列表）
+                it = helper_pids_.erase(it);
+            }
+        }
+    }
+
     bool JobControl::hasActiveJobs() const
     {
         for (const auto &pair : jobs_)
@@ -684,3 +736,5 @@ namespace dash
 
         return findJob(current_job_id_);
     }
+
+} // namespace dash
@@ -0,0 +1,370 @@
+/**
+ * @file fd_channel.cpp
+ * @brief UNIX 套接字消息与描述符传递工具实现
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "utils/fd_channel.h"
+
+namespace dash
+{
+
+    namespace
+    {
+
+        /**
+         * @brief 消息头，随 SCM_RIGHTS 一起发送
+         */
+        struct MessageHeader
+        {
+            uint32_t length;   // 消息体长度
+            uint32_t fd_count; // 随消息传递的描述符数量
+        };
+
+        /**
+         * @brief 从控制消息中取出 SCM_RIGHTS 传来的描述符
+         *
+         * @param msg 收到的消息
+         * @param fds 输出参数，追加取出的描述符
+         */
+        void collectFds(struct msghdr &msg, std::vector<int> &fds)
+        {
+            for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+            {
+                if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+                {
+                    size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                    const unsigned char *data = CMSG_DATA(cmsg);
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        int fd;
+                        memcpy(&fd, data + i * sizeof(int), sizeof(int));
+                        fds.push_back(fd);
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief 足以容纳 FD_CHANNEL_MAX_FDS 个描述符的控制消息缓冲区
+         */
+        union ControlBuffer
+        {
+            char buf[CMSG_SPACE(sizeof(int) * FD_CHANNEL_MAX_FDS)];
+            struct cmsghdr align;
+        };
+
+    } // namespace
+
+    void MessageWriter::putInt(int64_t value)
+    {
+        buffer_.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+
+    void MessageWriter::putString(const std::string &value)
+    {
+        putInt(static_cast<int64_t>(value.size()));
+        buffer_.append(value);
+    }
+
+    void MessageWriter::putStrings(const std::vector<std::string> &values)
+    {
+        putInt(static_cast<int64_t>(values.size()));
+        for (const auto &value : values)
+        {
+            putString(value);
+        }
+    }
+
+    int64_t MessageReader::getInt()
+    {
+        int64_t value = 0;
+        if (!ok_ || pos_ + sizeof(value) > buffer_.size())
+        {
+            ok_ = false;
+            return 0;
+        }
+        memcpy(&value, buffer_.data() + pos_, sizeof(value));
+        pos_ += sizeof(value);
+        return value;
+    }
+
+    std::string MessageReader::getString()
+    {
+        int64_t length = getInt();
+        if (!ok_ || length < 0 || pos_ + static_cast<size_t>(length) > buffer_.size())
+        {
+            ok_ = false;
+            return "";
+        }
+        std::string value = buffer_.substr(pos_, static_cast<size_t>(length));
+        pos_ += static_cast<size_t>(length);
+        return value;
+    }
+
+    std::vector<std::string> MessageReader::getStrings()
+    {
+        std::vector<std::string> values;
+        int64_t count = getInt();
+        for (int64_t i = 0; ok_ && i < count; ++i)
+        {
+            values.push_back(getString());
+        }
+        return values;
+    }
+
+    bool readFully(int fd, void *buf, size_t length)
+    {
+        char *p = static_cast<char *>(buf);
+        while (length > 0)
+        {
+            ssize_t n = read(fd, p, length);
+            if (n == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                return false;
+            }
+            p += n;
+            length -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool sendFully(int sock, const void *buf, size_t length)
+    {
+        const char *p = static_cast<const char *>(buf);
+        while (length > 0)
+        {
+            ssize_t n = send(sock, p, length, MSG_NOSIGNAL);
+            if (n == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                return false;
+            }
+            p += n;
+            length -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool sendMessage(int sock, const std::string &body, const std::vector<int> &fds)
+    {
+        if (fds.size() > FD_CHANNEL_MAX_FDS)
+        {
+            errno = EINVAL;
+            return false;
+        }
+        if (body.size() > FD_CHANNEL_MAX_MESSAGE)
+        {
+            errno = E2BIG;
+            return false;
+        }
+
+        MessageHeader header;
+        header.length = static_cast<uint32_t>(body.size());
+        header.fd_count = static_cast<uint32_t>(fds.size());
+
+        ControlBuffer control;
+        memset(control.buf, 0, sizeof(control.buf));
+
+        struct iovec iov;
+        iov.iov_base = &header;
+        iov.iov_len = sizeof(header);
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        if (!fds.empty())
+        {
+            msg.msg_control = control.buf;
+            msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+            struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_SOCKET;
+            cmsg->cmsg_type = SCM_RIGHTS;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+            memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+        }
+
+        ssize_t n;
+        do
+        {
+            n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+        } while (n == -1 && errno == EINTR);
+        if (n <= 0)
+        {
+            return false;
+        }
+
+        // 描述符已随第一个字节发出，剩余部分按普通数据发送
+        if (static_cast<size_t>(n) < sizeof(header) &&
+            !sendFully(sock, reinterpret_cast<char *>(&header) + n, sizeof(header) - n))
+        {
+            return false;
+        }
+        return sendFully(sock, body.data(), body.size());
+    }
+
+    bool recvMessage(int sock, std::string &body, std::vector<int> &fds)
+    {
+        MessageHeader header;
+        ControlBuffer control;
+
+        struct iovec iov;
+        iov.iov_base = &header;
+        iov.iov_len = sizeof(header);
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        fds.clear();
+        ssize_t n;
+        do
+        {
+            n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+        } while (n == -1 && errno == EINTR);
+        if (n <= 0)
+        {
+            return false;
+        }
+
+        collectFds(msg, fds);
+
+        bool ok = (msg.msg_flags & MSG_CTRUNC) == 0;
+        if (ok && static_cast<size_t>(n) < sizeof(header))
+        {
+            ok = readFully(sock, reinterpret_cast<char *>(&header) + n, sizeof(header) - n);
+        }
+        ok = ok && header.length <= FD_CHANNEL_MAX_MESSAGE;
+        if (ok)
+        {
+            body.assign(header.length, '\0');
+            ok = header.length == 0 || readFully(sock, &body[0], header.length);
+        }
+        ok = ok && header.fd_count == fds.size();
+
+        if (!ok)
+        {
+            for (int fd : fds)
+            {
+                close(fd);
+            }
+            fds.clear();
+        }
+        return ok;
+    }
+
+    MessageReceiver::~MessageReceiver()
+    {
+        for (int fd : fds_)
+        {
+            close(fd);
+        }
+    }
+
+    MessageReceiver::Status MessageReceiver::fail()
+    {
+        for (int fd : fds_)
+        {
+            close(fd);
+        }
+        fds_.clear();
+        return Status::FAILED;
+    }
+
+    MessageReceiver::Status MessageReceiver::receive(int sock)
+    {
+        static_assert(sizeof(header_) == sizeof(MessageHeader), "消息头大小不一致");
+        while (true)
+        {
+            ssize_t n;
+            if (received_ < sizeof(header_))
+            {
+                // 描述符随消息头的第一个字节到达
+                ControlBuffer control;
+                struct iovec iov;
+                iov.iov_base = reinterpret_cast<char *>(header_) + received_;
+                iov.iov_len = sizeof(header_) - received_;
+
+                struct msghdr msg;
+                memset(&msg, 0, sizeof(msg));
+                msg.msg_iov = &iov;
+                msg.msg_iovlen = 1;
+                msg.msg_control = control.buf;
+                msg.msg_controllen = sizeof(control.buf);
+
+                n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC | MSG_DONTWAIT);
+                if (n > 0)
+                {
+                    collectFds(msg, fds_);
+                    if (msg.msg_flags & MSG_CTRUNC)
+                    {
+                        return fail();
+                    }
+                }
+            }
+            else
+            {
+                // 按实际到达的数据增长，不信任消息头声明的长度
+                char chunk[65536];
+                size_t want = std::min<size_t>(header_[0] - body_.size(), sizeof(chunk));
+                n = recv(sock, chunk, want, MSG_DONTWAIT);
+                if (n > 0)
+                {
+                    body_.append(chunk, static_cast<size_t>(n));
+                }
+            }
+
+            if (n == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                return Status::PENDING;
+            }
+            if (n <= 0)
+            {
+                return fail();
+            }
+
+            received_ += static_cast<size_t>(n);
+            if (received_ == sizeof(header_))
+            {
+                MessageHeader header;
+                memcpy(&header, header_, sizeof(header));
+                if (header.fd_count != fds_.size() || header.length > FD_CHANNEL_MAX_MESSAGE)
+                {
+                    return fail();
+                }
+            }
+            if (received_ >= sizeof(header_) && body_.size() == header_[0])
+            {
+                return Status::COMPLETE;
+            }
+        }
+    }
+
+    void MessageReceiver::take(std::string &body, std::vector<int> &fds)
+    {
+        body = std::move(body_);
+        fds = std::move(fds_);
+        fds_.clear();
+    }
+
+} // namespace dash
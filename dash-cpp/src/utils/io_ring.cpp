@@ -0,0 +1,398 @@
+/**
+ * @file io_ring.cpp
+ * @brief shell 内部 I/O 使用的 io_uring 封装实现
+ */
+
+#include <algorithm>
+#include <memory>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#include "utils/io_ring.h"
+
+namespace dash
+{
+
+    namespace
+    {
+        /**
+         * @brief 请求的结果是否表示应该重新提交（链被取消或被信号打断）
+         */
+        bool shouldRetry(int result)
+        {
+            return result == -ECANCELED || result == -EINTR || result == -EAGAIN;
+        }
+
+        /**
+         * @brief 环的请求被内核拒绝，应该改用普通系统调用
+         */
+        bool isUnsupported(int error)
+        {
+            return error == EINVAL || error == EOPNOTSUPP || error == ENOSYS;
+        }
+    }
+
+    IoRing::IoRing()
+        : ring_fd_(-1), sq_ring_(nullptr), cq_ring_(nullptr), sq_ring_size_(0), cq_ring_size_(0),
+          sqes_(nullptr), sqes_size_(0), sq_tail_(nullptr), sq_mask_(nullptr), sq_array_(nullptr),
+          cq_head_(nullptr), cq_tail_(nullptr), cq_mask_(nullptr), cqes_(nullptr), pending_(0),
+          registered_(false), owner_(getpid())
+    {
+    }
+
+    IoRing::~IoRing()
+    {
+        // fork 出的子进程中只解除自己的映射、关闭自己的描述符，不影响父进程的环
+        if (sqes_)
+        {
+            munmap(sqes_, sqes_size_);
+        }
+        if (cq_ring_ && cq_ring_ != sq_ring_)
+        {
+            munmap(cq_ring_, cq_ring_size_);
+        }
+        if (sq_ring_)
+        {
+            munmap(sq_ring_, sq_ring_size_);
+        }
+        if (ring_fd_ != -1)
+        {
+            close(ring_fd_);
+        }
+    }
+
+    IoRing *IoRing::get()
+    {
+        static std::unique_ptr<IoRing> ring;
+        static pid_t failed_pid = 0;
+
+        pid_t pid = getpid();
+        if (ring && ring->owner_ != pid)
+        {
+            // 继承自父进程的环与父进程共享队列，不能使用
+            ring.reset();
+        }
+        if (!ring && failed_pid != pid)
+        {
+            ring.reset(new IoRing());
+            if (!ring->setup())
+            {
+                ring.reset();
+                failed_pid = pid;
+            }
+        }
+        return ring.get();
+    }
+
+    bool IoRing::setup()
+    {
+        struct io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, ENTRIES, &params));
+        if (fd == -1)
+        {
+            // ENOSYS：内核不支持；EPERM：被 seccomp 或 io_uring_disabled 禁止
+            return false;
+        }
+        ring_fd_ = fd;
+
+        // 管道和终端不能指定偏移，需要用 -1 表示当前位置
+        if (!(params.features & IORING_FEAT_RW_CUR_POS))
+        {
+            return false;
+        }
+
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap)
+        {
+            sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+        }
+
+        void *ptr = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                         IORING_OFF_SQ_RING);
+        if (ptr == MAP_FAILED)
+        {
+            return false;
+        }
+        sq_ring_ = ptr;
+
+        if (single_mmap)
+        {
+            cq_ring_ = sq_ring_;
+        }
+        else
+        {
+            ptr = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                       IORING_OFF_CQ_RING);
+            if (ptr == MAP_FAILED)
+            {
+                return false;
+            }
+            cq_ring_ = ptr;
+        }
+
+        sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+        ptr = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (ptr == MAP_FAILED)
+        {
+            return false;
+        }
+        sqes_ = static_cast<struct io_uring_sqe *>(ptr);
+
+        char *sq = static_cast<char *>(sq_ring_);
+        char *cq = static_cast<char *>(cq_ring_);
+        sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sq_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+
+        // 注册固定缓冲区，内核不必每次读取都映射用户页；失败时仍然可以用普通读请求
+        buffers_.resize(BUFFERS * BUFFER_SIZE);
+        struct iovec iovs[BUFFERS];
+        for (unsigned i = 0; i < BUFFERS; ++i)
+        {
+            iovs[i].iov_base = buffers_.data() + i * BUFFER_SIZE;
+            iovs[i].iov_len = BUFFER_SIZE;
+        }
+        registered_ = syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, iovs, BUFFERS) == 0;
+        return true;
+    }
+
+    struct io_uring_sqe *IoRing::nextSqe()
+    {
+        // 每批请求都等全部完成后才返回，开始填写时提交队列总是空的
+        unsigned index = (*sq_tail_ + pending_) & *sq_mask_;
+        ++pending_;
+        struct io_uring_sqe *sqe = &sqes_[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sq_array_[index] = index;
+        return sqe;
+    }
+
+    int IoRing::submitAndWait(unsigned count, int *results)
+    {
+        __atomic_store_n(sq_tail_, *sq_tail_ + pending_, __ATOMIC_RELEASE);
+        unsigned to_submit = pending_;
+        pending_ = 0;
+
+        unsigned done = 0;
+        while (true)
+        {
+            unsigned head = *cq_head_;
+            unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head)
+            {
+                const struct io_uring_cqe &cqe = cqes_[head & *cq_mask_];
+                if (cqe.user_data < count)
+                {
+                    results[cqe.user_data] = cqe.res;
+                }
+                ++done;
+            }
+            __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+            if (done >= count)
+            {
+                return 0;
+            }
+
+            long ret = syscall(__NR_io_uring_enter, ring_fd_, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (ret == -1)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return errno;
+            }
+            to_submit -= std::min<unsigned>(to_submit, static_cast<unsigned>(ret));
+        }
+    }
+
+    int IoRing::readAll(int fd, std::string &out)
+    {
+        // 链的长度随上一轮读满的请求数调整：管道每次通常只能读到一部分，普通文件可以一直读满
+        unsigned count = BUFFERS;
+        while (true)
+        {
+            for (unsigned i = 0; i < count; ++i)
+            {
+                struct io_uring_sqe *sqe = nextSqe();
+                sqe->opcode = registered_ ? IORING_OP_READ_FIXED : IORING_OP_READ;
+                sqe->fd = fd;
+                sqe->addr = reinterpret_cast<uint64_t>(buffers_.data() + i * BUFFER_SIZE);
+                sqe->len = BUFFER_SIZE;
+                sqe->off = static_cast<uint64_t>(-1);
+                sqe->buf_index = static_cast<uint16_t>(i);
+                sqe->user_data = i;
+                if (i + 1 < count)
+                {
+                    sqe->flags = IOSQE_IO_LINK;
+                }
+            }
+
+            int results[BUFFERS];
+            int error = submitAndWait(count, results);
+            if (error != 0)
+            {
+                return error;
+            }
+
+            unsigned full = 0;
+            for (unsigned i = 0; i < count; ++i)
+            {
+                int result = results[i];
+                if (shouldRetry(result))
+                {
+                    break;
+                }
+                if (result < 0)
+                {
+                    return -result;
+                }
+                if (result == 0)
+                {
+                    return 0;
+                }
+                out.append(buffers_.data() + i * BUFFER_SIZE, static_cast<size_t>(result));
+                if (static_cast<size_t>(result) < BUFFER_SIZE)
+                {
+                    // 没有读满，链中后面的请求已被取消
+                    break;
+                }
+                ++full;
+            }
+            count = std::min(full + 1, BUFFERS);
+        }
+    }
+
+    int IoRing::writeAll(int fd, const char *data, size_t size, size_t &written)
+    {
+        written = 0;
+        while (written < size)
+        {
+            size_t lengths[ENTRIES];
+            unsigned count = 0;
+            size_t pos = written;
+            struct io_uring_sqe *last = nullptr;
+            for (; count < ENTRIES && pos < size; ++count)
+            {
+                size_t length = std::min(WRITE_CHUNK, size - pos);
+                struct io_uring_sqe *sqe = nextSqe();
+                sqe->opcode = IORING_OP_WRITE;
+                sqe->fd = fd;
+                sqe->addr = reinterpret_cast<uint64_t>(data + pos);
+                sqe->len = static_cast<uint32_t>(length);
+                sqe->off = static_cast<uint64_t>(-1);
+                sqe->user_data = count;
+                sqe->flags = IOSQE_IO_LINK;
+                lengths[count] = length;
+                pos += length;
+                last = sqe;
+            }
+            last->flags = 0;
+
+            int results[ENTRIES];
+            int error = submitAndWait(count, results);
+            if (error != 0)
+            {
+                return error;
+            }
+
+            for (unsigned i = 0; i < count; ++i)
+            {
+                int result = results[i];
+                if (shouldRetry(result))
+                {
+                    break;
+                }
+                if (result < 0)
+                {
+                    return -result;
+                }
+                if (result == 0)
+                {
+                    return EIO;
+                }
+                written += static_cast<size_t>(result);
+                if (static_cast<size_t>(result) < lengths[i])
+                {
+                    break;
+                }
+            }
+        }
+        return 0;
+    }
+
+    int IoRing::readFully(int fd, std::string &out, bool use_ring)
+    {
+        IoRing *ring = use_ring ? get() : nullptr;
+        if (ring)
+        {
+            int error = ring->readAll(fd, out);
+            if (!isUnsupported(error))
+            {
+                return error;
+            }
+            // 读请求被拒绝时还没有读到这一部分，接着用 read 读完
+        }
+
+        char buffer[BUFFER_SIZE];
+        while (true)
+        {
+            ssize_t n = read(fd, buffer, sizeof(buffer));
+            if (n > 0)
+            {
+                out.append(buffer, static_cast<size_t>(n));
+                continue;
+            }
+            if (n == 0)
+            {
+                return 0;
+            }
+            if (errno != EINTR)
+            {
+                return errno;
+            }
+        }
+    }
+
+    int IoRing::writeFully(int fd, const char *data, size_t size, bool use_ring)
+    {
+        size_t written = 0;
+        IoRing *ring = use_ring ? get() : nullptr;
+        if (ring)
+        {
+            int error = ring->writeAll(fd, data, size, written);
+            if (!isUnsupported(error))
+            {
+                return error;
+            }
+            // 写请求被拒绝时从已经写完的位置接着用 write 写
+        }
+
+        while (written < size)
+        {
+            ssize_t n = write(fd, data + written, size - written);
+            if (n == -1)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return errno;
+            }
+            written += static_cast<size_t>(n);
+        }
+        return 0;
+    }
+
+} // namespace dash
@@ -0,0 +1,114 @@
+/**
+ * @file thread_pool.cpp
+ * @brief 固定大小的工作线程池实现
+ */
+
+#include <csignal>
+#include <pthread.h>
+#include "utils/thread_pool.h"
+
+namespace dash
+{
+
+    ThreadPool::ThreadPool(size_t threads)
+        : pending_(0), stopping_(false)
+    {
+        // 新线程继承创建者的信号屏蔽字：创建期间屏蔽所有信号
+        sigset_t all_signals, old_mask;
+        sigfillset(&all_signals);
+        pthread_sigmask(SIG_BLOCK, &all_signals, &old_mask);
+
+        workers_.reserve(threads);
+        for (size_t i = 0; i < threads; ++i)
+        {
+            workers_.emplace_back(&ThreadPool::workerLoop, this);
+        }
+
+        pthread_sigmask(SIG_SETMASK, &old_mask, nullptr);
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        work_cv_.notify_all();
+        for (auto &worker : workers_)
+        {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::workerLoop()
+    {
+        for (;;)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                work_cv_.wait(lock, [this]()
+                              { return stopping_ || !queue_.empty(); });
+                if (queue_.empty())
+                {
+                    return;
+                }
+                task = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            task();
+            finishTask();
+        }
+    }
+
+    bool ThreadPool::takeTask(std::function<void()> &task)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.empty())
+        {
+            return false;
+        }
+        task = std::move(queue_.front());
+        queue_.pop_front();
+        return true;
+    }
+
+    void ThreadPool::finishTask()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--pending_ == 0)
+        {
+            done_cv_.notify_all();
+        }
+    }
+
+    void ThreadPool::runAll(std::vector<std::function<void()>> &tasks)
+    {
+        if (tasks.empty())
+        {
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto &task : tasks)
+            {
+                queue_.push_back(std::move(task));
+            }
+            pending_ += tasks.size();
+        }
+        work_cv_.notify_all();
+
+        std::function<void()> task;
+        while (takeTask(task))
+        {
+            task();
+            finishTask();
+        }
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_cv_.wait(lock, [this]()
+                      { return pending_ == 0; });
+    }
+
+} // namespace dash
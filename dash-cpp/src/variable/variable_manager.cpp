@@ -10,7 +10,10 @@
 #include <sys/wait.h>
 #include "variable/variable_manager.h"
 #include "core/shell.h"
+#include "core/executor.h"
+#include "core/options.h"
 #include "utils/error.h"
+#include "utils/io_ring.h"
 
 extern char **environ;
 
@@ -39,7 +42,7 @@ namespace dash
     // VariableManager 实现
 
     VariableManager::VariableManager(Shell *shell)
-        : shell_(shell)
+        : shell_(shell), path_generation_(0)
     {
         initialize();
     }
@@ -95,6 +98,86 @@ namespace dash
         }
     }
 
+    void VariableManager::importEnvironment(const std::vector<std::string> &env)
+    {
+        std::unordered_map<std::string, std::string> incoming;
+        for (const auto &entry : env)
+        {
+            size_t pos = entry.find('=');
+            if (pos != std::string::npos)
+            {
+                incoming.emplace(entry.substr(0, pos), entry.substr(pos + 1));
+            }
+        }
+
+        // 删除新环境中没有的导出变量
+        std::vector<std::string> stale;
+        for (const auto &pair : variables_)
+        {
+            if (pair.second->hasFlag(Variable::VAR_EXPORT) && incoming.find(pair.first) == incoming.end())
+            {
+                stale.push_back(pair.first);
+            }
+        }
+        for (const auto &name : stale)
+        {
+            unset(name);
+        }
+
+        clearenv();
+        for (const auto &pair : incoming)
+        {
+            auto it = variables_.find(pair.first);
+            if (it != variables_.end() && it->second->getValue() == pair.second)
+            {
+                // 值未变化：只补上导出标志和环境
+                it->second->addFlag(Variable::VAR_EXPORT);
+                setenv(pair.first.c_str(), pair.second.c_str(), 1);
+            }
+            else
+            {
+                set(pair.first, pair.second, Variable::VAR_EXPORT);
+            }
+        }
+
+        // 无法删除的只读变量仍然留在环境中
+        for (const auto &pair : variables_)
+        {
+            if (pair.second->hasFlag(Variable::VAR_EXPORT) && incoming.find(pair.first) == incoming.end())
+            {
+                setenv(pair.first.c_str(), pair.second->getValue().c_str(), 1);
+            }
+        }
+
+        set("$", std::to_string(getpid()), Variable::VAR_SPECIAL);
+    }
+
+    void VariableManager::clearUnexported()
+    {
+        for (auto it = variables_.begin(); it != variables_.end();)
+        {
+            const Variable &var = *it->second;
+            if (!var.hasFlag(Variable::VAR_EXPORT) && !var.hasFlag(Variable::VAR_READONLY) &&
+                !var.hasFlag(Variable::VAR_SPECIAL))
+            {
+                if (it->first == "PATH")
+                {
+                    path_generation_++;
+                }
+                it = variables_.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        // 非导出的默认变量重新设置
+        set("PS1", "$ ", Variable::VAR_NONE);
+        set("PS2", "> ", Variable::VAR_NONE);
+        set("IFS", " \t\n", Variable::VAR_NONE);
+    }
+
     bool VariableManager::set(const std::string &name, const std::string &value, int flags)
     {
         // 检查变量名是否有效
@@ -103,6 +186,12 @@ namespace dash
             return false;
         }
 
+        // PATH 变化时使命令哈希表失效
+        if (name == "PATH")
+        {
+            path_generation_++;
+        }
+
         // 检查是否是特殊变量
         if (name == "?" || name == "$" || name == "#" || name == "0")
         {
@@ -181,6 +270,11 @@ namespace dash
                 unsetenv(name.c_str());
             }
 
+            if (name == "PATH")
+            {
+                path_generation_++;
+            }
+
             // 从变量表中删除
             variables_.erase(it);
             return true;
@@ -189,6 +283,41 @@ namespace dash
         return false;
     }
 
+    std::vector<VariableManager::SavedVariable> VariableManager::saveVariables(
+        const std::vector<std::string> &names) const
+    {
+        std::vector<SavedVariable> saved;
+        saved.reserve(names.size());
+        for (const auto &name : names)
+        {
+            auto it = variables_.find(name);
+            if (it != variables_.end())
+            {
+                saved.push_back({name, true, it->second->getValue()});
+            }
+            else
+            {
+                saved.push_back({name, false, ""});
+            }
+        }
+        return saved;
+    }
+
+    void VariableManager::restoreVariables(const std::vector<SavedVariable> &saved)
+    {
+        for (const auto &variable : saved)
+        {
+            if (!variable.existed)
+            {
+                unset(variable.name);
+            }
+            else if (get(variable.name) != variable.value)
+            {
+                set(variable.name, variable.value);
+            }
+        }
+    }
+
     bool VariableManager::exportVar(const std::string &name)
     {
         auto it = variables_.find(name);
@@ -426,7 +555,7 @@ namespace dash
             return "";
         }
         
-        pid_t pid = fork();
+        pid_t pid = shell_->getExecutor()->forkProcess();
         if (pid == -1)
         {
             close(pipefd[0]);
@@ -453,17 +582,9 @@ namespace dash
         // 父进程
         close(pipefd[1]); // 关闭写端
         
-        // 从管道读取输出
+        // 从管道读取输出，直到子进程关闭写端
         std::string output;
-        char buffer[4096];
-        ssize_t n;
-        
-        while ((n = read(pipefd[0], buffer, sizeof(buffer) - 1)) > 0)
-        {
-            buffer[n] = '\0';
-            output += buffer;
-        }
-        
+        IoRing::readFully(pipefd[0], output, shell_->getOptions()->getIoUring());
         close(pipefd[0]);
         
         // 等待子进程结束
@@ -0,0 +1,87 @@
+#!/bin/sh
+# 参数展开测试：用 dash 运行一段展开各种参数的脚本，与 POSIX sh 应有的输出比较。
+#
+# 用法: tests/expansion.sh [dash 路径]
+
+DASH=${1:-./build/dash}
+
+if [ ! -x "$DASH" ]; then
+    echo "找不到可执行的 dash: $DASH" >&2
+    exit 1
+fi
+# 脚本在临时目录中运行（通配符匹配那里的文件），先转成绝对路径
+DASH=$(cd "$(dirname "$DASH")" && pwd)/$(basename "$DASH")
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+touch "$DIR/a.txt" "$DIR/b.txt" "$DIR/c.log"
+
+# 字段分割、通配符、引号和反斜杠的去除、$?、空参数、波浪号和命令替换
+cat > "$DIR/script" <<'END_SCRIPT'
+x="one  two   three"
+printf '<%s>\n' $x
+printf '<%s>\n' "$x"
+IFS=:
+y="a:b::c"
+printf '<%s>\n' $y
+IFS=' 	
+'
+printf '<%s>\n' *.txt
+printf '<%s>\n' "*.txt" '*.txt' \*.txt
+printf '<%s>\n' nomatch*.zz
+printf '<%s>\n' a\ b \$x c\\d
+printf '<%s>\n' "q\"x" "b\\s" "d\$x" "e\z"
+false
+echo "status $?"
+true
+echo status $?
+e=
+printf '<%s>\n' $e "$e" x${e}y
+HOME=/home/test
+printf '<%s>\n' ~ ~/sub "~"
+printf '<%s>\n' "$(echo sub  out)" $(echo sub  out)
+printf '<%s>\n' pre$(echo mid)post
+END_SCRIPT
+
+cat > "$DIR/expected" <<'END_EXPECTED'
+<one>
+<two>
+<three>
+<one  two   three>
+<a>
+<b>
+<>
+<c>
+<a.txt>
+<b.txt>
+<*.txt>
+<*.txt>
+<*.txt>
+<nomatch*.zz>
+<a b>
+<$x>
+<c\d>
+<q"x>
+<b\s>
+<d$x>
+<e\z>
+status 1
+status 0
+<>
+<xy>
+</home/test>
+</home/test/sub>
+<~>
+<sub out>
+<sub>
+<out>
+<premidpost>
+END_EXPECTED
+
+(cd "$DIR" && "$DASH" script) > "$DIR/actual" 2>&1
+if ! cmp -s "$DIR/expected" "$DIR/actual"; then
+    echo "参数展开的输出不符合预期:" >&2
+    diff "$DIR/expected" "$DIR/actual" >&2
+    exit 1
+fi
+echo "expansion: ok"
@@ -0,0 +1,49 @@
+#!/bin/sh
+# Here 文档测试：用 dash 运行几段 Here 文档，与 POSIX sh 应有的输出比较。
+#
+# 用法: tests/heredoc.sh [dash 路径]
+
+DASH=${1:-./build/dash}
+
+if [ ! -x "$DASH" ]; then
+    echo "找不到可执行的 dash: $DASH" >&2
+    exit 1
+fi
+
+SCRIPT=$(mktemp)
+EXPECTED=$(mktemp)
+ACTUAL=$(mktemp)
+trap 'rm -f "$SCRIPT" "$EXPECTED" "$ACTUAL"' EXIT
+
+# 不加引号的定界符：反斜杠只转义 $ ` \ 和换行符，其余反斜杠原样保留
+cat > "$SCRIPT" <<'END_SCRIPT'
+y=1
+cat <<EOF
+\$y \\ $y
+\`x\` a\b "$y"
+line\
+continued
+EOF
+cat <<'EOF'
+\$y \\ $y
+EOF
+cat <<-EOF
+	tab $y
+	EOF
+END_SCRIPT
+
+cat > "$EXPECTED" <<'END_EXPECTED'
+$y \ 1
+`x` a\b "1"
+linecontinued
+\$y \\ $y
+tab 1
+END_EXPECTED
+
+"$DASH" "$SCRIPT" > "$ACTUAL" 2>&1
+if ! cmp -s "$EXPECTED" "$ACTUAL"; then
+    echo "Here 文档的输出不符合预期:" >&2
+    diff "$EXPECTED" "$ACTUAL" >&2
+    exit 1
+fi
+echo "heredoc: ok"
@@ -0,0 +1,89 @@
+#!/bin/sh
+# 管道测试：检查各阶段的状态（PIPESTATUS）、$? 和 set -o pipefail，
+# 以及描述符不足时并行启动与逐个启动的结果一致。
+#
+# 用法: tests/pipeline.sh [dash 路径]
+
+DASH=${1:-./build/dash}
+
+if [ ! -x "$DASH" ]; then
+    echo "找不到可执行的 dash: $DASH" >&2
+    exit 1
+fi
+
+SCRIPT=$(mktemp)
+EXPECTED=$(mktemp)
+ACTUAL=$(mktemp)
+trap 'rm -f "$SCRIPT" "$EXPECTED" "$ACTUAL"' EXIT
+
+# 被 SIGPIPE 终止的阶段状态为 141；pipefail 时管道的状态是最后一个失败阶段的状态
+cat > "$SCRIPT" <<'END_SCRIPT'
+false | true
+echo $? $PIPESTATUS
+yes | head -1
+echo $? $PIPESTATUS
+true | false | true
+echo $? $PIPESTATUS
+sh -c 'exit 3'
+echo $? $PIPESTATUS
+/bin/true | /bin/false | /bin/cat | /bin/cat | sh -c 'exit 5'
+echo $? $PIPESTATUS
+set -o pipefail
+false | true
+echo $? $PIPESTATUS
+true | sh -c 'exit 4' | false | true
+echo $? $PIPESTATUS
+true | true
+echo $? $PIPESTATUS
+END_SCRIPT
+
+cat > "$EXPECTED" <<'END_EXPECTED'
+0 1 0
+y
+0 141 0
+0 0 1 0
+3 3
+5 0 1 0 0 5
+1 1 0
+1 0 4 1 0
+0 0 0
+END_EXPECTED
+
+"$DASH" "$SCRIPT" > "$ACTUAL" 2>&1
+if ! cmp -s "$EXPECTED" "$ACTUAL"; then
+    echo "管道状态不符合预期:" >&2
+    diff "$EXPECTED" "$ACTUAL" >&2
+    exit 1
+fi
+
+# 描述符不足：第二个阶段的进程替换占住描述符，使预先创建全部管道失败。
+# 并行启动（spawn=vfork，多核时使用）应当退回逐个启动，结果与 spawn=fork 相同：
+# 报告 "dash: pipe: ..."，各阶段状态一致。描述符的确切用量随环境变化，所以试一段范围
+failed=0
+n=56
+while [ "$n" -le 78 ]; do
+    subs=""
+    i=0
+    while [ "$i" -lt "$n" ]; do
+        subs="$subs <(true)"
+        i=$((i + 1))
+    done
+    command="/bin/true | /bin/cat $subs | /bin/cat | /bin/cat | /bin/cat; echo \$? \$PIPESTATUS"
+    parallel=$( (ulimit -n 80 && "$DASH" -c "set -o spawn=vfork; $command") 2>&1)
+    sequential=$( (ulimit -n 80 && "$DASH" -c "set -o spawn=fork; $command") 2>&1)
+    if [ "$parallel" != "$sequential" ]; then
+        echo "描述符不足时并行启动与逐个启动的结果不同（$n 个进程替换）:" >&2
+        echo "parallel:   $parallel" >&2
+        echo "sequential: $sequential" >&2
+        exit 1
+    fi
+    case $sequential in
+    *"dash: pipe: "*) failed=$((failed + 1)) ;;
+    esac
+    n=$((n + 2))
+done
+if [ "$failed" -eq 0 ]; then
+    echo "没有触发创建管道失败，需要调整进程替换的数量" >&2
+    exit 1
+fi
+echo "pipeline: ok"
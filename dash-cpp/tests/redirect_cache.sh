@@ -0,0 +1,60 @@
+#!/bin/sh
+# 重定向缓存测试：循环中重复的 >>file 复用描述符，文件在迭代之间被删除、改名或 cd 后
+# 相对路径指向别的文件时必须重新打开；>file 每次都是新的打开。
+#
+# 用法: tests/redirect_cache.sh [dash 路径]
+
+DASH=${1:-./build/dash}
+
+if [ ! -x "$DASH" ]; then
+    echo "找不到可执行的 dash: $DASH" >&2
+    exit 1
+fi
+# 脚本在临时目录中运行，先转成绝对路径
+DASH=$(cd "$(dirname "$DASH")" && pwd)/$(basename "$DASH")
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+mkdir "$DIR/d1" "$DIR/d2"
+
+# 最后一组：两个后台写入者各自打开 background，后开始写的先结束。
+# 各自有自己的偏移量时，晚写的 late5 覆盖 late1；共享描述符时两行都会留下
+cat > "$DIR/script" <<'END_SCRIPT'
+for i in 1 2 3; do echo $i >> removed; if test $i = 1; then rm removed; fi; done
+for i in 1 2 3; do echo $i >> moved; if test $i = 1; then mv moved old; fi; done
+cd d1
+for i in 1 2; do echo $i >> log; cd ../d2; done
+cd ..
+for i in 1 2 3; do echo $i > truncated; done
+for i in 5 1; do sh -c "sleep .$i; echo late$i" | /bin/cat > background & done
+sleep 1
+for f in removed old moved d1/log d2/log truncated background; do echo "$f:"; cat $f; done
+END_SCRIPT
+
+cat > "$DIR/expected" <<'END_EXPECTED'
+removed:
+2
+3
+old:
+1
+moved:
+2
+3
+d1/log:
+1
+d2/log:
+2
+truncated:
+3
+background:
+late5
+END_EXPECTED
+
+# 后台作业的提示行不属于比较内容
+(cd "$DIR" && "$DASH" script) 2>&1 | grep -v '^\[[0-9]*\] ' > "$DIR/actual"
+if ! cmp -s "$DIR/expected" "$DIR/actual"; then
+    echo "重定向缓存的结果不符合预期:" >&2
+    diff "$DIR/expected" "$DIR/actual" >&2
+    exit 1
+fi
+echo "redirect_cache: ok"